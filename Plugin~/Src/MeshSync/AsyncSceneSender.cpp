@@ -3,11 +3,15 @@
 
 #ifndef msRuntime
 
+#include "MeshUtils/muConcurrency.h"
+
 #include "MeshSync/SceneGraph/msAnimation.h"
 
 #include "MeshSync/msClient.h" //Client
 #include "MeshSync/SceneGraph/msMaterial.h"
 #include "MeshSync/SceneGraph/msTexture.h"
+#include "MeshSync/SceneGraph/msMesh.h"
+#include "MeshSync/SceneGraph/msPoints.h"
 
 #include "Utils/EntityUtility.h"
 
@@ -90,6 +94,112 @@ void AsyncSceneSender::requestLiveEditMessage()
     });
 }
 
+void AsyncSceneSender::resetEntityStates()
+{
+    wait();
+    m_entity_states.clear();
+}
+
+SenderStats AsyncSceneSender::getStats() const
+{
+    SenderStats ret;
+    ret.num_sends = m_num_sends;
+    ret.num_failed_sends = m_num_failed_sends;
+    ret.num_entities_sent = m_num_entities_sent;
+    ret.num_entities_skipped = m_num_entities_skipped;
+    ret.num_geometries_unchanged = m_num_geometries_unchanged;
+    ret.send_latency = m_send_latency.getStats();
+    ret.client = m_client_counters->getStats();
+    return ret;
+}
+
+void AsyncSceneSender::resetStats()
+{
+    m_num_sends = 0;
+    m_num_failed_sends = 0;
+    m_num_entities_sent = 0;
+    m_num_entities_skipped = 0;
+    m_num_geometries_unchanged = 0;
+    m_send_latency.reset();
+    m_client_counters->reset();
+}
+
+// geometry types whose payload can be omitted by a flag
+static bool SetGeometryUnchanged(Transform& e, bool v)
+{
+    switch (e.getType()) {
+    case EntityType::Mesh:
+        static_cast<Mesh&>(e).md_flags.Set(MESH_DATA_FLAG_UNCHANGED, v);
+        return true;
+    case EntityType::Points:
+        static_cast<Points&>(e).pd_flags.Set(POINTS_DATA_FLAG_UNCHANGED, v);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AsyncSceneSender::skipUnchanged(std::vector<TransformPtr>& entities, bool geometry)
+{
+    size_t num_entities = entities.size();
+    std::vector<EntityState> states(num_entities);
+    mu::parallel_for(0, (int)num_entities, 10, [&](int i) {
+        auto& e = *entities[i];
+        states[i].checksum_trans = e.checksumTrans();
+        if (geometry)
+            states[i].checksum_geom = e.checksumGeom();
+    });
+
+    size_t num_sent = 0;
+    for (size_t i = 0; i < num_entities; ++i) {
+        TransformPtr e = entities[i];
+        const EntityState& state = states[i];
+        if (!e->path.empty()) {
+            auto it = m_entity_states.find(e->path);
+            if (it != m_entity_states.end()) {
+                bool trans_unchanged = it->second.checksum_trans == state.checksum_trans;
+                bool geom_unchanged = it->second.checksum_geom == state.checksum_geom;
+                if (trans_unchanged && geom_unchanged)
+                    continue;
+                if (geometry && geom_unchanged && SetGeometryUnchanged(*e, true))
+                    m_geometry_skipped.push_back(e);
+            }
+            m_pending_states.emplace_back(e->path, state);
+        }
+        entities[num_sent++] = e;
+    }
+    entities.resize(num_sent);
+}
+
+void AsyncSceneSender::commitEntityStates(bool succeeded)
+{
+    // the entities belong to the caller. don't leave the flags behind.
+    for (auto& e : m_geometry_skipped)
+        SetGeometryUnchanged(*e, false);
+    m_geometry_skipped.clear();
+
+    if (succeeded) {
+        for (auto& kvp : m_pending_states)
+            m_entity_states[kvp.first] = kvp.second;
+        for (auto& id : deleted_entities)
+            m_entity_states.erase(id.name);
+    }
+    else {
+        // we don't know what reached the server
+        m_entity_states.clear();
+    }
+    m_pending_states.clear();
+}
+
+Client& AsyncSceneSender::getClient()
+{
+    if (!m_client || m_client->getSettings() != client_settings) {
+        m_client.reset(new Client(client_settings));
+        m_client->setCounters(m_client_counters);
+    }
+    return *m_client;
+}
+
 void AsyncSceneSender::requestLiveEditMessageImpl() {
     auto setup_message = [this](ms::Message& mes) {
         mes.session_id = session_id;
@@ -134,6 +244,8 @@ void AsyncSceneSender::send()
     if(on_before_send)
         on_before_send();
 
+    const mu::nanosec begin = mu::Now();
+
     SetupDataFlags(transforms);
     SetupDataFlags(geometries);
     SetupDataFlags(instanceMeshes);
@@ -150,7 +262,7 @@ void AsyncSceneSender::send()
     auto append = [](auto& dst, auto& src) { dst.insert(dst.end(), src.begin(), src.end()); };
 
     bool succeeded = true;
-    ms::Client client(client_settings);
+    ms::Client& client = getClient();
 
     auto setup_message = [this](ms::Message& mes) {
         mes.session_id = session_id;
@@ -169,6 +281,24 @@ void AsyncSceneSender::send()
             goto cleanup;
     }
 
+    if (skip_unchanged) {
+        // a restarted server has nothing of what we sent before.
+        // a server without a session id can't tell us when it restarts, so nothing is skipped for it.
+        if (client.server_session_id == InvalidID || client.server_session_id != m_entity_states_session) {
+            m_entity_states.clear();
+            m_entity_states_session = client.server_session_id;
+        }
+        const size_t num_entities = transforms.size() + geometries.size();
+        skipUnchanged(transforms, false);
+        skipUnchanged(geometries, true);
+        m_num_entities_skipped += num_entities - (transforms.size() + geometries.size());
+        m_num_geometries_unchanged += m_geometry_skipped.size();
+    }
+    else {
+        // what was sent in the meantime isn't tracked
+        m_entity_states.clear();
+    }
+
     // assets
     if (!assets.empty()) {
         ms::SetMessage mes;
@@ -287,6 +417,14 @@ void AsyncSceneSender::send()
     }
 
 cleanup:
+    ++m_num_sends;
+    if (succeeded)
+        m_num_entities_sent += transforms.size() + geometries.size() + instanceMeshes.size();
+    else
+        ++m_num_failed_sends;
+    m_send_latency.add(mu::Now() - begin);
+
+    commitEntityStates(succeeded);
     if (succeeded) {
         if (on_success)
             on_success();
@@ -2,6 +2,8 @@
 
 #ifndef msRuntime
 
+#include <unordered_map>
+
 #include "MeshSync/SceneExporter.h"
 #include "MeshSync/msClientSettings.h" //ClientSettings
 #include "MeshSync/msClient.h"
@@ -17,6 +19,10 @@ public:
 
     ClientSettings client_settings;
 
+    // drop entities whose checksums match what was last sent to the same server session.
+    // geometries whose transform changed but geometry didn't are sent as transform only.
+    bool skip_unchanged = false;
+
     std::function<void(std::vector<PropertyInfo>, std::vector<EntityPtr>, std::string)> on_live_edit_response_received;
 
 public:
@@ -32,9 +38,24 @@ public:
     void kick() override;
     void requestLiveEditMessage();
 
+    // forget what has been sent. the next send() transfers everything again.
+    void resetEntityStates();
+
+    SenderStats getStats() const;
+    void resetStats();
+
 private:
+    struct EntityState
+    {
+        uint64_t checksum_trans = 0;
+        uint64_t checksum_geom = 0;
+    };
+
     void send();
+    Client& getClient();
     void requestLiveEditMessageImpl();
+    void skipUnchanged(std::vector<TransformPtr>& entities, bool geometry);
+    void commitEntityStates(bool succeeded);
 
     std::future<void> m_future;
     std::future<void> m_live_edit_future;
@@ -42,7 +63,22 @@ private:
     std::atomic_bool m_destroyed{ false };
 
     ms::Client* m_live_edit_client;
+    // kept across sends, so that its shared memory segment and what it learned about the server are reused
+    std::unique_ptr<Client> m_client;
     ms::IdUtility id_utility;
+
+    std::unordered_map<std::string, EntityState> m_entity_states; // keyed by path
+    std::vector<std::pair<std::string, EntityState>> m_pending_states;
+    std::vector<TransformPtr> m_geometry_skipped; // geometries sent with the unchanged flag
+    int m_entity_states_session = InvalidID;
+
+    ClientCountersPtr m_client_counters = std::make_shared<ClientCounters>();
+    std::atomic<uint64_t> m_num_sends{ 0 };
+    std::atomic<uint64_t> m_num_failed_sends{ 0 };
+    std::atomic<uint64_t> m_num_entities_sent{ 0 };
+    std::atomic<uint64_t> m_num_entities_skipped{ 0 };
+    std::atomic<uint64_t> m_num_geometries_unchanged{ 0 };
+    LatencyHistogram m_send_latency;
 };
 
 } // namespace ms
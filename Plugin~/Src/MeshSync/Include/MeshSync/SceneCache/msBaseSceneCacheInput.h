@@ -10,6 +10,18 @@ msDeclClassPtr(BaseSceneCacheInput)
 
 namespace ms {
 
+struct SceneCacheMemoryReport
+{
+    uint64_t budgetBytes = 0;   // 0: limited by the number of samples
+    uint64_t loadedBytes = 0;   // decoded size of the samples held by the cache
+    uint64_t pinnedBytes = 0;   // part of loadedBytes that can't be evicted right now
+    uint64_t evictedBytes = 0;  // total since opened
+    uint64_t evictions = 0;
+    int32_t loadedSamples = 0;
+    int32_t pinnedSamples = 0;
+    int32_t maxLoadedSamples = 0;
+};
+
 class BaseSceneCacheInput
 {
 public:
@@ -20,6 +32,10 @@ public:
     void SetPreloadLength(int v);
     const AnimationCurvePtr GetTimeCurve() const;
 
+    // when not 0, loaded samples are evicted by their decoded size instead of by count
+    inline uint64_t GetMaxLoadedBytes() const;
+    inline void SetMaxLoadedBytes(uint64_t v);
+
     virtual float GetSampleRateV() const = 0;
     virtual TimeRange GetTimeRangeV() const = 0;
     virtual size_t GetNumScenesV() const = 0;
@@ -30,6 +46,17 @@ public:
     virtual void RefreshV() = 0;
     virtual void PreloadV(int frame) = 0;
     virtual const AnimationCurvePtr GetFrameCurveV(int baseFrame) = 0;
+    virtual SceneCacheMemoryReport GetMemoryReportV() const = 0;
+
+    // partial loading. the returned scene has only the given entities, and is not kept in the cache.
+    virtual ScenePtr LoadEntitiesByFrameV(int32_t frame, const std::vector<int>& ids) = 0;
+    virtual int FindEntityIDV(const std::string& path) const = 0; // InvalidID if not found
+
+    // ids of the geometries whose world space bounds intersect the box or the frustum at the frame.
+    // no decoding is involved. returns false if the file has no bounds.
+    // frustum planes face inward: dot(plane.xyz, p) + plane.w >= 0 is inside, as UnityEngine.Plane.
+    virtual bool FindEntitiesInBoxV(int32_t frame, const mu::float3& bmin, const mu::float3& bmax, std::vector<int>& dst) const = 0;
+    virtual bool FindEntitiesInFrustumV(int32_t frame, const mu::float4 planes[6], std::vector<int>& dst) const = 0;
 
 protected:
 
@@ -46,6 +73,7 @@ private:
 
     int32_t m_maxLoadedSamples = 3;
     int32_t m_preloadLength = 1;
+    uint64_t m_maxLoadedBytes = 0;
 
 };
 
@@ -53,6 +81,9 @@ private:
 
 int32_t BaseSceneCacheInput::GetPreloadLength() const { return m_preloadLength; }
 
+uint64_t BaseSceneCacheInput::GetMaxLoadedBytes() const { return m_maxLoadedBytes; }
+void BaseSceneCacheInput::SetMaxLoadedBytes(const uint64_t v) { m_maxLoadedBytes = v; }
+
 inline int32_t BaseSceneCacheInput::GetMaxLoadedSamples() const { return m_maxLoadedSamples; }
 void BaseSceneCacheInput::SetMaxLoadedSamples(const int32_t sampleCount) { m_maxLoadedSamples = sampleCount; }
 
@@ -2,6 +2,7 @@
 
 #include "MeshSync/SceneCache/msSceneCacheExportSettings.h"
 #include "MeshSync/msConfig.h"
+#include "MeshUtils/muMath.h" //float3
 
 namespace ms {
 
@@ -37,4 +38,32 @@ struct CacheFileEntityMeta
     uint32_t constantTopology : 1;
 };
 
+// optional. follows the meta data. older files end before it.
+// the encoded body has the paths of all entities (id, path) and, for each scene in file order,
+// the ids of the entities each segment holds. segment byte ranges come from the scene headers.
+struct CacheFileIndexHeader
+{
+    char magic[4] = { 'M', 'S', 'I', 'X' };
+    uint32_t reserved = 0;
+    uint64_t size = 0;
+};
+
+// optional. follows the entity index. the encoded body is an array of CacheFileEntityBounds.
+struct CacheFileBoundsHeader
+{
+    char magic[4] = { 'M', 'S', 'B', 'X' };
+    uint32_t reserved = 0;
+    uint64_t size = 0;
+};
+
+// world space AABB of a geometry over a range of scenes that share it. scenes are counted in time order.
+struct CacheFileEntityBounds
+{
+    int id = 0;
+    int frameBegin = 0;
+    int frameEnd = 0; // exclusive
+    mu::float3 bmin = mu::float3::zero();
+    mu::float3 bmax = mu::float3::zero();
+};
+
 } // namespace ms
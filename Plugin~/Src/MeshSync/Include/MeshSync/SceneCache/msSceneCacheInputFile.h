@@ -5,6 +5,7 @@
 #include "MeshSync/SceneCache/msBaseSceneCacheInput.h"
 #include "MeshSync/SceneCache/msCacheFileHeader.h"
 #include "MeshSync/SceneCache/msSceneCacheInputSettings.h"
+#include "MeshSync/SceneCache/msSceneCacheRewriteSettings.h"
 
 
 msDeclClassPtr(SceneCacheInputFile)
@@ -23,9 +24,32 @@ public:
     static SceneCacheInputFilePtr Open(const char *path, const SceneCacheInputSettings& iscs);
     static SceneCacheInputFile*   OpenRaw(const char *path, const SceneCacheInputSettings& iscs);
 
+    // shards are files written independently for disjoint time ranges of the same scene.
+    // they must share encoding and sample rate. scenes of a shard written with stripUnchanged are merged
+    // with the first scene of that shard.
+    static SceneCacheInputFilePtr OpenShards(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs);
+    static SceneCacheInputFile*   OpenShardsRaw(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs);
+
+    // stitch shards into one file. encoded scenes are copied as they are, except when shards after the first one
+    // were written with stripUnchanged: then all scenes are decoded and stripped again against the first scene.
+    static bool MergeShards(const char *dstPath, const std::vector<std::string>& shardPaths);
+
     bool IsValid() const;
+    bool IsLoaded(int frame) const;
+    bool HasEntityIndex() const;
     void PreloadAll();
 
+    // write the scenes to another file. encoded segments are copied without decoding unless the encoding changes.
+    // dropping the first scene of a file written with stripUnchanged re-encodes the scenes, as they are stripped against it.
+    bool Rewrite(const char *path, const SceneCacheRewriteSettings& settings);
+
+    // for inspection
+    const CacheFileHeader& GetHeader() const;
+    const RawVector<CacheFileEntityMeta>& GetEntityMeta() const;
+    const std::map<std::string, int>& GetEntityIDs() const; // path -> id. empty if the file has no index
+    size_t GetSegmentCount(int frame) const;
+    uint64_t GetSegmentSize(int frame, int segment) const; // encoded
+
     //Virtual
     float GetSampleRateV() const override;
     size_t GetNumScenesV() const override;
@@ -37,18 +61,34 @@ public:
     void RefreshV() override;
     void PreloadV(int frame) override;
     const AnimationCurvePtr GetFrameCurveV(int baseFrame) override;
-
+    SceneCacheMemoryReport GetMemoryReportV() const override;
+    ScenePtr LoadEntitiesByFrameV(int32_t frame, const std::vector<int>& ids) override;
+    int FindEntityIDV(const std::string& path) const override;
+    bool FindEntitiesInBoxV(int32_t frame, const mu::float3& bmin, const mu::float3& bmax, std::vector<int>& dst) const override;
+    bool FindEntitiesInFrustumV(int32_t frame, const mu::float4 planes[6], std::vector<int>& dst) const override;
 
 private:
     SceneCacheInputFile() = default;
-    void Init(const char *path, const SceneCacheInputSettings& iscs);
+    struct Shard;
+    void Init(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs);
     static StreamPtr CreateStream(const char *path, const SceneCacheInputSettings& iscs);
+    static bool ReadShard(const StreamPtr& stream, Shard& dst);
+    bool RewriteEncoded(const char *path, const SceneCacheRewriteSettings& settings, size_t begin, size_t end);
+    bool RewriteDecoded(const char *path, const SceneCacheRewriteSettings& settings, size_t begin, size_t end);
 
+    template<class Body> bool EachEntityBounds(int32_t frame, const Body& body) const;
+    ScenePtr GetBaseScene(size_t sceneIndex) const;
     ScenePtr LoadByFrameInternal(size_t sceneIndex, bool waitPreload = true);
+    ScenePtr DecodeScene(size_t sceneIndex, bool preload);
+    ScenePtr GenerateVelocities(const ScenePtr& scene, size_t sceneIndex);
+    ScenePtr LoadEntitiesInternal(size_t sceneIndex, const std::vector<int>& ids);
     ScenePtr PostProcess(ScenePtr& sp, size_t sceneIndex);
     bool KickPreload(size_t i);
     void WaitAllPreloads();
+    void TrackPlayback(int frame);
     void PopOverflowedSamples();
+    bool IsPinned(size_t sceneIndex) const;
+    uint64_t GetLoadedSize(size_t sceneIndex) const;
 
 private:
     struct SceneSegment
@@ -68,6 +108,7 @@ private:
 
     struct SceneRecord
     {
+        StreamPtr stream; // shared by the records of the same shard
         uint64_t pos = 0;
         uint64_t bufferSizeTotal = 0;
         float time = 0.0f;
@@ -75,10 +116,12 @@ private:
         ScenePtr scene;
         std::future<void> preload;
         RawVector<uint64_t> bufferSizes;
-        std::vector<SceneSegment> segments;
+        std::vector<std::vector<int>> segmentEntities; // from the entity index. empty if the file has none
+        int base = -1; // record this one was stripped against: the first of its shard. -1 if its shard isn't stripped
     };
 
-    StreamPtr m_stream;
+    void DecodeSegment(SceneSegment& seg, size_t sceneIndex, size_t segmentIndex);
+
     CacheFileHeader m_header;
     BufferEncoderPtr m_encoder;
 
@@ -86,11 +129,39 @@ private:
     std::vector<SceneRecord> m_records;
     RawVector<CacheFileEntityMeta> m_entityMeta;
     AnimationCurvePtr m_frameCurve;
+    std::map<std::string, int> m_entityIDs; // path -> id
+    bool m_hasEntityIndex = false;
+    RawVector<CacheFileEntityBounds> m_entityBounds; // in id order
+    bool m_hasBounds = false;
+    ScenePtr m_lastEntities;
 
     float m_lastTime = -1.0f;
-    int m_loadedFrame0 = -1, m_loadedFrame1 = -1;
-    ScenePtr m_baseScene, m_lastScene, m_lastDiff;
+    std::atomic<int> m_loadedFrame0{ -1 }, m_loadedFrame1{ -1 };
+    std::map<size_t, ScenePtr> m_baseScenes; // record index -> first scene of a stripped shard. pinned while the file is open
+    ScenePtr m_lastScene, m_lastDiff;
+    ScenePtr m_lerpScenes[2];
+    int m_lerpSceneIndex = 0;
+
+    // loaded samples in LRU order. guards SceneRecord::scene too, preload threads load and evict concurrently.
+    mutable std::mutex m_historyMutex;
     std::deque<size_t> m_history;
+    ScenePtr m_decodedNeighbor; // decoded by GenerateVelocities(), without velocities of its own. not in the history
+    size_t m_decodedNeighborIndex = 0;
+    uint64_t m_evictions = 0;
+    uint64_t m_evictedBytes = 0;
+    float m_averageLoadTime = 0.0f;    // in ms
+    float m_averageSampleSize = 0.0f;
+
+    // playback tracking for the preload scheduler
+    int m_playbackFrame = -1;
+    mu::nanosec m_playbackTime = 0;
+    int m_playbackDirection = 1;
+    float m_playbackStride = 1.0f;     // frames per step
+    float m_playbackInterval = 0.0f;   // ms per step
+    std::vector<size_t> m_preloading;
+    std::vector<std::atomic_bool> m_preloadCancelled;
+    std::atomic<int> m_preloadWindow0{ -1 }, m_preloadWindow1{ -1 };
+    bool m_preloadingAll = false;
 
 };
 
@@ -11,6 +11,7 @@ struct SceneCacheOutputSettings : SceneImportSettings
 {
     SceneCacheExportSettings exportSettings;
     int maxQueueSize = 4;
+    uint64_t maxQueueBytes = 0; // serialized size of the scenes not written yet. 0: no limit
     int maxSceneSegments = 8;
 };
 
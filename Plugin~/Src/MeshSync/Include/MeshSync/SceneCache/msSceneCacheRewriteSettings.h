@@ -0,0 +1,23 @@
+#pragma once
+
+#include <limits>
+
+#include "MeshSync/SceneCache/msSceneCacheEncoding.h"
+#include "MeshSync/SceneCache/msSceneCacheEncoderSettings.h"
+#include "MeshSync/msTimeRange.h"
+
+namespace ms {
+
+// NOT serialized in cache file. see SceneCacheInputFile::Rewrite()
+struct SceneCacheRewriteSettings
+{
+    // scenes outside are dropped
+    TimeRange timeRange = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
+
+    // segments are decoded and encoded again only when this is set. otherwise they are copied as they are.
+    bool changeEncoding = false;
+    SceneCacheEncoding encoding = SceneCacheEncoding::ZSTD;
+    SceneCacheEncoderSettings encoderSettings = {};
+};
+
+} // namespace ms
@@ -18,6 +18,7 @@ public:
     ~SceneCacheWriter() override;
 
     bool Open(const char *path, const SceneCacheOutputSettings& oscs);
+    bool Open(std::shared_ptr<std::ostream> stream, const SceneCacheOutputSettings& oscs); // the stream is written from the writer thread
     void Close();
     bool IsValid() const;
     inline void SetTime(float time);
@@ -26,6 +27,7 @@ public:
     bool isExporting() override;
     void wait() override;
     void kick() override;
+    bool tryKick(); // kick() if the file can take the scene without blocking. the data is kept otherwise
 
 private:
     static SceneCacheOutputFilePtr OpenOSceneCacheFile(const char *path, const SceneCacheOutputSettings& oscs);
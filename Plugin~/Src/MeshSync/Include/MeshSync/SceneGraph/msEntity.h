@@ -21,7 +21,8 @@ template<> struct GetEntityType<Mesh>       { static const EntityType type = Ent
 template<> struct GetEntityType<Points>     { static const EntityType type = EntityType::Points; };
 
 
-class Entity
+// shared_from_this() lets copy-on-write clones keep their source alive (see clone())
+class Entity : public std::enable_shared_from_this<Entity>
 {
 public:
     using Type = EntityType;
@@ -37,6 +38,7 @@ public:
         uint32_t constant : 1;
         uint32_t constant_topology : 1;
     } cache_flags{};
+    std::vector<SharedBuffersPtr> cow_buffers; // keep the sources of a copy-on-write clone alive
 
 protected:
     Entity();
@@ -57,15 +59,21 @@ public:
     virtual bool merge(const Entity& base);
     virtual bool diff(const Entity& e1, const Entity& e2);
     virtual bool lerp(const Entity& e1, const Entity& e2, float t);
+    virtual void swapLerpBuffers(Entity& v); // exchange the buffers lerp() writes to. used to recycle them.
     virtual void updateBounds();
-    virtual bool genVelocity(const Entity& prev); // todo
+    virtual bool getBounds(Bounds& dst) const; // local space. false if the entity has no geometry
+    virtual bool genVelocity(const Entity& neighbor, float interval); // interval: time of this - time of neighbor. false if nothing is written
 
     virtual void clear();
     virtual uint64_t hash() const;
     virtual uint64_t checksumTrans() const;
     virtual uint64_t checksumGeom() const;
     virtual uint64_t vertexCount() const;
+    // without detach, the clone views the buffers of this entity. with detach, it keeps sharing them copy-on-write
+    // as long as this entity is held by a shared_ptr and left unmodified. this entity itself is not touched.
     virtual std::shared_ptr<Entity> clone(bool detach = false);
+    // the copy-on-write part of clone(): called on a plain copy of src. owner keeps src alive, can be null.
+    virtual void shareBuffers(const Entity& src, const std::shared_ptr<const void>& owner);
 
     Identifier getIdentifier() const;
     bool isRoot() const;
@@ -41,13 +41,17 @@ public:
     bool merge(const Entity& base) override;
     bool diff(const Entity& e1, const Entity& e2) override;
     bool lerp(const Entity& e1, const Entity& e2, float t) override;
+    bool genVelocity(const Entity& neighbor, float interval) override;
+    void swapLerpBuffers(Entity& v) override;
     void updateBounds() override;
+    bool getBounds(Bounds& dst) const override;
 
     void clear() override;
     uint64_t hash() const override;
     uint64_t checksumGeom() const override;
     uint64_t vertexCount() const override;
     EntityPtr clone(bool detach = false) override;
+    void shareBuffers(const Entity& src, const std::shared_ptr<const void>& owner) override;
 
     void setupPointsDataFlags();
 };
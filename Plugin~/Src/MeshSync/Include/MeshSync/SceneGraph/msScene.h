@@ -51,7 +51,7 @@ struct SceneDataFlags
     SceneDataFlags();
 };
 
-class Scene
+class Scene : public std::enable_shared_from_this<Scene>
 {
 public:
     // serializable
@@ -67,6 +67,7 @@ public:
     // non-serializable
     std::list<RawVector<char>> scene_buffers;
     std::vector<std::shared_ptr<Scene>> data_sources; // keep references for lerp sources etc
+    std::vector<SharedBuffersPtr> cow_buffers; // keep the sources of a copy-on-write clone alive
     SceneProfileData profile_data{};
 
 protected:
@@ -76,6 +77,10 @@ public:
     msDefinePool(Scene);
     static std::shared_ptr<Scene> create(std::istream& is);
 
+    // without detach, the clone shares vertex buffers with this scene and has to be released first.
+    // with detach, buffers are shared copy-on-write: the clone copies an attribute when it modifies it,
+    // and holds this scene and its entities so that it can outlive them. this scene is not touched and can be cloned
+    // on multiple threads at once, but has to be left unmodified while clones share its buffers (as loaded scenes are).
     std::shared_ptr<Scene> clone(bool detach = false);
     void serialize(std::ostream& os) const;
     void deserialize(std::istream& is); // throw
@@ -85,6 +90,7 @@ public:
     void merge(Scene& base);
     void diff(const Scene& src1, const Scene& src2);
     void lerp(const Scene& src1, const Scene& src2, float t);
+    void genVelocities(const Scene& neighbor, float interval); // entities of both have to be sorted by id
     void clear();
     uint64_t hash() const;
 
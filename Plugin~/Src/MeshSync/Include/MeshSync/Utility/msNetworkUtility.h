@@ -7,6 +7,7 @@ class NetworkUtils
 {
 public:
     static bool IsInLocalNetwork(const std::string& hostAndPort);
+    static bool IsLocalHost(const std::string& host);
 };
 
 
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <functional>
+
+#include "MeshUtils/muRawVector.h"
+#include "MeshUtils/muStream.h"
+
+#include "MeshSync/msProtocol.h"
+#include "MeshSync/msClientSettings.h" //ClientSettings
+
+namespace Poco {
+    namespace Net {
+        class StreamSocket;
+    }
+}
+
+msDeclClassPtr(Channel)
+
+namespace ms {
+
+// one unit of data on a Channel. a request and its replies share the stream id.
+// replies are Response frames carrying a ResponseMessage. frames pushed on the live edit stream
+// have the type RequestServerLiveEdit and carry a ServerLiveEditResponse.
+struct ChannelFrame
+{
+    static const uint32_t Magic = 0x4843534d; // "MSCH"
+    static const uint64_t MaxPayloadSize = 0x40000000; // 1 GiB. default limit of Channel::read()
+
+    uint32_t stream_id = 0;
+    Message::Type type = Message::Type::Unknown;
+    RawVector<char> payload;
+};
+
+// persistent full-duplex connection carrying length-prefixed frames.
+// a frame is a 24 byte little-endian header (magic, stream id, message type, reserved, payload size)
+// followed by the serialized message.
+// write() can be called from any thread. frames never interleave.
+// read() must be called from a single thread.
+class Channel
+{
+public:
+    Channel(const Poco::Net::StreamSocket& socket);
+    ~Channel();
+
+    bool read(ChannelFrame& dst);
+    bool write(uint32_t stream_id, Message::Type type, const void *data, size_t size);
+    template<class T> bool write(uint32_t stream_id, Message::Type type, const T& payload);
+    void close();
+    bool isClosed() const;
+    uint64_t getBytesSent() const;
+    uint64_t getBytesReceived() const;
+
+    // read() closes the channel when a frame announces a larger payload
+    void setMaxPayloadSize(uint64_t v);
+
+private:
+    bool sendAll(const void *data, size_t size);
+    bool receiveAll(void *data, size_t size);
+
+    std::unique_ptr<Poco::Net::StreamSocket> m_socket;
+    std::mutex m_write_mutex;
+    std::atomic_bool m_closed{ false };
+    std::atomic<uint64_t> m_bytes_sent{ 0 };
+    std::atomic<uint64_t> m_bytes_received{ 0 };
+    uint64_t m_max_payload_size = ChannelFrame::MaxPayloadSize;
+};
+
+template<class T>
+inline bool Channel::write(uint32_t stream_id, Message::Type type, const T& payload)
+{
+    mu::MemoryStream ms;
+    payload.serialize(ms);
+    ms.flush();
+    const auto& buf = ms.getBuffer();
+    return write(stream_id, type, buf.cdata(), buf.size());
+}
+
+
+// client side of the channel. requests are multiplexed: any thread can send() while others wait for their replies.
+// a reader thread routes replies by stream id and delivers pushed live edits to on_live_edit.
+// disconnect() can be called while other threads send. their requests fail.
+class ChannelClient
+{
+public:
+    ChannelClient(const ClientSettings& settings);
+    ~ChannelClient();
+
+    bool connect();
+    void disconnect();
+    bool isConnected() const;
+
+    // send a message and wait for the server's reply. returns null on failure or timeout.
+    // Get, Screenshot and Poll go through HTTP (Client). the server answers them with an error here.
+    ResponseMessagePtr send(const Message& mes);
+
+    // keep a live edit stream open. the server pushes a response every time Unity has edits.
+    bool subscribeLiveEdit(const ServerLiveEditRequest& mes);
+    std::function<void(ServerLiveEditResponse&)> on_live_edit;
+
+private:
+    void disconnectImpl();
+    ChannelPtr getChannel() const;
+    void readerMain(ChannelPtr channel);
+
+    ClientSettings m_settings;
+    ChannelPtr m_channel;
+    std::thread m_reader;
+    std::mutex m_connect_mutex; // serializes connect() and disconnect()
+    mutable std::mutex m_mutex; // m_channel and m_pending
+    std::map<uint32_t, std::promise<ChannelFrame>> m_pending;
+    std::atomic<uint32_t> m_stream_seed{ 0 };
+    std::atomic<uint32_t> m_live_edit_stream{ 0 };
+};
+
+} // namespace ms
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <ostream>
+#include <functional>
+
+#include "MeshUtils/muRawVector.h"
+#include "MeshUtils/muMisc.h" //nanosec
+
+namespace ms {
+
+// a SetMessage too large for one request is sent as consecutive byte ranges of its serialized form.
+// every answer tells the sender how many contiguous bytes the receiver has, which is where the sender
+// continues after a dropped chunk, a lost response or a receiver that forgot the transfer.
+
+// the unit is bytes of the whole message, not entities: a transfer is imported once it is complete.
+// what chunking bounds is the size of each request and what a dropped connection costs.
+
+// receiver side. thread safe.
+// memory is bounded by MaxTotalBytes across all transfers. when a new transfer or a chunk doesn't fit,
+// the transfers that were continued least recently are dropped. their senders start over when they notice.
+class ChunkAssembler
+{
+public:
+    enum class Result
+    {
+        Accepted,   // the chunk continues the transfer (or was already received)
+        Completed,  // the chunk completed the transfer. body receives the whole message
+        OutOfOrder, // the chunk starts past what was received. the sender should continue from received
+    };
+
+    // transfers that haven't been continued for this long are dropped
+    static const mu::nanosec DefaultTimeoutNS = 60ull * 1000000000ull;
+    // transfers being assembled at once
+    static const int MaxTransfers = 16;
+    // bytes held by all transfers together
+    static const uint64_t DefaultMaxTotalBytes = 0x40000000; // 1 GiB
+
+    void setTimeout(mu::nanosec v);
+    mu::nanosec getTimeout() const;
+    // a transfer larger than this fails
+    void setMaxTotalBytes(uint64_t v);
+    uint64_t getMaxTotalBytes() const;
+
+    // total_size must already be validated by the caller. memory grows with what actually arrived.
+    Result append(const std::string& id, uint64_t total_size, uint64_t offset, const char *data, size_t size,
+        RawVector<char>& body, uint64_t& received); // throw
+    void clear();
+    int getNumTransfers() const;
+    uint64_t getTotalBytes() const;
+
+private:
+    struct Transfer
+    {
+        RawVector<char> data;
+        uint64_t total_size = 0;
+        mu::nanosec last_update = 0;
+    };
+    using Transfers = std::map<std::string, Transfer>;
+
+    void erase(Transfers::iterator it);
+    bool evictStalest(const std::string& keep);
+
+    Transfers m_transfers;
+    std::deque<std::string> m_completed; // recent ids, so that a resent last chunk isn't imported again
+    mu::nanosec m_timeout = DefaultTimeoutNS;
+    uint64_t m_max_total_bytes = DefaultMaxTotalBytes;
+    uint64_t m_total_bytes = 0;
+    mutable std::mutex m_mutex;
+};
+
+// sender side. serializes the message into a buffer of one chunk and uploads it every time it fills up,
+// so a huge message never exists as a whole. the message is serialized again only if the receiver lost
+// data that was already flushed; bytes the receiver reports as received are never sent twice.
+class ChunkUploader
+{
+public:
+    // returned by Upload instead of a byte count
+    static const int64_t NoAnswer = -1; // the chunk is retried
+    static const int64_t Rejected = -2; // the transfer fails
+
+    // send one byte range. return the number of contiguous bytes the receiver has after it.
+    using Upload = std::function<int64_t(const char *data, size_t size, uint64_t offset)>;
+    using Serialize = std::function<void(std::ostream&)>;
+
+    static const int MaxAttempts = 3; // per chunk, without progress
+    static const int MaxPasses = 3;   // serializations of the whole message
+
+    ChunkUploader(size_t chunk_size, const Upload& upload);
+    bool send(const Serialize& serialize, uint64_t total_size);
+
+    // stats of the last send()
+    int getNumPasses() const;
+    uint64_t getNumBytesSent() const;
+
+private:
+    size_t m_chunk_size;
+    Upload m_upload;
+    int m_num_passes = 0;
+    uint64_t m_num_bytes_sent = 0;
+};
+
+} // namespace ms
@@ -2,18 +2,36 @@
 
 #include "msProtocol.h"
 #include "msClientSettings.h" //ClientSettings
+#include "msStats.h" //ClientCounters
 
 #include "MeshSync/msClient.h"
 #include "MeshSync/SceneGraph/msScene.h" //Scene
 
+namespace Poco {
+    class SharedMemory;
+    namespace Net {
+        class HTTPResponse;
+    }
+}
+
 namespace ms {
 
+class ChannelClient;
+
 class Client
 {
 public:
     Client(const ClientSettings& settings);
+    ~Client();
 
     const std::string& getErrorMessage() const;
+    const ClientSettings& getSettings() const;
+
+    // round trips of Set/Delete/Fence messages
+    ClientStats getStats() const;
+    void resetStats();
+    // accumulate into counters shared with other clients. null gives this client its own again.
+    void setCounters(ClientCountersPtr v);
 
     // if failed, you can get reason by getErrorMessage()
     // (could not reach server, protocol version doesn't match, etc)
@@ -36,8 +54,39 @@ public:
 
     void abortLiveEditRequest();
 private:
+    enum class SendResult
+    {
+        Sent,
+        Rejected,    // the server answered with an error. it doesn't have the message
+        Failed,      // no answer. the server may or may not have the message
+        Unavailable, // the transport can't be used. the server doesn't have the message
+    };
+
+    void updateServerCapabilities(const Poco::Net::HTTPResponse& response);
+    bool post(const char *uri, const Message& mes);
+    bool sendSet(const SetMessage& mes, uint64_t size);
+    bool shouldCompress(uint64_t size) const;
+    bool shouldUseSharedMemory(uint64_t size) const;
+    SendResult sendSharedMemory(const SetMessage& mes, uint64_t size);
+    SendResult sendChannel(const Message& mes);
+    bool shouldSendChunked(uint64_t size) const;
+    bool sendChunked(const SetMessage& mes, uint64_t size);
+    int64_t sendChunk(const std::string& transfer_id, uint64_t total_size, const char *data, size_t size, uint64_t offset);
+
     ClientSettings m_settings;
     std::string m_error_message;
+    ClientCountersPtr m_counters;
+    bool m_server_accepts_zstd = false;
+    bool m_server_accepts_shm = false;
+    bool m_shm_disabled = false;
+    bool m_server_accepts_chunks = false;
+
+    // reused for all SetMessages sent by this client. grows on demand.
+    std::unique_ptr<Poco::SharedMemory> m_shm;
+    std::string m_shm_name;
+    size_t m_shm_capacity = 0;
+
+    std::unique_ptr<ChannelClient> m_channel; // connected on the first message that can use it
 };
 
 } // namespace ms
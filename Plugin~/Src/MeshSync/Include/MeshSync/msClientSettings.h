@@ -9,6 +9,34 @@ struct ClientSettings {
     uint16_t port = 8080;
     int timeout_ms = 30000;
     std::string dcc_tool_name = "";
+    // port of the server's persistent channel (ChannelClient). 0 if not used.
+    // when set, Client sends Set, Delete and Fence messages through it and falls back to HTTP while it can't connect.
+    uint16_t channel_port = 0;
+
+    // compress SetMessages with zstd when the server accepts it.
+    // messages smaller than compression_threshold (in bytes) are sent as is.
+    bool compression = true;
+    int compression_threshold = 64 * 1024;
+    int compression_level = 1;
+
+    // pass SetMessages through shared memory when the server runs on this machine and supports it.
+    // messages smaller than shared_memory_threshold (in bytes) go through HTTP.
+    bool shared_memory = true;
+    int shared_memory_threshold = 1024 * 1024;
+
+    // SetMessages larger than chunk_size (in bytes) are sent in chunks of that size when the server supports it.
+    // 0 disables chunking.
+    int chunk_size = 32 * 1024 * 1024;
 };
 
+inline bool operator==(const ClientSettings& a, const ClientSettings& b)
+{
+    return a.server == b.server && a.port == b.port && a.timeout_ms == b.timeout_ms && a.dcc_tool_name == b.dcc_tool_name &&
+        a.channel_port == b.channel_port &&
+        a.compression == b.compression && a.compression_threshold == b.compression_threshold && a.compression_level == b.compression_level &&
+        a.shared_memory == b.shared_memory && a.shared_memory_threshold == b.shared_memory_threshold &&
+        a.chunk_size == b.chunk_size;
+}
+inline bool operator!=(const ClientSettings& a, const ClientSettings& b) { return !(a == b); }
+
 } // namespace ms
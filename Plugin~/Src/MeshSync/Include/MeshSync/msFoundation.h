@@ -11,6 +11,8 @@
 #include "MeshUtils/muSIMD.h" //SumInt32
 #include "MeshUtils/muStream.h" //MemoryStream
 
+#include "MeshSync/msPool.h" //Pool
+
 #if defined(_MSC_VER)
     #define msPacked 
 #else
@@ -359,58 +361,71 @@ template<class T> inline uint64_t csum(const T& v) { return csum_impl<T>()(v); }
 
 
 
-template<class T>
-class Pool
+class SharedBuffers;
+using SharedBuffersPtr = std::shared_ptr<SharedBuffers>;
+
+// keeps what copy-on-write clones share with their source alive (see Scene::clone()). never modified once handed out.
+// the source itself is left as it is. it holds no reference to its clones and has to stay unmodified while they share it.
+class SharedBuffers
 {
 public:
-    static Pool& instance()
+    // dst is the clone's copy of src and views its data. it keeps doing so if one of held covers the data,
+    // or if src owns it and owner keeps src alive. this holder then covers it for clones of the clone.
+    // otherwise dst copies the data, so that it doesn't dangle once src is gone.
+    template<class T, int A>
+    void share(SharedVector<T, A>& dst, const SharedVector<T, A>& src, const std::vector<SharedBuffersPtr>& held, const std::shared_ptr<const void>& owner)
     {
-        static Pool s_instance;
-        return s_instance;
+        if (src.empty() || dst.cdata() != src.cdata())
+            return;
+        if (src.is_shared()) {
+            if (Contains(held, src.cdata()))
+                return;
+        }
+        else if (owner) {
+            hold(owner, src.cdata(), src.size_in_byte());
+            return;
+        }
+        dst.detach();
     }
 
-    T* pull()
+    // owner keeps [p, p + size) alive
+    void hold(const std::shared_ptr<const void>& owner, const void *p, size_t size)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (!m_pool.empty()) {
-            T* ret = m_pool.back();
-            m_pool.pop_back();
-            ++m_used;
-            return ret;
-        }
-        else {
-            ++m_capacity;
-            ++m_used;
-            return new T();
-        }
+        m_buffers.push_back({ owner, p, static_cast<const char*>(p) + size });
     }
 
-    void push(T *v)
+    bool empty() const { return m_buffers.empty(); }
+
+    bool contains(const void *p) const
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_pool.push_back(v);
-        --m_used;
+        for (auto& b : m_buffers) {
+            if (p >= b.begin && p < b.end)
+                return true;
+        }
+        return false;
     }
 
-    void release()
+    static bool Contains(const std::vector<SharedBuffersPtr>& holders, const void *p)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        for (T *v : m_pool)
-            delete v;
-        m_pool.clear();
-        m_capacity = m_used = 0;
+        for (auto& h : holders) {
+            if (h->contains(p))
+                return true;
+        }
+        return false;
     }
 
 private:
-    Pool() {}
-    ~Pool() { release(); }
+    struct Buffer
+    {
+        std::shared_ptr<const void> owner;
+        const void *begin;
+        const void *end;
+    };
 
-    std::vector<T*> m_pool;
-    std::mutex m_mutex;
-    int m_capacity = 0;
-    int m_used = 0;
+    std::vector<Buffer> m_buffers;
 };
 
+
 template<class T>
 struct releaser
 {
@@ -441,6 +456,7 @@ std::shared_ptr<T> make_shared_ptr(T *p)
 
 #define msDefinePool(T)\
     friend class Pool<T>;\
+    static const char* getPoolName() { return #T; }\
     static T* create_raw()\
     {\
         return Pool<T>::instance().pull();\
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ms {
+
+struct PoolStats
+{
+    uint64_t num_hits = 0;      // pulls served by a pooled object
+    uint64_t num_misses = 0;    // pulls that had to allocate
+    uint64_t num_trimmed = 0;   // pooled objects deleted by trim() or the retention limit
+    int num_allocated = 0;      // objects alive, in use or pooled
+    int num_retained = 0;       // objects in the shared stack
+    int num_cached = 0;         // objects in thread-local caches of threads that are alive
+};
+
+// type independent part of Pool. pools register themselves on construction so that they can be listed.
+class PoolBase
+{
+public:
+    // objects move between thread-local caches and the shared stack in batches of this size
+    static const int BatchSize = 32;
+
+    static int getPoolCount();
+    static PoolBase* getPool(int i); // null if out of range
+    static PoolBase* findPool(const char *name);
+
+    const char* getName() const;
+    size_t getObjectSize() const;
+    PoolStats getStats() const;
+    void resetStats();
+
+    // max objects kept in the shared stack. batches returned beyond it are deleted.
+    int getMaxRetained() const;
+    void setMaxRetained(int v);
+
+    // delete the objects in the shared stack and in the calling thread's cache.
+    // other threads delete their caches the next time they pull or push. idle threads keep them until they exit.
+    virtual void trim() = 0;
+
+protected:
+    PoolBase(const char *name, size_t object_size);
+    virtual ~PoolBase();
+
+    // thread-local caches publish their object count for getStats()
+    void addCache(const std::atomic<int> *count);
+    void removeCache(const std::atomic<int> *count);
+
+    const char *m_name = nullptr;
+    size_t m_object_size = 0;
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+    std::atomic<uint64_t> m_trimmed{ 0 };
+    std::atomic<int> m_allocated{ 0 };
+    std::atomic<int> m_retained{ 0 };
+    std::atomic<int> m_max_retained{ INT_MAX };
+    std::atomic<uint32_t> m_trim_generation{ 0 }; // incremented by trim(). caches of an older generation are deleted
+
+    mutable std::mutex m_caches_mutex;
+    std::vector<const std::atomic<int>*> m_caches;
+};
+
+
+// each thread caches up to two batches of free objects. pull() and push() only touch the shared stack
+// when the cache runs empty or full, and then move a whole batch at once.
+// pushing to the shared stack is lock-free. pops are serialized by a flag held for a single CAS,
+// which rules out ABA without tagged pointers.
+// hits are counted per thread and folded into the pool when a batch is exchanged or the thread exits.
+template<class T>
+class Pool : public PoolBase
+{
+public:
+    static Pool& instance()
+    {
+        static Pool s_instance;
+        return s_instance;
+    }
+
+    T* pull()
+    {
+        LocalCache& local = getLocalCache();
+        if (local.trim_generation != m_trim_generation.load(std::memory_order_relaxed))
+            trimLocal(local);
+        if (local.count == 0)
+            refill(local);
+        if (local.count > 0) {
+            ++local.hits;
+            T *ret = local.items[--local.count];
+            local.publish();
+            return ret;
+        }
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        m_allocated.fetch_add(1, std::memory_order_relaxed);
+        return new T();
+    }
+
+    void push(T *v)
+    {
+        LocalCache& local = getLocalCache();
+        if (local.trim_generation != m_trim_generation.load(std::memory_order_relaxed))
+            trimLocal(local);
+        local.items[local.count++] = v;
+        if (local.count == LocalCapacity)
+            flush(local, BatchSize);
+        local.publish();
+    }
+
+    void trim() override
+    {
+        m_trim_generation.fetch_add(1, std::memory_order_relaxed);
+        trimLocal(getLocalCache());
+        trimShared();
+    }
+
+private:
+    static const int LocalCapacity = BatchSize * 2;
+
+    struct Batch
+    {
+        Batch *next = nullptr;
+        int count = 0;
+        T *items[BatchSize];
+    };
+
+    struct LocalCache
+    {
+        T *items[LocalCapacity];
+        int count = 0;
+        uint64_t hits = 0;
+        Batch *spare = nullptr; // node of the last popped batch. reused by the next flush
+        uint32_t trim_generation = 0;
+        std::atomic<int> published_count{ 0 }; // count as seen by other threads. a plain store, no RMW
+
+        LocalCache()
+        {
+            Pool& pool = instance();
+            trim_generation = pool.m_trim_generation.load(std::memory_order_relaxed);
+            pool.addCache(&published_count);
+        }
+
+        ~LocalCache()
+        {
+            Pool& pool = instance();
+            pool.drain(*this);
+            pool.removeCache(&published_count);
+        }
+
+        void publish() { published_count.store(count, std::memory_order_relaxed); }
+    };
+
+    Pool() : PoolBase(T::getPoolName(), sizeof(T)) {}
+    ~Pool() override { trimShared(); }
+
+    static LocalCache& getLocalCache()
+    {
+        static thread_local LocalCache s_local;
+        return s_local;
+    }
+
+    void foldHits(LocalCache& local)
+    {
+        if (local.hits) {
+            m_hits.fetch_add(local.hits, std::memory_order_relaxed);
+            local.hits = 0;
+        }
+    }
+
+    void deleteObjects(T **items, int n)
+    {
+        for (int i = 0; i < n; ++i)
+            delete items[i];
+        if (n > 0) {
+            m_trimmed.fetch_add(n, std::memory_order_relaxed);
+            m_allocated.fetch_sub(n, std::memory_order_relaxed);
+        }
+    }
+
+    // move the top n objects of the cache to the shared stack
+    void flush(LocalCache& local, int n)
+    {
+        foldHits(local);
+        local.count -= n;
+        T **items = local.items + local.count;
+        if (m_retained.load(std::memory_order_relaxed) + n > m_max_retained.load(std::memory_order_relaxed)) {
+            deleteObjects(items, n);
+            return;
+        }
+
+        Batch *batch = local.spare ? local.spare : new Batch();
+        local.spare = nullptr;
+        batch->count = n;
+        std::copy(items, items + n, batch->items);
+        m_retained.fetch_add(n, std::memory_order_relaxed);
+
+        batch->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(batch->next, batch, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    void refill(LocalCache& local)
+    {
+        foldHits(local);
+        if (!m_head.load(std::memory_order_relaxed))
+            return;
+
+        while (m_pop_flag.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+        // nodes can't leave the stack while we hold the flag, so head->next is stable
+        Batch *batch = m_head.load(std::memory_order_acquire);
+        while (batch && !m_head.compare_exchange_weak(batch, batch->next, std::memory_order_acquire, std::memory_order_acquire)) {}
+        m_pop_flag.clear(std::memory_order_release);
+        if (!batch)
+            return;
+
+        m_retained.fetch_sub(batch->count, std::memory_order_relaxed);
+        std::copy(batch->items, batch->items + batch->count, local.items);
+        local.count = batch->count;
+        delete local.spare;
+        local.spare = batch;
+    }
+
+    void trimLocal(LocalCache& local)
+    {
+        foldHits(local);
+        deleteObjects(local.items, local.count);
+        local.count = 0;
+        delete local.spare;
+        local.spare = nullptr;
+        local.trim_generation = m_trim_generation.load(std::memory_order_relaxed);
+        local.publish();
+    }
+
+    // called on thread exit. everything in the cache goes back to the shared stack unless a trim is pending
+    void drain(LocalCache& local)
+    {
+        if (local.trim_generation != m_trim_generation.load(std::memory_order_relaxed)) {
+            trimLocal(local);
+            return;
+        }
+        while (local.count > 0)
+            flush(local, std::min(local.count, (int)BatchSize));
+        foldHits(local);
+        delete local.spare;
+        local.spare = nullptr;
+    }
+
+    void trimShared()
+    {
+        while (m_pop_flag.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+        Batch *batch = m_head.exchange(nullptr, std::memory_order_acquire);
+        m_pop_flag.clear(std::memory_order_release);
+
+        while (batch) {
+            Batch *next = batch->next;
+            m_retained.fetch_sub(batch->count, std::memory_order_relaxed);
+            deleteObjects(batch->items, batch->count);
+            delete batch;
+            batch = next;
+        }
+    }
+
+    std::atomic<Batch*> m_head{ nullptr };
+    std::atomic_flag m_pop_flag = ATOMIC_FLAG_INIT;
+};
+
+} // namespace ms
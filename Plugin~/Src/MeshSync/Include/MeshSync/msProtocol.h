@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include "MeshUtils/muMisc.h" //mu::nanosec
 
@@ -22,6 +24,45 @@ namespace ms {
     const std::string REQUEST_SYNC = "sync";
     const std::string SERVER_SESSION_ID = "server_session_id";
 	const std::string REQUEST_USER_SCRIPT_CALLBACK = "user_script_callback";
+    const std::string CONTENT_ENCODING_ZSTD = "zstd";
+
+    // same-host transport. the server lists it in TRANSPORTS of its responses,
+    // then a local client can pass a SetMessage in a named shared memory segment instead of the request body.
+    const std::string TRANSPORTS = "transports";
+    const std::string TRANSPORT_SHARED_MEMORY = "shm";
+    const std::string SHARED_MEMORY_NAME = "shm_name";
+    const std::string SHARED_MEMORY_SIZE = "shm_size";
+    // set in the response when the server can't reach the client's segment (e.g. through a forwarded port).
+    // the client sends the message over HTTP instead and doesn't try shared memory again.
+    const std::string SHARED_MEMORY_UNAVAILABLE = "shm_unavailable";
+
+    // chunked transfer. a large SetMessage is serialized and sent as consecutive byte ranges of one transfer,
+    // the server assembles them and imports the message once it is complete.
+    const std::string TRANSPORT_CHUNKS = "chunks";
+    const std::string TRANSFER_ID = "transfer_id";
+    const std::string TRANSFER_SIZE = "transfer_size";
+    const std::string CHUNK_OFFSET = "chunk_offset";
+    const std::string CHUNK_RECEIVED = "chunk_received";
+
+// completion flag of a request.
+// the main thread sets it when the request has been handled, and server threads that wait for it are woken up immediately.
+class ReadySignal
+{
+public:
+    ReadySignal& operator=(bool v);
+    operator bool() const;
+
+    // wake up waiting threads without changing the flag (e.g. on cancellation)
+    void notify();
+
+    // return true if the flag has been set, false on timeout or when *cancelled became true
+    bool wait_for(int timeout_ms, const std::atomic_bool* cancelled = nullptr);
+
+private:
+    std::atomic_bool m_ready{ false };
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
 
 class Message
 {
@@ -49,6 +90,7 @@ public:
     mu::nanosec timestamp_recv = 0;
 
     virtual ~Message();
+    virtual Type getType() const;
     virtual void serialize(std::ostream& os) const;
     virtual void deserialize(std::istream& is); // throw
 };
@@ -63,10 +105,11 @@ public:
     MeshRefineSettings refine_settings;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
 
 public:
     GetMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -82,6 +125,7 @@ public:
 public:
     SetMessage();
     explicit SetMessage(ScenePtr scene);
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -97,6 +141,7 @@ public:
     std::vector<Identifier> instances;
 
     DeleteMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -119,6 +164,7 @@ public:
     std::string dcc_tool_name = "";
 
     ~FenceMessage() override;
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -137,6 +183,7 @@ public:
     };
 
     ~TextMessage() override;
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 
@@ -153,10 +200,11 @@ using super = Message;
 public:
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
 
 public:
     ScreenshotMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -170,6 +218,7 @@ public:
     std::vector<std::string> text;
 
     ResponseMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -194,10 +243,11 @@ public:
     QueryType query_type = QueryType::Unknown;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
     ResponseMessagePtr response;
 
     QueryMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -216,7 +266,7 @@ public:
     PollType poll_type = PollType::Unknown;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
 
     PollMessage();
     void serialize(std::ostream& os) const override;
@@ -236,11 +286,12 @@ public:
     SceneSettings scene_settings;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
     std::atomic_bool cancelled { false };
 
 public:
     ServerLiveEditRequest();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 };
@@ -274,10 +325,11 @@ public:
     };
     CommandType command_type = CommandType::Unknown;
 
-    std::atomic_bool ready{ false };
+    ReadySignal ready;
 
 
     EditorCommandMessage();
+    Message::Type getType() const override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
 
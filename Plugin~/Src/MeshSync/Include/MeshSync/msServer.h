@@ -4,13 +4,21 @@
 #include <map>
 #include <mutex>
 #include <future>
+#include <condition_variable>
+
+#include "MeshUtils/muConcurrency.h"
 
 #include "MeshSync/msProtocol.h"
+#include "MeshSync/msWorkerPool.h"
+#include "MeshSync/msChunkedTransfer.h"
+#include "MeshSync/msStats.h"
 #include "MeshSync/SceneGraph/msSceneImportSettings.h"
 
 namespace Poco {
     namespace Net {
         class HTTPServer;
+        class TCPServer;
+        class StreamSocket;
         class HTTPServerRequest;
         class HTTPServerResponse;
     }
@@ -21,11 +29,14 @@ msDeclClassPtr(Message)
 msDeclClassPtr(PollMessage)
 msDeclClassPtr(SetMessage)
 msDeclClassPtr(GetMessage)
+msDeclClassPtr(QueryMessage)
 msDeclClassPtr(ScreenshotMessage)
 msDeclClassPtr(ServerLiveEditRequest)
 msDeclClassPtr(PropertyInfo)
 msDeclClassPtr(Curve)
 msDeclClassPtr(EditorCommandMessage)
+msDeclClassPtr(BufferEncoder)
+msDeclClassPtr(Channel)
 
 namespace ms {
 
@@ -33,17 +44,20 @@ struct ServerSettings
 {
     int max_queue = 256;
     int max_threads = 8;
-    uint16_t port = 8080;
+    uint16_t port = 8080; // 0 binds any free port. start() stores the bound one here
 
     SceneImportSettings import_settings;
 };
 
 class Server {
 public:
+    static const uint64_t DefaultMaxMessageSize = 0x40000000; // 1 GiB
+
     Server(const ServerSettings& settings);
     ~Server();
 
     bool start();
+    // stops accepting requests and waits for the ones in flight. requests waiting for the main thread are woken up.
     void stop();
     void abort();
     void clear();
@@ -73,10 +87,38 @@ public:
 
     void notifyCommand(const char* reply, int messageId, int sessionId);
 
+    // received scenes are imported on a dedicated worker pool.
+    // the worker count takes effect on the next start(). 0 means the number of hardware threads.
+    void setImportWorkerCount(int v);
+    int getImportWorkerCount() const;
+    // when this many imports are pending, recvSet() blocks until one is picked up
+    void setMaxPendingImports(int v);
+    int getMaxPendingImports() const;
+    WorkerPoolStats getImportStats() const;
+    // SetMessages larger than this are rejected before anything is allocated for them (413 over HTTP)
+    void setMaxMessageSize(uint64_t v);
+    uint64_t getMaxMessageSize() const;
+
+    // counters are always on. also served as JSON by the "/stats" route.
+    ServerStats getStats() const;
+    void resetStats();
+    void countRequest(int status, uint64_t bytes_received, uint64_t bytes_sent, mu::nanosec elapsed);
+
+    // HTTP request handlers run between these. beginRequest() returns false once stop() has begun.
+    bool beginRequest();
+    void endRequest();
+
+    // port of the persistent binary channel (see ms::ChannelClient). 0 disables it, AnyChannelPort binds any free port.
+    // while the channel is listening, getChannelPort() returns the bound port.
+    static const uint16_t AnyChannelPort = 0xFFFF;
+    void setChannelPort(uint16_t v);
+    uint16_t getChannelPort() const;
+
 public:
     struct MessageHolder
     {
         MessagePtr message;
+        Message::Type type = Message::Type::Unknown;
         std::future<void> task;
         std::atomic_bool ready = { false };
 
@@ -87,6 +129,7 @@ public:
     Scene* getHostScene();
     void queueTextMessage(const char *mes, TextMessage::Type type);
     void recvSet(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
+    void recvSetChunk(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvDelete(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvFence(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvGet(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
@@ -96,6 +139,10 @@ public:
     void recvPoll(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvServerLiveEditRequest(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvCommand(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
+    void recvStats(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
+    void serveChannel(const Poco::Net::StreamSocket& socket);
+    // decode a SetMessage body received by any transport. encoding is "" or CONTENT_ENCODING_ZSTD.
+    SetMessagePtr decodeSetMessage(RawVector<char>&& body, const std::string& encoding); // throw
     
     void receivedProperty(PropertyInfoPtr prop);
     void syncRequested();
@@ -108,9 +155,21 @@ public:
 private:
     template<class MessageT>
     std::shared_ptr<MessageT> deserializeMessage(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
-
-    MessageHolder* queueMessage(MessagePtr mes);
-    MessageHolder* queueMessage(MessagePtr mes, std::future<void>&& task);
+    SetMessagePtr deserializeSetMessage(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
+    bool readSharedMemory(Poco::Net::HTTPServerRequest& request, RawVector<char>& dst); // throw
+    void importSetMessage(SetMessagePtr mes);
+    void answerQuery(QueryMessagePtr mes);
+    bool waitReady(ReadySignal& ready, int timeout_ms);
+    void stopRequests();
+    bool runCommand(EditorCommandMessagePtr mes); // throw
+    ServerLiveEditResponse buildLiveEditResponse(const ServerLiveEditRequest& request); // takes the pending edits
+    void pushLiveEdits(ChannelPtr channel, uint32_t stream_id, ServerLiveEditRequestPtr mes);
+    void startChannel();
+    void closeChannels(bool wait);
+
+    void queueMessage(MessagePtr mes);
+    void queueMessage(MessagePtr mes, std::future<void>&& task);
+    bool dispatchMessage(MessageHolder& holder, const MessageHandler& handler);
 
     bool loadMIMETypes(const std::string& path);
     const std::string& getMIMEType(const std::string& filename);
@@ -118,6 +177,7 @@ private:
 
 private:
     using HTTPServerPtr = std::shared_ptr<Poco::Net::HTTPServer>;
+    using TCPServerPtr = std::shared_ptr<Poco::Net::TCPServer>;
     using lock_t = std::unique_lock<std::mutex>;
     using PollMessages = std::vector<PollMessagePtr>;
 
@@ -130,7 +190,8 @@ private:
     std::mutex m_poll_mutex;
 
     int m_current_scene_session = InvalidID;
-    std::list<MessageHolder> m_received_messages, m_processing_messages;
+    mu::mpsc_queue<MessageHolder> m_received_messages; // pushed by server threads, drained by processMessages()
+    std::list<MessageHolder> m_processing_messages;
     std::vector<SetMessagePtr> m_scene_cache;
     PollMessages m_polls;
 
@@ -148,16 +209,49 @@ private:
     std::mutex m_commands_mutex;
 
     int m_server_session_id;
+    BufferEncoderPtr m_zstd_decoder;
+
+    std::unique_ptr<WorkerPool> m_import_workers;
+    int m_import_worker_count = 0;
+    int m_max_pending_imports = 32;
+    std::atomic<uint64_t> m_max_message_size{ DefaultMaxMessageSize };
+
+    ServerCounters m_counters;
+
+    uint16_t m_channel_port = 0;
+    uint16_t m_channel_bound_port = 0;
+    TCPServerPtr m_channel_server;
+    std::vector<ChannelPtr> m_channels;
+    std::mutex m_channels_mutex;
+    std::condition_variable m_channels_cond;
+    bool m_channels_closing = false;
+
+    ChunkAssembler m_chunks; // chunked SetMessages being assembled
+
+    std::mutex m_requests_mutex;
+    std::condition_variable m_requests_cond;
+    int m_num_active_requests = 0;
+    std::vector<ReadySignal*> m_waiting_requests;
+    std::atomic_bool m_stopping{ false };
 
     public:
+    // live edits waiting to be sent back to the DCC. the channel's push threads take them too,
+    // so they are only touched with m_pending_mutex locked.
+    mutable std::mutex m_pending_mutex;
     std::vector<EntityPtr> m_pending_entities;
     std::map<uint64_t, PropertyInfoPtr> m_pending_properties;
 
-    template<typename T>
-    T* getOrCreatePendingEntity(const char* path) {
+    void addPendingEntity(EntityPtr entity);
+
+    // body is called with the pending entity at path, created if there isn't one yet
+    template<typename T, typename Body>
+    void editPendingEntity(const char* path, const Body& body) {
+        lock_t lock(m_pending_mutex);
         for (size_t i = 0; i < m_pending_entities.size(); i++) {
             if (m_pending_entities[i]->path == path) {
-                return dynamic_cast<T*>(m_pending_entities[i].get());
+                if (auto *e = dynamic_cast<T*>(m_pending_entities[i].get()))
+                    body(*e);
+                return;
             }
         }
 
@@ -165,8 +259,7 @@ private:
         shared_ptr<T> result = T::create();
         result->path = path;
         m_pending_entities.push_back(result);
-
-        return result.get();
+        body(*result);
     }
 };
 
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "MeshUtils/muMisc.h" //nanosec
+
+#include "MeshSync/msProtocol.h" //Message::Type
+#include "MeshSync/msWorkerPool.h" //WorkerPoolStats
+
+namespace ms {
+
+static const int NumMessageTypes = (int)Message::Type::EditorCommand + 1;
+
+// summary of a LatencyHistogram. percentiles are the upper bound of the bucket they fall in.
+struct LatencyStats
+{
+    uint64_t count = 0;
+    float average_ms = 0.0f;
+    float p50_ms = 0.0f;
+    float p90_ms = 0.0f;
+    float p99_ms = 0.0f;
+    float max_ms = 0.0f;
+};
+
+// lock-free histogram with power of two buckets. bucket n counts samples shorter than 2^n microseconds.
+// cheap enough to be always on.
+class LatencyHistogram
+{
+public:
+    static const int NumBuckets = 32;
+
+    LatencyHistogram();
+    void add(mu::nanosec v);
+    void reset();
+    LatencyStats getStats() const;
+
+private:
+    std::atomic<uint64_t> m_buckets[NumBuckets];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_total;
+    std::atomic<uint64_t> m_max;
+};
+
+
+// what MeshSync holds right now, by category. heap categories are array data (AlignedMalloc), tagged by
+// what was running when the block was allocated. pooled objects are counted by their own size only.
+struct MemoryStats
+{
+    uint64_t total_bytes = 0; // heap_bytes + pool_bytes
+    uint64_t heap_bytes = 0;
+    uint64_t heap_peak_bytes = 0;
+    uint64_t heap_blocks = 0;
+    uint64_t general_bytes = 0;     // untagged. mostly vertex arrays of scenes built in process
+    uint64_t stream_bytes = 0;      // MemoryStream buffers
+    uint64_t scene_cache_bytes = 0; // samples read and decoded by scene cache inputs
+    uint64_t server_bytes = 0;      // received messages not yet released
+    uint64_t pool_bytes = 0;        // objects owned by pools, in use or cached
+    uint64_t pool_retained_bytes = 0; // part of pool_bytes free in the shared stacks and thread caches
+};
+MemoryStats GetMemoryStats();
+
+
+struct ServerStats
+{
+    uint64_t num_requests = 0; // HTTP requests and channel frames
+    uint64_t num_failed_requests = 0; // answered with an error
+    uint64_t bytes_received = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t num_messages[NumMessageTypes] = {}; // queued for the main thread. indexed by Message::Type
+    uint64_t num_entities_received = 0;
+    int num_queued_messages = 0; // waiting for processMessages()
+    int num_queued_entities = 0; // in SetMessages that are not dispatched yet
+    int num_pending_entities = 0; // live edits waiting to be sent back to the DCC
+
+    LatencyStats request_latency;
+    LatencyStats decode_latency; // decompression and deserialization
+    LatencyStats import_latency; // Scene::import() on a worker. includes mesh refinement
+    LatencyStats dispatch_latency; // message handlers called by processMessages()
+    WorkerPoolStats import_workers;
+    MemoryStats memory; // process wide
+};
+
+// updated by server threads without locking
+class ServerCounters
+{
+public:
+    ServerCounters();
+    void reset();
+    void getStats(ServerStats& dst) const;
+
+    std::atomic<uint64_t> num_requests;
+    std::atomic<uint64_t> num_failed_requests;
+    std::atomic<uint64_t> bytes_received;
+    std::atomic<uint64_t> bytes_sent;
+    std::atomic<uint64_t> num_messages[NumMessageTypes];
+    std::atomic<uint64_t> num_entities_received;
+    std::atomic<int> num_queued_entities;
+
+    LatencyHistogram request_latency;
+    LatencyHistogram decode_latency;
+    LatencyHistogram import_latency;
+    LatencyHistogram dispatch_latency;
+};
+
+
+struct ClientStats
+{
+    uint64_t num_messages = 0;
+    uint64_t num_failed = 0;
+    uint64_t bytes_sent = 0; // serialized size. before compression
+    uint64_t num_shared_memory = 0; // SetMessages passed through shared memory
+    uint64_t num_channel = 0; // messages passed through the persistent channel
+    LatencyStats set_latency; // SetMessage round trips
+    LatencyStats other_latency; // round trips of the rest
+};
+
+// shared by Clients that report to the same owner (e.g. AsyncSceneSender recreates its Client when the settings change)
+class ClientCounters
+{
+public:
+    ClientCounters();
+    void reset();
+    void add(Message::Type type, uint64_t size, bool succeeded, mu::nanosec elapsed);
+    void countSharedMemory();
+    void countChannel();
+    ClientStats getStats() const;
+
+private:
+    std::atomic<uint64_t> m_num_messages;
+    std::atomic<uint64_t> m_num_failed;
+    std::atomic<uint64_t> m_bytes_sent;
+    std::atomic<uint64_t> m_num_shared_memory;
+    std::atomic<uint64_t> m_num_channel;
+    LatencyHistogram m_set_latency;
+    LatencyHistogram m_other_latency;
+};
+using ClientCountersPtr = std::shared_ptr<ClientCounters>;
+
+
+struct SenderStats
+{
+    uint64_t num_sends = 0;
+    uint64_t num_failed_sends = 0;
+    uint64_t num_entities_sent = 0;
+    uint64_t num_entities_skipped = 0; // unchanged since the last send
+    uint64_t num_geometries_unchanged = 0; // sent as transform only
+    LatencyStats send_latency; // a whole send, from SceneBegin to SceneEnd
+    ClientStats client;
+};
+
+std::string ToJSON(const LatencyStats& v);
+std::string ToJSON(const WorkerPoolStats& v);
+std::string ToJSON(const MemoryStats& v);
+std::string ToJSON(const ServerStats& v);
+
+} // namespace ms
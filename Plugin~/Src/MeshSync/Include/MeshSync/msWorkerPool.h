@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+#include "MeshUtils/muMisc.h" //nanosec
+
+namespace ms {
+
+struct WorkerPoolStats
+{
+    int num_workers = 0;
+    int num_queued = 0;     // tasks waiting for a worker
+    int num_running = 0;
+    int peak_queued = 0;
+    uint64_t num_completed = 0;
+    uint64_t num_blocked = 0; // submit() calls that had to wait for a free slot
+    float average_wait_ms = 0.0f; // time from submit() to start
+    float max_wait_ms = 0.0f;
+    float average_run_ms = 0.0f;
+    float max_run_ms = 0.0f;
+};
+
+// fixed set of persistent worker threads fed by a bounded FIFO.
+// submit() blocks while the queue is full, which throttles the producer.
+// queued tasks are still executed on destruction so that no returned future is left broken.
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(int num_workers, int max_queued);
+    ~WorkerPool();
+
+    std::future<void> submit(Task&& task);
+    void waitIdle();
+
+    int getNumWorkers() const;
+    int getMaxQueued() const;
+    void setMaxQueued(int v);
+    WorkerPoolStats getStats() const;
+    void resetStats();
+
+private:
+    struct Job
+    {
+        std::packaged_task<void()> task;
+        mu::nanosec submitted = 0;
+    };
+
+    void workerMain();
+
+    std::vector<std::thread> m_workers;
+    std::deque<Job> m_jobs;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond_jobs;  // signaled when a job is queued or stopping
+    std::condition_variable m_cond_space; // signaled when a job leaves the queue
+    std::condition_variable m_cond_idle;
+    int m_max_queued = 0;
+    int m_num_running = 0;
+    bool m_stopping = false;
+
+    int m_peak_queued = 0;
+    uint64_t m_num_completed = 0;
+    uint64_t m_num_blocked = 0;
+    mu::nanosec m_total_wait = 0, m_max_wait = 0;
+    mu::nanosec m_total_run = 0, m_max_run = 0;
+};
+
+} // namespace ms
@@ -12,15 +12,18 @@ namespace ms {
 class PlainBufferEncoder : public BufferEncoder {
 public:
     void EncodeV(RawVector<char>& dst, const RawVector<char>& src) override;
-    void DecodeV(RawVector<char>& dst, const RawVector<char>& src) override;
+    void DecodeV(RawVector<char>& dst, const RawVector<char>& src, size_t max_size) override;
 };
 
 void PlainBufferEncoder::EncodeV(RawVector<char>& dst, const RawVector<char>& src) {
     dst = src;
 }
 
-void PlainBufferEncoder::DecodeV(RawVector<char>& dst, const RawVector<char>& src) {
-    dst = src;
+void PlainBufferEncoder::DecodeV(RawVector<char>& dst, const RawVector<char>& src, const size_t max_size) {
+    if (src.size() > max_size)
+        dst.clear();
+    else
+        dst = src;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -30,7 +33,7 @@ class ZSTDBufferEncoder : public BufferEncoder
 public:
     explicit ZSTDBufferEncoder(int cl);
     void EncodeV(RawVector<char>& dst, const RawVector<char>& src) override;
-    void DecodeV(RawVector<char>& dst, const RawVector<char>& src) override;
+    void DecodeV(RawVector<char>& dst, const RawVector<char>& src, size_t max_size) override;
 
 private:
     int m_compression_level;
@@ -49,11 +52,17 @@ void ZSTDBufferEncoder::EncodeV(RawVector<char>& dst, const RawVector<char>& src
     dst.resize(csize);
 }
 
-void ZSTDBufferEncoder::DecodeV(RawVector<char>& dst, const RawVector<char>& src) {
-    size_t dsize = static_cast<size_t>(ZSTD_findDecompressedSize(src.data(), src.size()));
+void ZSTDBufferEncoder::DecodeV(RawVector<char>& dst, const RawVector<char>& src, const size_t max_size) {
+    const unsigned long long content_size = ZSTD_findDecompressedSize(src.data(), src.size());
+    if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size > max_size) {
+        // not a valid zstd frame, or the header claims more than the caller accepts. checked before allocating.
+        dst.clear();
+        return;
+    }
+    size_t dsize = static_cast<size_t>(content_size);
     dst.resize_discard(dsize);
     dsize = ZSTD_decompress(dst.data(), dst.size(), src.data(), src.size());
-    dst.resize(dsize);
+    dst.resize(ZSTD_isError(dsize) ? 0 : dsize);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
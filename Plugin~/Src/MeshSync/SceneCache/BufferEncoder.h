@@ -13,7 +13,8 @@ class BufferEncoder {
 public:
     virtual ~BufferEncoder() = default;
     virtual void EncodeV(RawVector<char>& dst, const RawVector<char>& src) = 0;
-    virtual void DecodeV(RawVector<char>& dst, const RawVector<char>& src) = 0;
+    // dst is left empty if src is not valid or would decode to more than max_size bytes
+    virtual void DecodeV(RawVector<char>& dst, const RawVector<char>& src, size_t max_size = SIZE_MAX) = 0;
 
     static BufferEncoderPtr CreateEncoder(ms::SceneCacheEncoding encoding, const ms::SceneCacheEncoderSettings& settings);
 
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "SceneCache/CacheFileSections.h"
+
+#include "MeshUtils/muLog.h" //muLogError
+
+namespace ms {
+
+template<class Header>
+static void WriteSection(std::ostream& os, BufferEncoder& encoder, mu::MemoryStream& body)
+{
+    body.flush();
+
+    RawVector<char> encoded_buf;
+    encoder.EncodeV(encoded_buf, body.getBuffer());
+
+    Header header;
+    header.size = encoded_buf.size();
+    os.write(reinterpret_cast<char*>(&header), sizeof(header));
+    os.write(encoded_buf.data(), encoded_buf.size());
+}
+
+template<class Header>
+static bool ReadSection(std::istream& is, BufferEncoder& encoder, RawVector<char>& dst)
+{
+    const std::istream::pos_type pos = is.tellg();
+    Header header;
+    const Header expected;
+    std::memset(header.magic, 0, sizeof(header.magic));
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!is || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        is.clear();
+        is.seekg(pos);
+        return false;
+    }
+
+    RawVector<char> encoded_buf;
+    encoded_buf.resize(static_cast<size_t>(header.size));
+    is.read(encoded_buf.data(), encoded_buf.size());
+    if (!is)
+        return false;
+    encoder.DecodeV(dst, encoded_buf);
+    return true;
+}
+
+void WriteMetaSection(std::ostream& os, BufferEncoder& encoder, const RawVector<CacheFileEntityMeta>& meta)
+{
+    mu::MemoryStream body;
+    body.write(reinterpret_cast<const char*>(meta.cdata()), meta.size_in_byte());
+    WriteSection<CacheFileMetaHeader>(os, encoder, body);
+}
+
+void WriteIndexSection(std::ostream& os, BufferEncoder& encoder, const CacheFileIndex& index)
+{
+    mu::MemoryStream body;
+    write(body, static_cast<uint32_t>(index.entityPaths.size()));
+    for (const auto& kvp : index.entityPaths) {
+        write(body, kvp.first);
+        write(body, kvp.second);
+    }
+    write(body, index.segmentEntities);
+    WriteSection<CacheFileIndexHeader>(os, encoder, body);
+}
+
+void WriteBoundsSection(std::ostream& os, BufferEncoder& encoder, const RawVector<CacheFileEntityBounds>& bounds)
+{
+    mu::MemoryStream body;
+    body.write(reinterpret_cast<const char*>(bounds.cdata()), bounds.size_in_byte());
+    WriteSection<CacheFileBoundsHeader>(os, encoder, body);
+}
+
+bool ReadMetaSection(std::istream& is, BufferEncoder& encoder, RawVector<CacheFileEntityMeta>& dst)
+{
+    // the meta header has no magic. it is always there.
+    CacheFileMetaHeader header;
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!is)
+        return false;
+
+    RawVector<char> encoded_buf, tmp_buf;
+    encoded_buf.resize(static_cast<size_t>(header.size));
+    is.read(encoded_buf.data(), encoded_buf.size());
+    encoder.DecodeV(tmp_buf, encoded_buf);
+
+    dst.resize_discard(tmp_buf.size() / sizeof(CacheFileEntityMeta));
+    tmp_buf.copy_to(reinterpret_cast<char*>(dst.data()));
+    return true;
+}
+
+bool ReadIndexSection(std::istream& is, BufferEncoder& encoder, CacheFileIndex& dst)
+{
+    RawVector<char> tmp_buf;
+    if (!ReadSection<CacheFileIndexHeader>(is, encoder, tmp_buf))
+        return false;
+
+    mu::MemoryStream body(std::move(tmp_buf));
+    try {
+        uint32_t entity_count = 0;
+        read(body, entity_count);
+        for (uint32_t i = 0; i < entity_count; ++i) {
+            int id;
+            std::string path;
+            read(body, id);
+            read(body, path);
+            dst.entityPaths[id] = std::move(path);
+        }
+        read(body, dst.segmentEntities);
+    }
+    catch (std::runtime_error& e) {
+        muLogError("exception: %s\n", e.what());
+        dst = {};
+        return false;
+    }
+    return true;
+}
+
+bool ReadBoundsSection(std::istream& is, BufferEncoder& encoder, RawVector<CacheFileEntityBounds>& dst)
+{
+    RawVector<char> tmp_buf;
+    if (!ReadSection<CacheFileBoundsHeader>(is, encoder, tmp_buf))
+        return false;
+
+    dst.resize_discard(tmp_buf.size() / sizeof(CacheFileEntityBounds));
+    tmp_buf.copy_to(reinterpret_cast<char*>(dst.data()));
+    return true;
+}
+
+} // namespace ms
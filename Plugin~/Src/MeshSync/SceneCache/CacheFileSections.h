@@ -0,0 +1,27 @@
+#pragma once
+
+#include "MeshSync/SceneCache/msCacheFileHeader.h"
+
+#include "SceneCache/BufferEncoder.h"
+
+namespace ms {
+
+// encoded sections that follow the scenes of a cache file.
+// shared by the writer, the reader and the shard merger so that they can't disagree on the layout.
+
+struct CacheFileIndex
+{
+    std::map<int, std::string> entityPaths;
+    std::vector<std::vector<std::vector<int>>> segmentEntities; // [scene][segment] -> ids. in file order
+};
+
+void WriteMetaSection(std::ostream& os, BufferEncoder& encoder, const RawVector<CacheFileEntityMeta>& meta);
+void WriteIndexSection(std::ostream& os, BufferEncoder& encoder, const CacheFileIndex& index);
+void WriteBoundsSection(std::ostream& os, BufferEncoder& encoder, const RawVector<CacheFileEntityBounds>& bounds);
+
+// the index and the bounds are optional. when absent, the stream is left where it was and false is returned.
+bool ReadMetaSection(std::istream& is, BufferEncoder& encoder, RawVector<CacheFileEntityMeta>& dst);
+bool ReadIndexSection(std::istream& is, BufferEncoder& encoder, CacheFileIndex& dst);
+bool ReadBoundsSection(std::istream& is, BufferEncoder& encoder, RawVector<CacheFileEntityBounds>& dst);
+
+} // namespace ms
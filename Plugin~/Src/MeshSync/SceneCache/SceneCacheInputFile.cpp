@@ -5,6 +5,8 @@
 #include "Utils/msDebug.h" //msProfileScope
 
 #include "SceneCache/BufferEncoder.h"
+#include "SceneCache/CacheFileSections.h"
+#include "SceneCache/SceneCacheOutputFile.h"
 
 namespace ms {
 
@@ -16,6 +18,41 @@ bool SceneCacheInputFile::IsValid() const {
     return !m_records.empty();
 }
 
+bool SceneCacheInputFile::HasEntityIndex() const {
+    return m_hasEntityIndex;
+}
+
+const CacheFileHeader& SceneCacheInputFile::GetHeader() const {
+    return m_header;
+}
+
+const RawVector<CacheFileEntityMeta>& SceneCacheInputFile::GetEntityMeta() const {
+    return m_entityMeta;
+}
+
+const std::map<std::string, int>& SceneCacheInputFile::GetEntityIDs() const {
+    return m_entityIDs;
+}
+
+size_t SceneCacheInputFile::GetSegmentCount(const int frame) const {
+    if (frame < 0 || frame >= static_cast<int>(m_records.size()))
+        return 0;
+    return m_records[frame].bufferSizes.size();
+}
+
+uint64_t SceneCacheInputFile::GetSegmentSize(const int frame, const int segment) const {
+    if (segment < 0 || segment >= static_cast<int>(GetSegmentCount(frame)))
+        return 0;
+    return m_records[frame].bufferSizes[segment];
+}
+
+bool SceneCacheInputFile::IsLoaded(const int frame) const {
+    if (frame < 0 || frame >= static_cast<int>(m_records.size()))
+        return false;
+    std::unique_lock<std::mutex> lock(m_historyMutex);
+    return m_records[frame].scene != nullptr;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 SceneCacheInputFilePtr SceneCacheInputFile::Open(const char *path, const SceneCacheInputSettings& iscs) {
@@ -23,8 +60,18 @@ SceneCacheInputFilePtr SceneCacheInputFile::Open(const char *path, const SceneCa
 }
 
 SceneCacheInputFile* SceneCacheInputFile::OpenRaw(const char *path, const SceneCacheInputSettings& iscs) {
+    if (!path)
+        return nullptr;
+    return OpenShardsRaw({ path }, iscs);
+}
+
+SceneCacheInputFilePtr SceneCacheInputFile::OpenShards(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs) {
+    return SceneCacheInputFilePtr(OpenShardsRaw(paths, iscs));
+}
+
+SceneCacheInputFile* SceneCacheInputFile::OpenShardsRaw(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs) {
     SceneCacheInputFile* ret = new SceneCacheInputFile();
-    ret->Init(path, iscs);
+    ret->Init(paths, iscs);
     if (ret->IsValid()) {
         return ret;
     } else {
@@ -89,83 +136,386 @@ int SceneCacheInputFile::GetFrameByTimeV(const float time) const
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void SceneCacheInputFile::Init(const char *path, const SceneCacheInputSettings& iscs)
+struct SceneCacheInputFile::Shard
+{
+    CacheFileHeader header;
+    std::vector<SceneRecord> records;
+    RawVector<CacheFileEntityMeta> entityMeta;
+    CacheFileIndex index;
+    bool hasIndex = false;
+    RawVector<CacheFileEntityBounds> entityBounds;
+    bool hasBounds = false;
+};
+
+void SceneCacheInputFile::Init(const std::vector<std::string>& paths, const SceneCacheInputSettings& iscs)
 {
-    m_stream = CreateStream(path, iscs);
     SetSettings(iscs);
-    if (!m_stream || !(*m_stream))
-        return;
 
-    m_header.version = 0;
-    m_stream->read(reinterpret_cast<char*>(&m_header), sizeof(m_header));
-    if (m_header.version != msProtocolVersion)
+    std::vector<Shard> shards(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const StreamPtr stream = CreateStream(paths[i].c_str(), iscs);
+        if (!stream || !ReadShard(stream, shards[i]))
+            return;
+    }
+    if (shards.empty())
         return;
 
+    // shards have to be alike and cover disjoint time ranges
+    std::sort(shards.begin(), shards.end(), [](auto& a, auto& b) { return a.records.front().time < b.records.front().time; });
+    m_header = shards.front().header;
+    for (size_t i = 1; i < shards.size(); ++i) {
+        const SceneCacheExportSettings& a = m_header.exportSettings;
+        const SceneCacheExportSettings& b = shards[i].header.exportSettings;
+        if (a.encoding != b.encoding || a.sampleRate != b.sampleRate) {
+            muLogError("SceneCacheInputFile: shards must share encoding and sample rate\n");
+            return;
+        }
+        if (shards[i - 1].records.back().time >= shards[i].records.front().time) {
+            muLogError("SceneCacheInputFile: time ranges of shards overlap\n");
+            return;
+        }
+    }
     m_encoder = BufferEncoder::CreateEncoder(m_header.exportSettings.encoding, m_header.exportSettings.encoderSettings);
-    if (!m_encoder) {
+
+    m_hasEntityIndex = std::all_of(shards.begin(), shards.end(), [](auto& s) { return s.hasIndex; });
+    m_hasBounds = std::all_of(shards.begin(), shards.end(), [](auto& s) { return s.hasBounds; });
+
+    // concat shards
+    std::map<int, CacheFileEntityMeta> entity_meta;
+    for (Shard& shard : shards) {
+        const int frame_offset = static_cast<int>(m_records.size());
+        const bool stripped = shard.header.exportSettings.stripUnchanged != 0;
+        m_header.exportSettings.stripUnchanged |= shard.header.exportSettings.stripUnchanged;
+        for (SceneRecord& rec : shard.records) {
+            if (!m_hasEntityIndex)
+                rec.segmentEntities.clear();
+            rec.base = stripped ? frame_offset : -1;
+            m_records.emplace_back(std::move(rec));
+        }
+        if (m_hasEntityIndex) {
+            for (auto& kvp : shard.index.entityPaths) {
+                auto it = m_entityIDs.emplace(kvp.second, kvp.first).first;
+                if (it->second != kvp.first) {
+                    muLogError("SceneCacheInputFile: %s has different ids in shards\n", kvp.second.c_str());
+                    m_records.clear();
+                    return;
+                }
+            }
+        }
+        if (m_hasBounds) {
+            for (CacheFileEntityBounds b : shard.entityBounds) {
+                b.frameBegin += frame_offset;
+                b.frameEnd += frame_offset;
+                m_entityBounds.push_back(b);
+            }
+        }
+        for (const CacheFileEntityMeta& meta : shard.entityMeta) {
+            // constant only if it is constant in all shards
+            auto it = entity_meta.find(meta.id);
+            if (it == entity_meta.end()) {
+                entity_meta[meta.id] = meta;
+            }
+            else {
+                it->second.constant &= meta.constant;
+                it->second.constantTopology &= meta.constantTopology;
+            }
+        }
+    }
+    if (shards.size() == 1) {
+        m_entityMeta = std::move(shards.front().entityMeta);
+    }
+    else {
+        for (auto& kvp : entity_meta)
+            m_entityMeta.push_back(kvp.second);
+    }
+    std::sort(m_entityBounds.begin(), m_entityBounds.end(), [](auto& a, auto& b) {
+        return a.id != b.id ? a.id < b.id : a.frameBegin < b.frameBegin;
+    });
+
+    const size_t scene_count = m_records.size();
+    m_preloadCancelled = std::vector<std::atomic_bool>(scene_count);
+
+    TAnimationCurve<float> curve(GetTimeCurve());
+    curve.resize(scene_count);
+    for (size_t i = 0; i < scene_count; ++i) {
+        TAnimationCurve<float>::key_t& kvp = curve[i];
+        kvp.time = kvp.value = m_records[i].time;
+    }
+
+    // bases stay as they are decoded. they are merged into the other samples of their shard.
+    for (size_t i = 0; i < scene_count; ++i) {
+        if (m_records[i].base == static_cast<int>(i))
+            m_baseScenes[i] = DecodeScene(i, false);
+    }
+    for (auto& kvp : m_baseScenes) {
+        const ScenePtr& base = kvp.second;
+        m_records[kvp.first].scene = base && GetSettings().generateVelocities ? GenerateVelocities(base, kvp.first) : base;
+    }
+
+    //PreloadAll(); // for test
+}
+
+// read the headers and the sections of a file. scenes stay on disk.
+bool SceneCacheInputFile::ReadShard(const StreamPtr& stream, Shard& dst)
+{
+    dst.header.version = 0;
+    stream->read(reinterpret_cast<char*>(&dst.header), sizeof(dst.header));
+    if (dst.header.version != msProtocolVersion)
+        return false;
+
+    const BufferEncoderPtr encoder = BufferEncoder::CreateEncoder(dst.header.exportSettings.encoding, dst.header.exportSettings.encoderSettings);
+    if (!encoder) {
         // encoder associated with m_settings.encoding is not available
-        return;
+        return false;
     }
 
-    m_records.reserve(512);
+    // a file cut short (e.g. the exporter was killed) keeps the scenes that were written completely
+    const std::streamoff records_begin = stream->tellg();
+    stream->seekg(0, std::ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(stream->tellg());
+    stream->seekg(records_begin);
+
+    bool truncated = false;
+    dst.records.reserve(512);
     for (;;) {
         // enumerate all scene headers
         CacheFileSceneHeader sh;
-        m_stream->read(reinterpret_cast<char*>(&sh), sizeof(sh));
+        stream->read(reinterpret_cast<char*>(&sh), sizeof(sh));
+        if (!*stream) {
+            truncated = true;
+            break;
+        }
         if (sh.bufferCount == 0) {
             // empty header is a terminator
             break;
         }
         else {
             SceneRecord rec;
+            rec.stream = stream;
             rec.time = sh.time;
 
+            const uint64_t pos = static_cast<uint64_t>(stream->tellg());
+            if (uint64_t(sh.bufferCount) * sizeof(uint64_t) > file_size - pos) {
+                truncated = true;
+                break;
+            }
             rec.bufferSizes.resize_discard(sh.bufferCount);
-            m_stream->read(reinterpret_cast<char*>(rec.bufferSizes.data()), rec.bufferSizes.size_in_byte());
-            rec.pos = static_cast<uint64_t>(m_stream->tellg());
+            stream->read(reinterpret_cast<char*>(rec.bufferSizes.data()), rec.bufferSizes.size_in_byte());
+            rec.pos = static_cast<uint64_t>(stream->tellg());
 
+            // drop a record whose buffers run past the end of the file
             rec.bufferSizeTotal = 0;
-            for (uint64_t s : rec.bufferSizes)
+            for (uint64_t s : rec.bufferSizes) {
+                if (s > file_size - rec.pos - rec.bufferSizeTotal) {
+                    truncated = true;
+                    break;
+                }
                 rec.bufferSizeTotal += s;
+            }
+            if (truncated)
+                break;
 
-            rec.segments.resize(sh.bufferCount);
-
-            m_records.emplace_back(std::move(rec));
-            m_stream->seekg(rec.bufferSizeTotal, std::ios::cur);
+            dst.records.emplace_back(std::move(rec));
+            stream->seekg(rec.bufferSizeTotal, std::ios::cur);
         }
     }
+    if (dst.records.empty())
+        return false;
+    if (truncated) {
+        // the sections after the terminator are gone too
+        muLogWarning("SceneCacheInputFile: file is truncated. %d scenes are readable\n", (int)dst.records.size());
+        stream->clear();
+    }
+    else {
+        ReadMetaSection(*stream, *encoder, dst.entityMeta);
+
+        // older files end before the index and the bounds. partial loads fall back to loading whole scenes then.
+        dst.hasIndex = ReadIndexSection(*stream, *encoder, dst.index);
+        if (dst.hasIndex) {
+            // records are still in file order here
+            std::vector<std::vector<std::vector<int>>>& segment_entities = dst.index.segmentEntities;
+            const size_t scene_count = dst.records.size();
+            bool valid = segment_entities.size() == scene_count;
+            for (size_t i = 0; valid && i < scene_count; ++i)
+                valid = segment_entities[i].size() == dst.records[i].bufferSizes.size();
+            if (valid) {
+                for (size_t i = 0; i < scene_count; ++i)
+                    dst.records[i].segmentEntities = std::move(segment_entities[i]);
+            }
+            segment_entities.clear();
+            dst.hasIndex = valid;
+        }
+        dst.hasBounds = dst.hasIndex && ReadBoundsSection(*stream, *encoder, dst.entityBounds);
+    }
 
-    const size_t scene_count = m_records.size();
-    std::sort(m_records.begin(), m_records.end(), [](auto& a, auto& b) { return a.time < b.time; });
+    std::sort(dst.records.begin(), dst.records.end(), [](auto& a, auto& b) { return a.time < b.time; });
+    return true;
+}
 
-    TAnimationCurve<float> curve(GetTimeCurve());
-    curve.resize(scene_count);
-    for (size_t i = 0; i < scene_count; ++i) {
-        TAnimationCurve<float>::key_t& kvp = curve[i];
-        kvp.time = kvp.value = m_records[i].time;
+bool SceneCacheInputFile::Rewrite(const char *path, const SceneCacheRewriteSettings& settings)
+{
+    if (!IsValid() || !path)
+        return false;
+
+    // [begin, end) in time order
+    size_t begin = 0, end = m_records.size();
+    while (begin < end && m_records[begin].time < settings.timeRange.start)
+        ++begin;
+    while (end > begin && m_records[end - 1].time > settings.timeRange.end)
+        --end;
+    if (begin == end)
+        return false;
+
+    // scenes can be copied only if they are all unstripped, or all stripped against the scene that comes first in the new file
+    const int base = m_records[begin].base >= 0 ? static_cast<int>(begin) : -1;
+    const bool restrip = std::any_of(m_records.begin() + begin, m_records.begin() + end, [base](const SceneRecord& rec) {
+        return rec.base != base;
+    });
+    if (restrip)
+        return RewriteDecoded(path, settings, begin, end);
+    else
+        return RewriteEncoded(path, settings, begin, end);
+}
+
+// the scene the sample at sceneIndex is merged with. null if it isn't stripped or is a base itself.
+ScenePtr SceneCacheInputFile::GetBaseScene(const size_t sceneIndex) const
+{
+    const int base = m_records[sceneIndex].base;
+    if (base < 0 || base == static_cast<int>(sceneIndex))
+        return nullptr;
+    auto it = m_baseScenes.find(static_cast<size_t>(base));
+    return it != m_baseScenes.end() ? it->second : nullptr;
+}
+
+// copy the scenes as they are encoded. the sections are rebuilt as scenes may have been dropped or shards concatenated.
+bool SceneCacheInputFile::RewriteEncoded(const char *path, const SceneCacheRewriteSettings& settings, const size_t begin, const size_t end)
+{
+    CacheFileHeader header = m_header;
+    // a shard set may mix stripped and unstripped shards
+    header.exportSettings.stripUnchanged = m_records[begin].base >= 0 ? 1 : 0;
+    BufferEncoderPtr encoder = m_encoder;
+    if (settings.changeEncoding) {
+        header.exportSettings.encoding = settings.encoding;
+        header.exportSettings.encoderSettings = settings.encoderSettings;
+        encoder = BufferEncoder::CreateEncoder(settings.encoding, settings.encoderSettings);
+        if (!encoder)
+            return false;
     }
 
+    std::ofstream os(path, std::ios::binary);
+    if (!os)
+        return false;
+    os.write(reinterpret_cast<char*>(&header), sizeof(header));
+
+    CacheFileIndex index;
     {
-        RawVector<char> encoded_buf, tmp_buf;
+        // get exclusive file access
+        std::unique_lock<std::mutex> lock(m_mutex);
 
-        // read meta data
-        CacheFileMetaHeader mh;
-        m_stream->read(reinterpret_cast<char*>(&mh), sizeof(mh));
+        RawVector<char> buf, src, decoded;
+        std::vector<RawVector<char>> encoded;
+        RawVector<uint64_t> buffer_sizes;
+        for (size_t i = begin; i < end; ++i) {
+            SceneRecord& rec = m_records[i];
+            buf.resize_discard(static_cast<size_t>(rec.bufferSizeTotal));
+            rec.stream->seekg(rec.pos, std::ios::beg);
+            rec.stream->read(buf.data(), buf.size());
+            if (!*rec.stream)
+                return false;
+
+            buffer_sizes = rec.bufferSizes;
+            const size_t seg_count = rec.bufferSizes.size();
+            if (settings.changeEncoding) {
+                encoded.resize(seg_count);
+                size_t pos = 0;
+                for (size_t si = 0; si < seg_count; ++si) {
+                    const size_t size = static_cast<size_t>(rec.bufferSizes[si]);
+                    src.assign(buf.cdata() + pos, buf.cdata() + pos + size);
+                    m_encoder->DecodeV(decoded, src);
+                    if (decoded.empty() && size > 0)
+                        return false;
+                    encoder->EncodeV(encoded[si], decoded);
+                    buffer_sizes[si] = encoded[si].size();
+                    pos += size;
+                }
+            }
 
-        encoded_buf.resize(static_cast<size_t>(mh.size));
-        m_stream->read(encoded_buf.data(), encoded_buf.size());
+            CacheFileSceneHeader sh;
+            sh.bufferCount = static_cast<uint32_t>(seg_count);
+            sh.time = rec.time;
+            os.write(reinterpret_cast<char*>(&sh), sizeof(sh));
+            os.write(reinterpret_cast<const char*>(buffer_sizes.cdata()), buffer_sizes.size_in_byte());
+            if (settings.changeEncoding) {
+                for (RawVector<char>& e : encoded)
+                    os.write(e.cdata(), e.size());
+            }
+            else {
+                os.write(buf.cdata(), buf.size());
+            }
 
-        m_encoder->DecodeV(tmp_buf, encoded_buf);
-        m_entityMeta.resize_discard(tmp_buf.size() / sizeof(CacheFileEntityMeta));
-        tmp_buf.copy_to(reinterpret_cast<char*>(m_entityMeta.data()));
+            index.segmentEntities.push_back(rec.segmentEntities);
+        }
     }
 
-    if (m_header.exportSettings.stripUnchanged)
-        m_baseScene = LoadByFrameInternal(0);
+    CacheFileSceneHeader terminator = CacheFileSceneHeader::terminator();
+    os.write(reinterpret_cast<char*>(&terminator), sizeof(terminator));
+
+    // constant over all scenes means constant over any of them. meta is kept as it is.
+    WriteMetaSection(os, *encoder, m_entityMeta);
+    if (m_hasEntityIndex) {
+        for (auto& kvp : m_entityIDs)
+            index.entityPaths[kvp.second] = kvp.first;
+        WriteIndexSection(os, *encoder, index);
+        if (m_hasBounds) {
+            RawVector<CacheFileEntityBounds> bounds;
+            for (CacheFileEntityBounds b : m_entityBounds) {
+                b.frameBegin = std::max(b.frameBegin, static_cast<int>(begin)) - static_cast<int>(begin);
+                b.frameEnd = std::min(b.frameEnd, static_cast<int>(end)) - static_cast<int>(begin);
+                if (b.frameBegin < b.frameEnd)
+                    bounds.push_back(b);
+            }
+            WriteBoundsSection(os, *encoder, bounds);
+        }
+    }
+    os.close();
+    return !os.fail();
+}
 
-    //PreloadAll(); // for test
+// the scenes are loaded and written again. the first one becomes the new base of the stripped ones.
+bool SceneCacheInputFile::RewriteDecoded(const char *path, const SceneCacheRewriteSettings& settings, const size_t begin, const size_t end)
+{
+    SceneCacheOutputSettings oscs;
+    oscs.exportSettings = m_header.exportSettings;
+    if (settings.changeEncoding) {
+        oscs.exportSettings.encoding = settings.encoding;
+        oscs.exportSettings.encoderSettings = settings.encoderSettings;
+    }
+    // loaded scenes are already processed
+    oscs.exportSettings.applyRefinement = 0;
+    oscs.exportSettings.flattenHierarchy = 0;
+    oscs.exportSettings.stripNormals = 0;
+    oscs.exportSettings.stripTangents = 0;
+
+    SceneCacheOutputFile dst(path, oscs);
+    if (!dst.IsValid())
+        return false;
+    for (size_t i = begin; i < end; ++i) {
+        ScenePtr scene = LoadByFrameInternal(i);
+        if (!scene)
+            return false;
+        // the writer strips and sorts in place. loaded scenes may be shared.
+        dst.AddScene(scene->clone(true), m_records[i].time);
+    }
+    return dst.Close();
 }
 
+bool SceneCacheInputFile::MergeShards(const char *dstPath, const std::vector<std::string>& shardPaths)
+{
+    const SceneCacheInputSettings iscs;
+    SceneCacheInputFile merged;
+    merged.Init(shardPaths, iscs);
+    return merged.Rewrite(dstPath, SceneCacheRewriteSettings());
+}
 
 SceneCacheInputFile::StreamPtr SceneCacheInputFile::CreateStream(const char *path, const SceneCacheInputSettings& /*iscs*/)
 {
@@ -185,6 +535,8 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
     if (!IsValid() || sceneIndex >= m_records.size())
         return nullptr;
 
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::SceneCache);
+
     SceneRecord& rec = m_records[sceneIndex];
     if (waitPreload && rec.preload.valid()) {
         // wait preload
@@ -192,22 +544,68 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
         rec.preload = {};
     }
 
-    ScenePtr& ret = rec.scene;
-    if (ret)
-        return ret; // already loaded
+    ScenePtr ret;
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        if (rec.scene) {
+            // already loaded. move to the most recently used end.
+            auto it = std::find(m_history.begin(), m_history.end(), sceneIndex);
+            if (it != m_history.end()) {
+                m_history.erase(it);
+                m_history.push_back(sceneIndex);
+            }
+            return rec.scene;
+        }
+        if (m_decodedNeighbor && m_decodedNeighborIndex == sceneIndex)
+            ret.swap(m_decodedNeighbor); // decoded for the velocities of the sample after it
+    }
+
+    if (!ret)
+        ret = DecodeScene(sceneIndex, !waitPreload);
+    if (ret && GetSettings().generateVelocities)
+        ret = GenerateVelocities(ret, sceneIndex);
+
+    // push & pop history
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        rec.scene = ret;
+        if (ret && m_baseScenes.find(sceneIndex) == m_baseScenes.end())
+            m_history.push_back(sceneIndex);
+        if (ret) {
+            // moving averages for the preload scheduler
+            const SceneProfileData& prof = ret->profile_data;
+            const float weight = m_averageLoadTime == 0.0f ? 1.0f : 0.25f;
+            m_averageLoadTime += (prof.load_time - m_averageLoadTime) * weight;
+            m_averageSampleSize += (static_cast<float>(prof.size_decoded) - m_averageSampleSize) * weight;
+        }
+    }
+    PopOverflowedSamples();
+    return ret;
+}
+
+// read, decode, merge and import a sample. the result is not cached.
+ScenePtr SceneCacheInputFile::DecodeScene(const size_t sceneIndex, const bool preload)
+{
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::SceneCache);
+    SceneRecord& rec = m_records[sceneIndex];
+    ScenePtr ret;
 
     const mu::nanosec load_begin = mu::Now();
 
     const size_t seg_count = rec.bufferSizes.size();
-    rec.segments.resize(seg_count);
+    std::vector<SceneSegment> segments(seg_count);
 
     {
         // get exclusive file access
         std::unique_lock<std::mutex> lock(m_mutex);
 
-        m_stream->seekg(rec.pos, std::ios::beg);
+        // preloads queue up here. skip the ones that fell out of the preload window in the meantime.
+        if (preload && m_preloadCancelled[sceneIndex])
+            return nullptr;
+
+        rec.stream->seekg(rec.pos, std::ios::beg);
         for (size_t si = 0; si < seg_count; ++si) {
-            SceneSegment& seg = rec.segments[si];
+            SceneSegment& seg = segments[si];
             seg.encodedSize = rec.bufferSizes[si];
 
             // read segment
@@ -216,51 +614,26 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
                 mu::ScopedTimer timer;
 
                 seg.encodedBuf.resize(static_cast<size_t>(seg.encodedSize));
-                m_stream->read(seg.encodedBuf.data(), seg.encodedBuf.size());
+                rec.stream->read(seg.encodedBuf.data(), seg.encodedBuf.size());
 
                 seg.readTime = timer.elapsed();
             }
 
             // launch async decode
             seg.task = std::async(std::launch::async, [this, &seg, sceneIndex, si]() {
-                msProfileScope("SceneCacheInputFile: [%d] decode segment (%d)", (int)sceneIndex, (int)si);
-                mu::ScopedTimer timer;
-
-                RawVector<char> tmp_buf;
-                m_encoder->DecodeV(tmp_buf, seg.encodedBuf);
-                seg.decodedSize = tmp_buf.size();
-
-                std::shared_ptr<Scene> ret = Scene::create();
-                mu::MemoryStream scene_buf(std::move(tmp_buf));
-                try {
-                    ret->deserialize(scene_buf);
-
-                    // keep scene buffer alive. Meshes will use it as vertex buffers
-                    ret->scene_buffers.push_back(scene_buf.moveBuffer());
-                    seg.segment = ret;
-
-                    // count vertices
-                    seg.vertexCount = 0;
-                    for (std::vector<std::shared_ptr<Transform>>::value_type& e : seg.segment->entities)
-                        seg.vertexCount += e->vertexCount();
-                }
-                catch (std::runtime_error& e) {
-                    muLogError("exception: %s\n", e.what());
-                    ret = nullptr;
-                    seg.error = true;
-                }
-
-                seg.decodeTime = timer.elapsed();
+                DecodeSegment(seg, sceneIndex, si);
             });
         }
     }
 
     // concat segmented scenes
     for (size_t si = 0; si < seg_count; ++si) {
-        SceneSegment& seg = rec.segments[si];
+        SceneSegment& seg = segments[si];
         seg.task.wait();
-        if (seg.error)
+        if (seg.error) {
+            ret = nullptr;
             break;
+        }
 
         if (si == 0)
             ret = seg.segment;
@@ -276,7 +649,7 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
         SceneProfileData& prof = ret->profile_data;
         prof = {};
         prof.load_time = mu::NS2MS(mu::Now() - load_begin);
-        for (std::vector<SceneSegment>::value_type& seg : rec.segments) {
+        for (SceneSegment& seg : segments) {
             prof.size_encoded += seg.encodedSize;
             prof.size_decoded += seg.decodedSize;
             prof.read_time += seg.readTime;
@@ -288,7 +661,8 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
             msProfileScope("SceneCacheInputFile: [%d] merge & import", static_cast<int>(sceneIndex));
             mu::ScopedTimer timer;
 
-            if (m_header.exportSettings.stripUnchanged && m_baseScene) {
+            const ScenePtr base_scene = GetBaseScene(sceneIndex);
+            if (base_scene) {
                 // set cache flags
                 size_t n = ret->entities.size();
                 if (m_entityMeta.size() == n) {
@@ -301,7 +675,7 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
                 }
 
                 // merge
-                ret->merge(*m_baseScene);
+                ret->merge(*base_scene);
             }
 
             // do import
@@ -311,16 +685,80 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
             prof.setup_time = timer.elapsed();
         }
     }
-    rec.segments.clear();
+    return ret;
+}
 
-    // push & pop history
-    if (!m_header.exportSettings.stripUnchanged || sceneIndex != 0) {
-        m_history.push_back(sceneIndex);
-        PopOverflowedSamples();
+// velocities from the difference to the previous sample, or to the next one for the first sample.
+// the neighbor is shared if it is loaded or preloaded. otherwise it is decoded and kept until it is loaded itself,
+// so that playing backwards decodes each sample once.
+ScenePtr SceneCacheInputFile::GenerateVelocities(const ScenePtr& scene, const size_t sceneIndex)
+{
+    const size_t neighbor_index = sceneIndex > 0 ? sceneIndex - 1 : sceneIndex + 1;
+    if (neighbor_index >= m_records.size())
+        return scene;
+
+    ScenePtr neighbor;
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        neighbor = m_records[neighbor_index].scene;
+        if (!neighbor && m_decodedNeighbor && m_decodedNeighborIndex == neighbor_index)
+            neighbor = m_decodedNeighbor;
+    }
+    if (!neighbor) {
+        neighbor = DecodeScene(neighbor_index, false);
+        if (!neighbor)
+            return scene;
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        m_decodedNeighbor = neighbor;
+        m_decodedNeighborIndex = neighbor_index;
     }
+
+    msProfileScope("SceneCacheInputFile: [%d] generate velocities", static_cast<int>(sceneIndex));
+    mu::ScopedTimer timer;
+
+    // the base scene is merged into the other samples. velocities must not leak into them.
+    // the copy-on-write clone shares everything else and keeps the base alive.
+    auto base = m_baseScenes.find(sceneIndex);
+    ScenePtr ret = base != m_baseScenes.end() && base->second == scene ? scene->clone(true) : scene;
+    ret->genVelocities(*neighbor, m_records[sceneIndex].time - m_records[neighbor_index].time);
+    ret->profile_data.setup_time += timer.elapsed();
     return ret;
 }
 
+// decode and deserialize. thread safe as long as segments are not shared
+void SceneCacheInputFile::DecodeSegment(SceneSegment& seg, const size_t sceneIndex, const size_t segmentIndex)
+{
+    msProfileScope("SceneCacheInputFile: [%d] decode segment (%d)", (int)sceneIndex, (int)segmentIndex);
+    mu::ScopedTimer timer;
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::SceneCache);
+
+    RawVector<char> tmp_buf;
+    m_encoder->DecodeV(tmp_buf, seg.encodedBuf);
+    seg.decodedSize = tmp_buf.size();
+
+    std::shared_ptr<Scene> ret = Scene::create();
+    mu::MemoryStream scene_buf(std::move(tmp_buf));
+    try {
+        ret->deserialize(scene_buf);
+
+        // keep scene buffer alive. Meshes will use it as vertex buffers
+        ret->scene_buffers.push_back(scene_buf.moveBuffer());
+        seg.segment = ret;
+
+        // count vertices
+        seg.vertexCount = 0;
+        for (std::vector<std::shared_ptr<Transform>>::value_type& e : seg.segment->entities)
+            seg.vertexCount += e->vertexCount();
+    }
+    catch (std::runtime_error& e) {
+        muLogError("exception: %s\n", e.what());
+        ret = nullptr;
+        seg.error = true;
+    }
+
+    seg.decodeTime = timer.elapsed();
+}
+
 ScenePtr SceneCacheInputFile::PostProcess(ScenePtr& sp, const size_t sceneIndex)
 {
     if (!sp)
@@ -353,8 +791,17 @@ ScenePtr SceneCacheInputFile::PostProcess(ScenePtr& sp, const size_t sceneIndex)
 bool SceneCacheInputFile::KickPreload(size_t i)
 {
     SceneRecord& rec = m_records[i];
-    if (rec.scene || rec.preload.valid())
-        return false; // already loaded or loading
+    m_preloadCancelled[i] = false;
+    if (rec.preload.valid()) {
+        if (rec.preload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false; // loading
+        rec.preload = {}; // finished or cancelled
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        if (rec.scene)
+            return false; // already loaded
+    }
 
     rec.preload = std::async(std::launch::async, [this, i]() { LoadByFrameInternal(i, false); });
     return true;
@@ -370,11 +817,40 @@ void SceneCacheInputFile::WaitAllPreloads()
     }
 }
 
+// estimate direction and speed of playback from the frames requested recently
+void SceneCacheInputFile::TrackPlayback(const int frame)
+{
+    // longer pauses than this start a new estimate
+    const float ResetIntervalMS = 1000.0f;
+
+    if (frame == m_playbackFrame)
+        return;
+
+    const mu::nanosec now = mu::Now();
+    if (m_playbackFrame >= 0) {
+        const int step = frame - m_playbackFrame;
+        const float interval = mu::NS2MS(now - m_playbackTime);
+        m_playbackDirection = step > 0 ? 1 : -1;
+        if (interval > ResetIntervalMS || m_playbackInterval == 0.0f) {
+            m_playbackStride = static_cast<float>(std::abs(step));
+            m_playbackInterval = std::min(interval, ResetIntervalMS);
+        }
+        else {
+            m_playbackStride += (static_cast<float>(std::abs(step)) - m_playbackStride) * 0.25f;
+            m_playbackInterval += (interval - m_playbackInterval) * 0.25f;
+        }
+    }
+    m_playbackFrame = frame;
+    m_playbackTime = now;
+}
+
 ScenePtr SceneCacheInputFile::LoadByFrameV(const int32_t frame)
 {
     if (!IsValid())
         return nullptr;
 
+    TrackPlayback(frame);
+
     //already loaded
     if (m_loadedFrame0 == frame && m_loadedFrame1 == frame)
         return nullptr;
@@ -384,11 +860,162 @@ ScenePtr SceneCacheInputFile::LoadByFrameV(const int32_t frame)
     return PostProcess(ret, frame);
 }
 
+// only the segments that contain the entities are read and decoded.
+// a sample that is already loaded is shared instead. files without the entity index load whole samples.
+ScenePtr SceneCacheInputFile::LoadEntitiesInternal(const size_t sceneIndex, const std::vector<int>& ids)
+{
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::SceneCache);
+    SceneRecord& rec = m_records[sceneIndex];
+
+    std::vector<int> wanted = ids;
+    std::sort(wanted.begin(), wanted.end());
+    const auto isWanted = [&wanted](const int id) { return std::binary_search(wanted.begin(), wanted.end(), id); };
+
+    ScenePtr ret = Scene::create();
+    ScenePtr loaded;
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        loaded = rec.scene;
+    }
+    if (!loaded && !m_hasEntityIndex) {
+        loaded = LoadByFrameInternal(sceneIndex);
+        if (!loaded)
+            return nullptr;
+    }
+    if (loaded) {
+        ret->settings = loaded->settings;
+        for (std::shared_ptr<Transform>& e : loaded->entities) {
+            if (isWanted(e->id))
+                ret->entities.push_back(e);
+        }
+        ret->profile_data = loaded->profile_data;
+        // entities may point to its scene buffers
+        ret->data_sources.push_back(loaded);
+        return ret;
+    }
+
+    const mu::nanosec load_begin = mu::Now();
+
+    std::vector<size_t> segment_indices;
+    for (size_t si = 0; si < rec.segmentEntities.size(); ++si) {
+        const std::vector<int>& segment_ids = rec.segmentEntities[si];
+        if (std::any_of(segment_ids.begin(), segment_ids.end(), isWanted))
+            segment_indices.push_back(si);
+    }
+
+    std::vector<SceneSegment> segments(segment_indices.size());
+    {
+        // get exclusive file access
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (size_t i = 0; i < segment_indices.size(); ++i) {
+            const size_t si = segment_indices[i];
+            SceneSegment& seg = segments[i];
+            seg.encodedSize = rec.bufferSizes[si];
+
+            uint64_t pos = rec.pos;
+            for (size_t j = 0; j < si; ++j)
+                pos += rec.bufferSizes[j];
+
+            {
+                msProfileScope("SceneCacheInputFile: [%d] read segment (%d - %u byte)", (int)sceneIndex, (int)si, (uint32_t)seg.encodedSize);
+                mu::ScopedTimer timer;
+
+                rec.stream->seekg(pos, std::ios::beg);
+                seg.encodedBuf.resize(static_cast<size_t>(seg.encodedSize));
+                rec.stream->read(seg.encodedBuf.data(), seg.encodedBuf.size());
+
+                seg.readTime = timer.elapsed();
+            }
+
+            seg.task = std::async(std::launch::async, [this, &seg, sceneIndex, si]() {
+                DecodeSegment(seg, sceneIndex, si);
+            });
+        }
+    }
+
+    SceneProfileData& prof = ret->profile_data;
+    bool error = false;
+    for (SceneSegment& seg : segments) {
+        seg.task.wait();
+        if (seg.error) {
+            error = true;
+            continue;
+        }
+
+        prof.size_encoded += seg.encodedSize;
+        prof.size_decoded += seg.decodedSize;
+        prof.read_time += seg.readTime;
+        prof.decode_time += seg.decodeTime;
+        prof.vertex_count += seg.vertexCount;
+
+        Scene& segment = *seg.segment;
+        ret->assets.insert(ret->assets.end(), segment.assets.begin(), segment.assets.end());
+        for (std::shared_ptr<Transform>& e : segment.entities) {
+            if (isWanted(e->id))
+                ret->entities.push_back(e);
+        }
+        for (RawVector<char>& buf : segment.scene_buffers)
+            ret->scene_buffers.push_back(std::move(buf));
+    }
+    if (error)
+        return nullptr;
+
+    std::sort(ret->entities.begin(), ret->entities.end(), [](auto& a, auto& b) { return a->id < b->id; });
+
+    {
+        msProfileScope("SceneCacheInputFile: [%d] merge & import", static_cast<int>(sceneIndex));
+        mu::ScopedTimer timer;
+
+        const ScenePtr base_scene = GetBaseScene(sceneIndex);
+        if (base_scene) {
+            // entity meta and the base scene are in id order. Scene::merge() can't be used as it expects all entities.
+            const auto byID = [](auto& a, const int id) { return a->id < id; };
+            for (std::shared_ptr<Transform>& e : ret->entities) {
+                const auto meta = std::lower_bound(m_entityMeta.begin(), m_entityMeta.end(), e->id,
+                    [](const CacheFileEntityMeta& a, const int id) { return a.id < id; });
+                if (meta != m_entityMeta.end() && meta->id == e->id) {
+                    e->cache_flags.constant = meta->constant;
+                    e->cache_flags.constant_topology = meta->constantTopology;
+                }
+
+                std::vector<TransformPtr>& base_entities = base_scene->entities;
+                const auto base = std::lower_bound(base_entities.begin(), base_entities.end(), e->id, byID);
+                if (base != base_entities.end() && (*base)->id == e->id)
+                    e->merge(**base);
+            }
+        }
+
+        ret->import(GetSettings().importSettings);
+        prof.setup_time = timer.elapsed();
+    }
+    prof.load_time = mu::NS2MS(mu::Now() - load_begin);
+    return ret;
+}
+
+ScenePtr SceneCacheInputFile::LoadEntitiesByFrameV(const int32_t frame, const std::vector<int>& ids)
+{
+    if (!IsValid() || frame < 0 || frame >= static_cast<int>(m_records.size()))
+        return nullptr;
+
+    // keep a reference. plugin APIs return raw scene pointers.
+    m_lastEntities = LoadEntitiesInternal(frame, ids);
+    return m_lastEntities;
+}
+
+int SceneCacheInputFile::FindEntityIDV(const std::string& path) const
+{
+    const auto it = m_entityIDs.find(path);
+    return it != m_entityIDs.end() ? it->second : InvalidID;
+}
+
 ScenePtr SceneCacheInputFile::LoadByTimeV(const float time, const bool interpolation)
 {
     if (!IsValid())
         return nullptr;
 
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::SceneCache);
+
     if (time == m_lastTime) {
         return nullptr;
     }
@@ -406,6 +1033,7 @@ ScenePtr SceneCacheInputFile::LoadByTimeV(const float time, const bool interpola
     }
 
     const int frame= GetFrameByTimeV(time);
+    TrackPlayback(frame);
     if (!interpolation){
         return LoadByFrameV(frame);
     } 
@@ -428,8 +1056,16 @@ ScenePtr SceneCacheInputFile::LoadByTimeV(const float time, const bool interpola
         msProfileScope("SceneCacheInputFile: [%d] lerp", (int)si);
         mu::ScopedTimer timer;
 
+        // alternate two destination scenes. the previous result stays intact for diff().
+        // a scene that is still referenced from outside is left alone and replaced.
+        m_lerpSceneIndex = (m_lerpSceneIndex + 1) % 2;
+        ScenePtr& dst = m_lerpScenes[m_lerpSceneIndex];
+        if (!dst || dst.use_count() > 1)
+            dst = Scene::create();
+        ret = dst;
+        ret->data_sources.clear();
+
         const float t = (time - t1) / (t2 - t1);
-        ret = Scene::create();
         ret->lerp(*s1, *s2, t);
         // keep a reference for s1 (s2 is not needed)
         ret->data_sources.push_back(s1);
@@ -452,16 +1088,69 @@ void SceneCacheInputFile::RefreshV()
     m_lastDiff = nullptr;
 }
 
+// preload the frames playback is heading to. the preload length is the minimum window.
+// the window grows when loading a sample takes longer than playback advances, up to what the memory budget allows.
+// preloads that fell out of the window and haven't started reading yet are cancelled.
 void SceneCacheInputFile::PreloadV(const int frame)
 {
-    // kick preload
+    // upper limit of the window, relative to the preload length
+    const int MaxWindowScale = 4;
+
     const int32_t preloadLength = GetPreloadLength();
-    if (preloadLength> 0 && frame + 1 < m_records.size()) {
-        const int begin_frame = frame + 1;
-        const int end_frame = std::min(frame + preloadLength, static_cast<int>(m_records.size()));
-        for (int f = begin_frame; f < end_frame; ++f)
-            KickPreload(f);
+    const int sceneCount = static_cast<int>(m_records.size());
+    if (preloadLength <= 0 || frame < 0 || frame >= sceneCount) {
+        m_preloadWindow0 = m_preloadWindow1 = -1;
+        PopOverflowedSamples();
+        return;
+    }
+
+    float averageLoadTime, averageSampleSize;
+    {
+        std::unique_lock<std::mutex> lock(m_historyMutex);
+        averageLoadTime = m_averageLoadTime;
+        averageSampleSize = m_averageSampleSize;
+    }
+
+    int length = preloadLength;
+    if (m_playbackInterval > 0.0f && averageLoadTime > 0.0f) {
+        const int needed = static_cast<int>(std::ceil(averageLoadTime / m_playbackInterval)) + 1;
+        length = std::clamp(needed, preloadLength, preloadLength * MaxWindowScale);
     }
+    const uint64_t maxBytes = GetMaxLoadedBytes();
+    if (maxBytes > 0 && averageSampleSize > 0.0f) {
+        // leave room for the two samples being shown
+        const int affordable = static_cast<int>(static_cast<float>(maxBytes) / averageSampleSize) - 2;
+        length = std::max(std::min(length, affordable), 1);
+    }
+
+    const int direction = m_playbackDirection;
+    const int stride = std::max(static_cast<int>(m_playbackStride + 0.5f), 1);
+    std::vector<size_t> window;
+    for (int i = 1; i <= length; ++i) {
+        const int f = frame + direction * stride * i;
+        if (f < 0 || f >= sceneCount)
+            break;
+        window.push_back(f);
+    }
+    if (window.empty()) {
+        m_preloadWindow0 = m_preloadWindow1 = -1;
+    }
+    else {
+        m_preloadWindow0 = static_cast<int>(std::min(window.front(), window.back()));
+        m_preloadWindow1 = static_cast<int>(std::max(window.front(), window.back()));
+    }
+
+    if (!m_preloadingAll) {
+        // cancel what is no longer wanted
+        for (size_t i : m_preloading) {
+            if (std::find(window.begin(), window.end(), i) == window.end())
+                m_preloadCancelled[i] = true;
+        }
+    }
+    for (size_t i : window)
+        KickPreload(i);
+    m_preloading = std::move(window);
+
     PopOverflowedSamples();
 }
 
@@ -469,17 +1158,129 @@ void SceneCacheInputFile::PreloadAll()
 {
     const size_t n = m_records.size();
     SetMaxLoadedSamples(static_cast<int>(n) + 1);
+    m_preloadingAll = true;
     for (size_t i = 0; i < n; ++i)
         KickPreload(i);
 }
 
+// evict least recently used samples until the cache fits in the byte budget, or in the sample count if no budget is set.
+// pinned samples are skipped. the cache can stay over budget if the pinned ones alone exceed it.
 void SceneCacheInputFile::PopOverflowedSamples()
 {
-    const int32_t maxSamples = GetMaxLoadedSamples();
-    while (m_history.size() > maxSamples) {
-        m_records[m_history.front()].scene.reset();
-        m_history.pop_front();
+    const uint64_t maxBytes = GetMaxLoadedBytes();
+    const size_t maxSamples = static_cast<size_t>(std::max(GetMaxLoadedSamples(), 0));
+
+    std::unique_lock<std::mutex> lock(m_historyMutex);
+    uint64_t loadedBytes = 0;
+    for (size_t i : m_history)
+        loadedBytes += GetLoadedSize(i);
+
+    auto overflowed = [&]() {
+        return maxBytes > 0 ? loadedBytes > maxBytes : m_history.size() > maxSamples;
+    };
+    for (auto it = m_history.begin(); it != m_history.end() && overflowed(); ) {
+        if (IsPinned(*it)) {
+            ++it;
+            continue;
+        }
+        const uint64_t size = GetLoadedSize(*it);
+        m_records[*it].scene.reset();
+        loadedBytes -= size;
+        m_evictedBytes += size;
+        ++m_evictions;
+        it = m_history.erase(it);
+    }
+}
+
+// the samples being shown and the ones in the preload window stay loaded
+bool SceneCacheInputFile::IsPinned(const size_t sceneIndex) const
+{
+    const int i = static_cast<int>(sceneIndex);
+    const int frame0 = m_loadedFrame0, frame1 = m_loadedFrame1;
+    if (frame0 >= 0 && i >= frame0 && i <= frame1)
+        return true;
+    const int window0 = m_preloadWindow0, window1 = m_preloadWindow1;
+    return window0 >= 0 && i >= window0 && i <= window1;
+}
+
+// m_historyMutex must be locked
+uint64_t SceneCacheInputFile::GetLoadedSize(const size_t sceneIndex) const
+{
+    const ScenePtr& scene = m_records[sceneIndex].scene;
+    return scene ? scene->profile_data.size_decoded : 0;
+}
+
+SceneCacheMemoryReport SceneCacheInputFile::GetMemoryReportV() const
+{
+    SceneCacheMemoryReport ret;
+    ret.budgetBytes = GetMaxLoadedBytes();
+    ret.maxLoadedSamples = GetMaxLoadedSamples();
+
+    std::unique_lock<std::mutex> lock(m_historyMutex);
+    for (size_t i : m_history) {
+        const uint64_t size = GetLoadedSize(i);
+        ret.loadedBytes += size;
+        ++ret.loadedSamples;
+        if (IsPinned(i)) {
+            ret.pinnedBytes += size;
+            ++ret.pinnedSamples;
+        }
     }
+    if (m_decodedNeighbor) {
+        ret.loadedBytes += m_decodedNeighbor->profile_data.size_decoded;
+        ++ret.loadedSamples;
+    }
+    for (auto& kvp : m_baseScenes) {
+        // merged into every sample of their shard. held while the file is open.
+        if (!kvp.second)
+            continue;
+        ret.loadedBytes += kvp.second->profile_data.size_decoded;
+        ret.pinnedBytes += kvp.second->profile_data.size_decoded;
+        ++ret.loadedSamples;
+        ++ret.pinnedSamples;
+    }
+    ret.evictedBytes = m_evictedBytes;
+    ret.evictions = m_evictions;
+    return ret;
+}
+
+template<class Body>
+bool SceneCacheInputFile::EachEntityBounds(const int32_t frame, const Body& body) const
+{
+    if (!m_hasBounds)
+        return false;
+    for (const CacheFileEntityBounds& b : m_entityBounds) {
+        if (frame >= b.frameBegin && frame < b.frameEnd)
+            body(b);
+    }
+    return true;
+}
+
+bool SceneCacheInputFile::FindEntitiesInBoxV(const int32_t frame, const mu::float3& bmin, const mu::float3& bmax, std::vector<int>& dst) const
+{
+    return EachEntityBounds(frame, [&](const CacheFileEntityBounds& b) {
+        if (b.bmin.x <= bmax.x && b.bmax.x >= bmin.x &&
+            b.bmin.y <= bmax.y && b.bmax.y >= bmin.y &&
+            b.bmin.z <= bmax.z && b.bmax.z >= bmin.z)
+            dst.push_back(b.id);
+    });
+}
+
+bool SceneCacheInputFile::FindEntitiesInFrustumV(const int32_t frame, const mu::float4 planes[6], std::vector<int>& dst) const
+{
+    return EachEntityBounds(frame, [&](const CacheFileEntityBounds& b) {
+        for (int i = 0; i < 6; ++i) {
+            // the corner furthest along the plane normal. the box is outside if even that is behind the plane.
+            const mu::float4& plane = planes[i];
+            const mu::float3 p{
+                plane.x >= 0.0f ? b.bmax.x : b.bmin.x,
+                plane.y >= 0.0f ? b.bmax.y : b.bmin.y,
+                plane.z >= 0.0f ? b.bmax.z : b.bmin.z };
+            if (mu::dot((const mu::float3&)plane, p) + plane.w < 0.0f)
+                return;
+        }
+        dst.push_back(b.id);
+    });
 }
 
 const AnimationCurvePtr SceneCacheInputFile::GetFrameCurveV(const int baseFrame)
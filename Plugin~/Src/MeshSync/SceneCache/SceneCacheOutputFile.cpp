@@ -16,12 +16,34 @@ SceneCacheOutputFile::SceneCacheOutputFile(const char *path, const SceneCacheOut
     Init(CreateStream(path), oscs);
 }
 
+SceneCacheOutputFile::SceneCacheOutputFile(StreamPtr stream, const SceneCacheOutputSettings& oscs) {
+    Init(stream, oscs);
+}
+
 SceneCacheOutputFile::~SceneCacheOutputFile()
 {
-    if (!IsValid())
-        return;
+    Close();
+}
 
-    Flush();
+// wait for the queued scenes and append the terminator and the sections.
+// return false if any of it couldn't be written. the file can't take scenes afterwards.
+bool SceneCacheOutputFile::Close()
+{
+    if (m_writer.joinable()) {
+        Flush();
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_stopping = true;
+        }
+        m_condQueued.notify_all();
+        m_writer.join();
+    }
+    m_workers.reset();
+
+    if (!IsValid()) {
+        m_stream.reset();
+        return false;
+    }
 
     {
         // add terminator
@@ -31,24 +53,92 @@ SceneCacheOutputFile::~SceneCacheOutputFile()
 
     {
         // add meta data
-        mu::MemoryStream scene_buf;
+        RawVector<CacheFileEntityMeta> meta_data;
         for (std::vector<EntityRecord>::value_type& rec : m_entityRecords) {
             CacheFileEntityMeta meta{};
             meta.id = rec.id;
             meta.type = static_cast<uint32_t>(rec.type);
             meta.constant = rec.unchangedCount == m_sceneCountWritten - 1;
             meta.constantTopology = rec.topologyUnchangedCount == m_sceneCountWritten - 1;
-            scene_buf.write(reinterpret_cast<char*>(&meta), sizeof(meta));
+            meta_data.push_back(meta);
         }
-        scene_buf.flush();
+        WriteMetaSection(*m_stream, *m_encoder, meta_data);
+    }
 
-        RawVector<char> encodedBuf;
-        m_encoder->EncodeV(encodedBuf, scene_buf.getBuffer());
+    WriteIndexSection(*m_stream, *m_encoder, m_index);
+    WriteBounds();
 
-        CacheFileMetaHeader header;
-        header.size = encodedBuf.size();
-        m_stream->write(reinterpret_cast<char*>(&header), sizeof(header));
-        m_stream->write(encodedBuf.data(), encodedBuf.size());
+    m_stream->flush();
+    const bool ret = static_cast<bool>(*m_stream);
+    m_stream.reset();
+    return ret;
+}
+
+// merge the bounds of consecutive scenes into ranges. static geometries end up with one record.
+void SceneCacheOutputFile::WriteBounds()
+{
+    std::stable_sort(m_sceneBounds.begin(), m_sceneBounds.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    std::map<int, CacheFileEntityBounds> current;
+    RawVector<CacheFileEntityBounds> ranges;
+    const int scene_count = static_cast<int>(m_sceneBounds.size());
+    for (int frame = 0; frame < scene_count; ++frame) {
+        for (CacheFileEntityBounds& b : m_sceneBounds[frame].second) {
+            auto it = current.find(b.id);
+            if (it != current.end()) {
+                CacheFileEntityBounds& c = it->second;
+                if (c.frameEnd == frame && c.bmin == b.bmin && c.bmax == b.bmax) {
+                    c.frameEnd = frame + 1;
+                    continue;
+                }
+                ranges.push_back(c);
+            }
+            b.frameBegin = frame;
+            b.frameEnd = frame + 1;
+            current[b.id] = b;
+        }
+    }
+    for (auto& kvp : current)
+        ranges.push_back(kvp.second);
+    std::sort(ranges.begin(), ranges.end(), [](auto& a, auto& b) {
+        return a.id != b.id ? a.id < b.id : a.frameBegin < b.frameBegin;
+    });
+
+    WriteBoundsSection(*m_stream, *m_encoder, ranges);
+}
+
+// world space AABBs of geometries. must be called before stripping unchanged data.
+void SceneCacheOutputFile::GatherBounds(Scene& scene, std::vector<CacheFileEntityBounds>& dst)
+{
+    // unset transform values are infinity. they mean 'keep the current value' to receivers, identity here.
+    const auto local_matrix = [](const Transform& t) {
+        return mu::transform(
+            mu::is_inf(t.position) ? mu::float3::zero() : t.position,
+            mu::is_inf(t.rotation) ? mu::quatf::identity() : t.rotation,
+            mu::is_inf(t.scale) ? mu::float3::one() : t.scale);
+    };
+
+    scene.buildHierarchy(); // to resolve parents
+    for (std::shared_ptr<Transform>& e : scene.entities) {
+        Bounds bounds;
+        if (!e->isGeometry() || !e->getBounds(bounds))
+            continue;
+
+        mu::float4x4 world = local_matrix(*e);
+        for (const Transform *parent = e->parent; parent; parent = parent->parent)
+            world = world * local_matrix(*parent);
+
+        mu::float3 corners[8];
+        for (int i = 0; i < 8; ++i) {
+            corners[i] = bounds.center + bounds.extents * mu::float3{
+                (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f };
+        }
+        mu::MulPoints(world, corners, corners, 8);
+
+        CacheFileEntityBounds b;
+        b.id = e->id;
+        mu::MinMax(corners, 8, b.bmin, b.bmax);
+        dst.push_back(b);
     }
 }
 
@@ -116,80 +206,58 @@ static std::vector<ScenePtr> LoadBalancing(ScenePtr base, const int max_segments
     return segments;
 }
 
-void SceneCacheOutputFile::AddScene(const ScenePtr scene, const float time) {
+// the queue always takes one scene when empty, even if it alone exceeds maxQueueBytes.
+// with stripUnchanged, the next scenes have to wait for the first one as they are stripped against it.
+bool SceneCacheOutputFile::IsQueueFull() const
+{
+    const int count = m_sceneCountQueued - m_sceneCountWritten;
+    if (count == 0)
+        return false;
+    if (m_outputSettings.exportSettings.stripUnchanged && !m_baseScene)
+        return true;
+    if (count >= m_outputSettings.maxQueueSize)
+        return true;
+    return m_outputSettings.maxQueueBytes > 0 && m_queuedBytes >= m_outputSettings.maxQueueBytes;
+}
 
-    const SceneCacheExportSettings& scExportSettings = m_outputSettings.exportSettings;
-    while (m_sceneCountInQueue > 0 && ((scExportSettings.stripUnchanged && !m_baseScene) || m_sceneCountInQueue >= m_outputSettings.maxQueueSize)) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+bool SceneCacheOutputFile::CanAddScene() const
+{
+    std::unique_lock<std::mutex> l(m_mutex);
+    return !IsQueueFull();
+}
+
+void SceneCacheOutputFile::AddScene(const ScenePtr scene, const float time) {
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_condWritten.wait(l, [this]() { return !IsQueueFull(); });
     }
+    Enqueue(scene, time);
+}
+
+bool SceneCacheOutputFile::TryAddScene(const ScenePtr scene, const float time)
+{
+    if (!CanAddScene())
+        return false;
+    Enqueue(scene, time);
+    return true;
+}
 
+// AddScene() and TryAddScene() are called from one producer thread. the queue can't get full in between.
+void SceneCacheOutputFile::Enqueue(const ScenePtr scene, const float time)
+{
     std::shared_ptr<SceneRecord> rec_ptr = std::make_shared<SceneRecord>();
     SceneRecord& rec = *rec_ptr;
-    rec.index = m_sceneCountQueued++;
+    rec.index = m_sceneCountQueued;
     rec.time = time;
     rec.scene = scene;
+    if (m_outputSettings.maxQueueBytes > 0)
+        rec.size = ssize(*scene);
 
-    rec.task = std::async(std::launch::async, [this, &rec]() {
-        {
-            msProfileScope("SceneCacheOutputFile: [%d] scene optimization", rec.index);
-            const SceneCacheExportSettings& exportSettings = m_outputSettings.exportSettings;
-            ScenePtr& scene = rec.scene;
-            std::sort(scene->entities.begin(), scene->entities.end(), [](auto& a, auto& b) { return a->id < b->id; });
-
-            if (exportSettings.flattenHierarchy)
-                scene->flatternHierarchy();
-
-            if (exportSettings.stripNormals) {
-                scene->eachEntity<Mesh>([](Mesh& mesh) {
-                    mesh.normals.clear();
-                    mesh.md_flags.Set(MESH_DATA_FLAG_HAS_NORMALS , false);
-                    mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_NORMALS, false );
-                });
-            }
-            if (exportSettings.stripTangents) {
-                scene->eachEntity<Mesh>([](Mesh& mesh) {
-                    mesh.tangents.clear();
-                    mesh.md_flags.Set(MESH_DATA_FLAG_HAS_TANGENTS,false);
-                    mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_TANGENTS, false);
-                });
-            }
-
-            if (exportSettings.applyRefinement)
-                scene->import(m_outputSettings);
-
-            if (exportSettings.stripNormals) {
-                scene->eachEntity<Mesh>([](Mesh& mesh) {
-                    mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_NORMALS, true);
-                });
-            }
-            if (exportSettings.stripTangents) {
-                scene->eachEntity<Mesh>([](Mesh& mesh) {
-                    mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_TANGENTS, true);
-                });
-            }
-
-            // strip unchanged
-            if (exportSettings.stripUnchanged) {
-                if (!m_baseScene)
-                    m_baseScene = scene;
-                else
-                    scene->strip(*m_baseScene);
-            }
-
-            // split into segments
-            std::vector<ScenePtr> scene_segments = LoadBalancing(rec.scene, m_outputSettings.maxSceneSegments);
-            const size_t seg_count = scene_segments.size();
-            rec.segments.resize(seg_count);
-            for (size_t si = 0; si < seg_count; ++si) {
-                SceneSegment& seg = rec.segments[si];
-                seg.index = static_cast<int>(si);
-                seg.segment = scene_segments[si];
-                seg.segment->settings = {};
-            }
-        }
-
+    // the optimize job queues the segment jobs. it never waits for them, so workers can't deadlock on each other.
+    rec.task = m_workers->submit([this, &rec]() {
+        OptimizeScene(rec);
         for (std::vector<SceneSegment>::value_type& seg : rec.segments) {
-            seg.task = std::async(std::launch::async, [this, &rec, &seg]() {
+            seg.task = m_workers->submit([&rec, &seg, this]() {
                 msProfileScope("SceneCacheOutputFile: [%d] serialize & encode segment (%d)", rec.index, seg.index);
 
                 mu::MemoryStream scene_buf;
@@ -202,22 +270,97 @@ void SceneCacheOutputFile::AddScene(const ScenePtr scene, const float time) {
 
     {
         std::unique_lock<std::mutex> l(m_mutex);
+        m_queuedBytes += rec.size;
         m_queue.emplace_back(std::move(rec_ptr));
-        m_sceneCountInQueue = static_cast<int>(m_queue.size());
+        ++m_sceneCountQueued;
+    }
+    m_condQueued.notify_one();
+}
+
+void SceneCacheOutputFile::OptimizeScene(SceneRecord& rec)
+{
+    msProfileScope("SceneCacheOutputFile: [%d] scene optimization", rec.index);
+    const SceneCacheExportSettings& exportSettings = m_outputSettings.exportSettings;
+    ScenePtr& scene = rec.scene;
+    std::sort(scene->entities.begin(), scene->entities.end(), [](auto& a, auto& b) { return a->id < b->id; });
+
+    if (exportSettings.flattenHierarchy)
+        scene->flatternHierarchy();
+
+    if (exportSettings.stripNormals) {
+        scene->eachEntity<Mesh>([](Mesh& mesh) {
+            mesh.normals.clear();
+            mesh.md_flags.Set(MESH_DATA_FLAG_HAS_NORMALS , false);
+            mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_NORMALS, false );
+        });
+    }
+    if (exportSettings.stripTangents) {
+        scene->eachEntity<Mesh>([](Mesh& mesh) {
+            mesh.tangents.clear();
+            mesh.md_flags.Set(MESH_DATA_FLAG_HAS_TANGENTS,false);
+            mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_TANGENTS, false);
+        });
+    }
+
+    if (exportSettings.applyRefinement)
+        scene->import(m_outputSettings);
+
+    if (exportSettings.stripNormals) {
+        scene->eachEntity<Mesh>([](Mesh& mesh) {
+            mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_NORMALS, true);
+        });
+    }
+    if (exportSettings.stripTangents) {
+        scene->eachEntity<Mesh>([](Mesh& mesh) {
+            mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_TANGENTS, true);
+        });
+    }
+
+    if (!exportSettings.applyRefinement) {
+        // Scene::import() updates bounds. do it here if it is skipped.
+        for (std::shared_ptr<Transform>& e : scene->entities) {
+            if (e->isGeometry())
+                e->updateBounds();
+        }
+    }
+    GatherBounds(*scene, rec.bounds);
+
+    // strip unchanged
+    if (exportSettings.stripUnchanged) {
+        ScenePtr base;
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            if (!m_baseScene)
+                m_baseScene = scene;
+            base = m_baseScene;
+        }
+        if (base != scene)
+            scene->strip(*base);
+        else
+            m_condWritten.notify_all(); // AddScene() may be waiting for the base scene
+    }
+
+    // split into segments
+    std::vector<ScenePtr> scene_segments = LoadBalancing(rec.scene, m_outputSettings.maxSceneSegments);
+    const size_t seg_count = scene_segments.size();
+    rec.segments.resize(seg_count);
+    for (size_t si = 0; si < seg_count; ++si) {
+        SceneSegment& seg = rec.segments[si];
+        seg.index = static_cast<int>(si);
+        seg.segment = scene_segments[si];
+        seg.segment->settings = {};
     }
-    DoWrite();
 }
 
 void SceneCacheOutputFile::Flush()
 {
-    DoWrite();
-    if (m_task.valid())
-        m_task.wait();
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_condWritten.wait(l, [this]() { return m_sceneCountWritten == m_sceneCountQueued; });
 }
 
 bool SceneCacheOutputFile::IsWriting() const
 {
-    return m_task.valid() && m_task.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout;
+    return m_sceneCountWritten < m_sceneCountQueued;
 }
 
 int SceneCacheOutputFile::GetSceneCountWritten() const
@@ -227,83 +370,96 @@ int SceneCacheOutputFile::GetSceneCountWritten() const
 
 int SceneCacheOutputFile::GetSceneCountInQueue() const
 {
-    return m_sceneCountInQueue;
+    return m_sceneCountQueued - m_sceneCountWritten;
 }
 
-void SceneCacheOutputFile::DoWrite()
+// the write stage. takes scenes in the order they were added and waits for their jobs.
+// while a scene is written, the workers are already encoding the next ones.
+void SceneCacheOutputFile::WriterMain()
 {
-    auto body = [this]() {
-        for (;;) {
-            SceneRecordPtr rec_ptr;
-            {
-                std::unique_lock<std::mutex> l(m_mutex);
-                if (m_queue.empty()) {
-                    break;
-                }
-                else {
-                    rec_ptr = std::move(m_queue.back());
-                    m_queue.pop_back();
-                    m_sceneCountInQueue = static_cast<int>(m_queue.size());
-                }
-            }
-            if (!rec_ptr)
+    for (;;) {
+        SceneRecordPtr rec_ptr;
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_condQueued.wait(l, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty())
                 break;
-            SceneRecord& rec = *rec_ptr;
-            if (rec.task.valid())
-                rec.task.wait();
-            {
-
-                // update entity record
-                Scene& scene = *rec.scene;
-                const size_t n = scene.entities.size();
-                m_entityRecords.resize(n);
-                for (size_t i = 0; i < n; ++i) {
-                    std::shared_ptr<Transform>& e = scene.entities[i];
-                    EntityRecord& er = m_entityRecords[i];
-                    if (er.type == EntityType::Unknown) {
-                        er.type = e->getType();
-                        er.id = e->id;
-                    }
-                    else if (er.id != e->id)
-                        continue;
-
-                    if (e->isUnchanged())
-                        er.unchangedCount++;
-                    if (e->isTopologyUnchanged())
-                        er.topologyUnchangedCount++;
-                }
-            }
+            rec_ptr = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
 
-            // write
-            {
-                uint64_t total_buffer_size = 0;
-                RawVector<uint64_t> buffer_sizes;
-                for (std::vector<SceneSegment>::value_type& seg : rec.segments) {
-                    if (seg.task.valid())
-                        seg.task.wait();
-                    buffer_sizes.push_back(seg.encodedBuf.size());
-                    total_buffer_size += seg.encodedBuf.size();
-                }
+        WriteScene(*rec_ptr);
+        const uint64_t size = rec_ptr->size;
+        rec_ptr.reset();
 
-                msProfileScope("SceneCacheOutputFile: [%d] write (%u byte)", rec.index, (uint32_t)total_buffer_size);
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_queuedBytes -= size;
+            ++m_sceneCountWritten;
+        }
+        m_condWritten.notify_all();
+    }
+}
 
-                CacheFileSceneHeader header;
-                header.bufferCount = static_cast<uint32_t>(buffer_sizes.size());
-                header.time = rec.time;
-                m_stream->write(reinterpret_cast<char*>(&header), sizeof(header));
-                m_stream->write((char*)buffer_sizes.cdata(), buffer_sizes.size_in_byte());
-                for (std::vector<SceneSegment>::value_type& seg : rec.segments)
-                    m_stream->write(seg.encodedBuf.cdata(), seg.encodedBuf.size());
+void SceneCacheOutputFile::WriteScene(SceneRecord& rec)
+{
+    if (rec.task.valid())
+        rec.task.wait();
+    {
+        // update entity record
+        Scene& scene = *rec.scene;
+        const size_t n = scene.entities.size();
+        m_entityRecords.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            std::shared_ptr<Transform>& e = scene.entities[i];
+            EntityRecord& er = m_entityRecords[i];
+            if (er.type == EntityType::Unknown) {
+                er.type = e->getType();
+                er.id = e->id;
             }
-            ++m_sceneCountWritten;
+            else if (er.id != e->id)
+                continue;
+
+            if (e->isUnchanged())
+                er.unchangedCount++;
+            if (e->isTopologyUnchanged())
+                er.topologyUnchangedCount++;
         }
-    };
 
+        // update entity index. stripped entities have empty paths, the first sample has them all.
+        for (std::shared_ptr<Transform>& e : scene.entities) {
+            if (!e->path.empty())
+                m_index.entityPaths.emplace(e->id, e->path);
+        }
+        std::vector<std::vector<int>> segment_entities(rec.segments.size());
+        for (size_t si = 0; si < rec.segments.size(); ++si) {
+            for (std::shared_ptr<Transform>& e : rec.segments[si].segment->entities)
+                segment_entities[si].push_back(e->id);
+        }
+        m_index.segmentEntities.emplace_back(std::move(segment_entities));
+        m_sceneBounds.emplace_back(rec.time, std::move(rec.bounds));
+    }
+
+    // write
     {
-        std::unique_lock<std::mutex> l(m_mutex);
-        if (!m_queue.empty() && !IsWriting()) {
-            m_task = std::async(std::launch::async, body);
+        uint64_t total_buffer_size = 0;
+        RawVector<uint64_t> buffer_sizes;
+        for (std::vector<SceneSegment>::value_type& seg : rec.segments) {
+            if (seg.task.valid())
+                seg.task.wait();
+            buffer_sizes.push_back(seg.encodedBuf.size());
+            total_buffer_size += seg.encodedBuf.size();
         }
+
+        msProfileScope("SceneCacheOutputFile: [%d] write (%u byte)", rec.index, (uint32_t)total_buffer_size);
+
+        CacheFileSceneHeader header;
+        header.bufferCount = static_cast<uint32_t>(buffer_sizes.size());
+        header.time = rec.time;
+        m_stream->write(reinterpret_cast<char*>(&header), sizeof(header));
+        m_stream->write((char*)buffer_sizes.cdata(), buffer_sizes.size_in_byte());
+        for (std::vector<SceneSegment>::value_type& seg : rec.segments)
+            m_stream->write(seg.encodedBuf.cdata(), seg.encodedBuf.size());
     }
 }
 
@@ -325,6 +481,12 @@ void SceneCacheOutputFile::Init(const StreamPtr ost, const SceneCacheOutputSetti
     CacheFileHeader header;
     header.exportSettings = m_outputSettings.exportSettings;
     m_stream->write(reinterpret_cast<char*>(&header), sizeof(header));
+
+    // AddScene() keeps at most maxQueueSize scenes in flight, each of them is one optimize job and its segment jobs.
+    // with that much room submit() never blocks, which matters as jobs submit jobs.
+    const int max_jobs = std::max(m_outputSettings.maxQueueSize, 1) * (std::max(m_outputSettings.maxSceneSegments, 1) + 1);
+    m_workers = std::make_unique<WorkerPool>(static_cast<int>(std::thread::hardware_concurrency()), max_jobs);
+    m_writer = std::thread([this]() { WriterMain(); });
 }
 
 
@@ -3,36 +3,49 @@
 #include "MeshSync/SceneGraph/msScene.h" 
 #include "MeshSync/SceneCache/msSceneCacheOutputSettings.h"
 
+#include "MeshSync/SceneCache/msCacheFileHeader.h" //CacheFileEntityBounds
+#include "MeshSync/msWorkerPool.h"
+
 #include "SceneCache/BufferEncoder.h"
+#include "SceneCache/CacheFileSections.h" //CacheFileIndex
 
 msDeclClassPtr(SceneCacheOutputFile)
 
 namespace ms {
-    
+
+// scenes flow through a pipeline: optimize -> serialize & encode segments -> write.
+// the first two stages run on a persistent worker pool, each scene and segment as its own job.
+// a writer thread writes scenes strictly in the order they were added.
 class SceneCacheOutputFile
 {
 public:
     using StreamPtr = std::shared_ptr<std::ostream>;
 
     SceneCacheOutputFile(const char *path, const SceneCacheOutputSettings& oscs);
+    SceneCacheOutputFile(StreamPtr stream, const SceneCacheOutputSettings& oscs);
 
     ~SceneCacheOutputFile() ;
     bool IsValid() const ;
 
-    void AddScene(ScenePtr scene, float time) ;
+    void AddScene(ScenePtr scene, float time) ; // blocks while the queue is full
+    bool TryAddScene(ScenePtr scene, float time); // returns false instead of blocking
+    bool CanAddScene() const;
 
     void Flush() ;
+    bool Close();
     bool IsWriting() const;
     int GetSceneCountWritten() const ;
     int GetSceneCountInQueue() const ;
 
 protected:
-    void DoWrite();
+    void WriterMain();
 
 private:
     void Init(StreamPtr ost, const SceneCacheOutputSettings& oscs);
 
     static StreamPtr CreateStream(const char *path);
+    static void GatherBounds(Scene& scene, std::vector<CacheFileEntityBounds>& dst);
+    void WriteBounds();
 
     struct SceneSegment
     {
@@ -46,12 +59,19 @@ private:
     {
         int index = 0;
         float time = 0.0f;
+        uint64_t size = 0; // serialized size. counted only when maxQueueBytes is set
         ScenePtr scene;
         std::vector<SceneSegment> segments;
+        std::vector<CacheFileEntityBounds> bounds; // frame range is not set yet
         std::future<void> task;
     };
     using SceneRecordPtr = std::shared_ptr<SceneRecord>;
 
+    bool IsQueueFull() const; // m_mutex must be locked
+    void Enqueue(ScenePtr scene, float time);
+    void OptimizeScene(SceneRecord& rec);
+    void WriteScene(SceneRecord& rec);
+
     struct EntityRecord
     {
         EntityType type = EntityType::Unknown;
@@ -63,16 +83,23 @@ private:
     StreamPtr m_stream = nullptr;
     SceneCacheOutputSettings m_outputSettings;
 
-    std::mutex m_mutex;
-    std::list<SceneRecordPtr> m_queue;
-    std::future<void> m_task;
-
-    ScenePtr m_baseScene;
-    int m_sceneCountQueued = 0;
-    int m_sceneCountWritten = 0;
-    int m_sceneCountInQueue = 0;
+    std::unique_ptr<WorkerPool> m_workers;
+    std::thread m_writer;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condQueued;  // the writer waits for scenes
+    std::condition_variable m_condWritten; // AddScene() and Flush() wait for the pipeline
+    std::deque<SceneRecordPtr> m_queue;    // in the order added
+    bool m_stopping = false;
+    uint64_t m_queuedBytes = 0;
+
+    ScenePtr m_baseScene; // guarded by m_mutex until set
+    std::atomic<int> m_sceneCountQueued{ 0 };
+    std::atomic<int> m_sceneCountWritten{ 0 };
     std::vector<EntityRecord> m_entityRecords;
 
+    CacheFileIndex m_index;
+    std::vector<std::pair<float, std::vector<CacheFileEntityBounds>>> m_sceneBounds; // time and bounds of each scene
+
     BufferEncoderPtr m_encoder;
 };
 
@@ -22,6 +22,14 @@ bool SceneCacheWriter::Open(const char *path, const SceneCacheOutputSettings& os
     return m_scOutputFile != nullptr;
 }
 
+bool SceneCacheWriter::Open(std::shared_ptr<std::ostream> stream, const SceneCacheOutputSettings& oscs)
+{
+    m_scOutputFile = std::make_shared<SceneCacheOutputFile>(stream, oscs);
+    if (!m_scOutputFile->IsValid())
+        m_scOutputFile.reset();
+    return m_scOutputFile != nullptr;
+}
+
 void SceneCacheWriter::Close()
 {
     if (IsValid()) {
@@ -57,6 +65,15 @@ void SceneCacheWriter::kick()
     Write();
 }
 
+bool SceneCacheWriter::tryKick()
+{
+    if (!IsValid() || !m_scOutputFile->CanAddScene())
+        return false;
+
+    Write();
+    return true;
+}
+
 void SceneCacheWriter::Write()
 {
     if (on_prepare)
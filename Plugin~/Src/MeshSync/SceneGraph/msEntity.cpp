@@ -123,13 +123,22 @@ bool Entity::lerp(const Entity& s1, const Entity& s2, float /*t*/)
     return true;
 }
 
+void Entity::swapLerpBuffers(Entity& /*v*/)
+{
+}
+
 void Entity::updateBounds()
 {
 }
 
-bool Entity::genVelocity(const Entity& prev)
+bool Entity::getBounds(Bounds& /*dst*/) const
+{
+    return false;
+}
+
+bool Entity::genVelocity(const Entity& neighbor, float interval)
 {
-    if (cache_flags.constant || getType() != prev.getType())
+    if (cache_flags.constant || getType() != neighbor.getType() || interval == 0.0f)
         return false;
     return true;
 }
@@ -142,6 +151,7 @@ void Entity::clear()
 
     cache_flags.constant = 0;
     cache_flags.constant_topology = 0;
+    cow_buffers.clear();
 }
 
 uint64_t Entity::hash() const
@@ -171,6 +181,10 @@ EntityPtr Entity::clone(bool /*detach*/)
     return ret;
 }
 
+void Entity::shareBuffers(const Entity& /*src*/, const std::shared_ptr<const void>& /*owner*/)
+{
+}
+
 Identifier Entity::getIdentifier() const
 {
     return Identifier{ path, host_id };
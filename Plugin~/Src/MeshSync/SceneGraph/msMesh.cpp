@@ -442,6 +442,37 @@ bool Mesh::lerp(const Entity& e1_, const Entity& e2_, float t)
     return true;
 }
 
+// velocities that are already there (from the file) are kept
+bool Mesh::genVelocity(const Entity& neighbor_, float interval)
+{
+    if (!super::genVelocity(neighbor_, interval) || !velocities.empty())
+        return false;
+    const Mesh& neighbor = static_cast<const Mesh&>(neighbor_);
+
+    // vertices have to correspond one to one. equal sizes alone don't tell that, the topology has to match too.
+    if (points.empty() || points.size() != neighbor.points.size())
+        return false;
+    if (!cache_flags.constant_topology) {
+        auto same = [](const auto& a, const auto& b) {
+            return a.size() == b.size() && (a.empty() || a.cdata() == b.cdata() || memcmp(a.cdata(), b.cdata(), a.size_in_byte()) == 0);
+        };
+        if (!same(counts, neighbor.counts) || !same(indices, neighbor.indices))
+            return false;
+    }
+    velocities.resize_discard(points.size());
+    GenerateVelocities(velocities.data(), neighbor.points.cdata(), points.cdata(), points.size(), 1.0f / interval);
+    md_flags.Set(MESH_DATA_FLAG_HAS_VELOCITIES, true);
+    return true;
+}
+
+void Mesh::swapLerpBuffers(Entity& v_)
+{
+    Mesh& v = dynamic_cast<Mesh&>(v_);
+#define Body(A) A.swap(v.A);
+    EachVertexAttribute(Body);
+#undef Body
+}
+
 void Mesh::updateBounds() {
     mu::float3 bmin, bmax;
     bmin = bmax = mu::float3::zero();
@@ -450,6 +481,11 @@ void Mesh::updateBounds() {
     bounds.extents = abs(bmax - bmin) * 0.5f;
 }
 
+bool Mesh::getBounds(Bounds& dst) const {
+    dst = bounds;
+    return true;
+}
+
 
 void Mesh::clear()
 {
@@ -537,10 +573,37 @@ EntityPtr Mesh::clone(bool detach_)
     std::shared_ptr<Mesh> ret = create();
     *ret = *this;
     if (detach_)
-        ret->detach();
+        ret->shareBuffers(*this, weak_from_this().lock());
     return ret;
 }
 
+// bones and blend shapes are cloned so that modifying them doesn't reach back to src.
+void Mesh::shareBuffers(const Entity& src_, const std::shared_ptr<const void>& owner)
+{
+    auto& src = static_cast<const Mesh&>(src_);
+    auto holder = std::make_shared<SharedBuffers>();
+#define Body(A) holder->share(A, src.A, cow_buffers, owner);
+    EachGeometryAttribute(Body);
+    Body(submeshes) Body(weights4) Body(bone_counts) Body(bone_offsets) Body(weights1)
+#undef Body
+    for (size_t bi = 0; bi < bones.size(); ++bi) {
+        bones[bi] = bones[bi]->clone();
+        holder->share(bones[bi]->weights, src.bones[bi]->weights, cow_buffers, owner);
+    }
+    for (size_t si = 0; si < blendshapes.size(); ++si) {
+        blendshapes[si] = blendshapes[si]->clone();
+        auto& frames = blendshapes[si]->frames;
+        auto& src_frames = src.blendshapes[si]->frames;
+        for (size_t fi = 0; fi < frames.size(); ++fi) {
+            holder->share(frames[fi]->points, src_frames[fi]->points, cow_buffers, owner);
+            holder->share(frames[fi]->normals, src_frames[fi]->normals, cow_buffers, owner);
+            holder->share(frames[fi]->tangents, src_frames[fi]->tangents, cow_buffers, owner);
+        }
+    }
+    if (!holder->empty())
+        cow_buffers.push_back(holder);
+}
+
 #undef EachTopologyAttribute
 #undef EachVertexAttribute
 #undef EachGeometryAttribute
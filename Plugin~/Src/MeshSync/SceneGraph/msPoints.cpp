@@ -161,6 +161,55 @@ bool Points::lerp(const Entity& e1_, const Entity& e2_, float t) {
     return true;
 }
 
+// velocities that are already there (from the file) are kept
+bool Points::genVelocity(const Entity& neighbor_, float interval)
+{
+    if (!super::genVelocity(neighbor_, interval) || !velocities.empty() || points.empty())
+        return false;
+    const Points& neighbor = static_cast<const Points&>(neighbor_);
+    const float inv_interval = 1.0f / interval;
+
+    const size_t n = points.size();
+    if (ids == neighbor.ids) {
+        if (neighbor.points.size() != n)
+            return false;
+        velocities.resize_discard(n);
+        GenerateVelocities(velocities.data(), neighbor.points.cdata(), points.cdata(), n, inv_interval);
+    }
+    else {
+        if (ids.size() != n || neighbor.ids.size() != neighbor.points.size())
+            return false;
+
+        // points come and go. match them by id. the ones that just appeared don't move.
+        std::unordered_map<int, int> neighbor_index;
+        neighbor_index.reserve(neighbor.ids.size());
+        for (int i = 0; i < (int)neighbor.ids.size(); ++i)
+            neighbor_index[neighbor.ids.cdata()[i]] = i;
+
+        velocities.resize_discard(n);
+        mu::float3 *dst = velocities.data();
+        const mu::float3 *cur = points.cdata();
+        const mu::float3 *prev = neighbor.points.cdata();
+        const int *cur_ids = ids.cdata();
+        for (size_t i = 0; i < n; ++i) {
+            auto it = neighbor_index.find(cur_ids[i]);
+            dst[i] = it != neighbor_index.end() ? (cur[i] - prev[it->second]) * inv_interval : mu::float3::zero();
+        }
+    }
+    pd_flags.Set(POINTS_DATA_FLAG_HAS_VELOCITIES, true);
+    return true;
+}
+
+void Points::swapLerpBuffers(Entity& v_)
+{
+    Points& v = dynamic_cast<Points&>(v_);
+    points.swap(v.points);
+    rotations.swap(v.rotations);
+    scales.swap(v.scales);
+    colors.swap(v.colors);
+    velocities.swap(v.velocities);
+}
+
 void Points::updateBounds() {
     mu::float3 bmin, bmax;
     mu::MinMax(points.cdata(), points.size(), bmin, bmax);
@@ -168,6 +217,11 @@ void Points::updateBounds() {
     bounds.extents = abs(bmax - bmin);
 }
 
+bool Points::getBounds(Bounds& dst) const {
+    dst = bounds;
+    return true;
+}
+
 void Points::clear() {
     pd_flags = {};
     EachArray(msClear);
@@ -197,9 +251,20 @@ EntityPtr Points::clone(bool detach_) {
     std::shared_ptr<Points> ret = create();
     *ret = *this;
     if (detach_)
-        ret->detach();
+        ret->shareBuffers(*this, weak_from_this().lock());
     return ret;
 }
+
+// see Mesh::shareBuffers()
+void Points::shareBuffers(const Entity& src_, const std::shared_ptr<const void>& owner) {
+    auto& src = static_cast<const Points&>(src_);
+    auto holder = std::make_shared<SharedBuffers>();
+#define Body(A) holder->share(A, src.A, cow_buffers, owner);
+    EachArray(Body);
+#undef Body
+    if (!holder->empty())
+        cow_buffers.push_back(holder);
+}
 #undef EachArrays
 #undef EachMember
 
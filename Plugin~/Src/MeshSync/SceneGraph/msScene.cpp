@@ -52,9 +52,33 @@ ScenePtr Scene::create(std::istream& is)
 ScenePtr Scene::clone(bool detach)
 {
     auto ret = create();
-    *ret = *this;
-    mu::parallel_for(0, (int)entities.size(), 10, [this, detach, &ret](int ei) {
-        ret->entities[ei] = std::static_pointer_cast<Transform>(entities[ei]->clone(detach));
+    // scene_buffers are left out. entities of the clone refer to ours, copying them would be wasted.
+#define Body(A) ret->A = A;
+    EachMember(Body);
+#undef Body
+    ret->data_flags = data_flags;
+    ret->data_sources = data_sources;
+    ret->cow_buffers = cow_buffers;
+    ret->profile_data = profile_data;
+
+    SharedBuffersPtr holder;
+    if (detach && !scene_buffers.empty()) {
+        if (ScenePtr owner = weak_from_this().lock()) {
+            holder = std::make_shared<SharedBuffers>();
+            for (auto& buf : scene_buffers)
+                holder->hold(owner, buf.cdata(), buf.size());
+            ret->cow_buffers.push_back(holder);
+        }
+    }
+    mu::parallel_for(0, (int)entities.size(), 10, [this, detach, &holder, &ret](int ei) {
+        const TransformPtr& src = entities[ei];
+        EntityPtr dst = src->clone();
+        if (detach) {
+            if (holder)
+                dst->cow_buffers.push_back(holder);
+            dst->shareBuffers(*src, src);
+        }
+        ret->entities[ei] = std::static_pointer_cast<Transform>(dst);
     });
     return ret;
 }
@@ -105,6 +129,7 @@ void Scene::concat(Scene& src, bool move_buffer)
     if (move_buffer) {
         for (auto& buf : src.scene_buffers)
             scene_buffers.push_back(std::move(buf));
+        cow_buffers.insert(cow_buffers.end(), src.cow_buffers.begin(), src.cow_buffers.end());
         src.clear();
     }
 }
@@ -164,6 +189,8 @@ void Scene::diff(const Scene& s1, const Scene& s2)
     }
 }
 
+// if this scene holds the result of a previous lerp(), vertex buffers of entities that only this scene refers to
+// are recycled. when the topology matches, lerping into them doesn't allocate.
 void Scene::lerp(const Scene& s1, const Scene& s2, float t)
 {
     settings = s1.settings;
@@ -175,19 +202,30 @@ void Scene::lerp(const Scene& s1, const Scene& s2, float t)
         mu::parallel_for(0, (int)entity_count, 10, [this, &s1, &s2, t](int i) {
             auto& e1 = s1.entities[i];
             auto& e2 = s2.entities[i];
+            auto& dst = entities[i];
             if (e1->id == e2->id) {
                 if (e1->isGeometry() && !e1->cache_flags.constant_topology) {
                     // topology is not constant. no way to lerp.
-                    entities[i] = e1;
+                    dst = e1;
                 }
                 else {
                     auto e3 = e1->clone();
-                    e3->lerp(*e1, *e2, t);
-                    entities[i] = std::static_pointer_cast<Transform>(e3);
+                    const bool recycle = dst && dst.use_count() == 1 && dst->id == e1->id && dst->getType() == e1->getType();
+                    if (recycle)
+                        e3->swapLerpBuffers(*dst);
+                    if (!e3->lerp(*e1, *e2, t) && recycle)
+                        e3->swapLerpBuffers(*dst); // nothing was written. take back the buffers shared with e1.
+                    dst = std::static_pointer_cast<Transform>(e3);
                 }
             }
+            else {
+                dst.reset();
+            }
         });
     }
+    else {
+        entities.clear();
+    }
 }
 
 void Scene::clear()
@@ -203,9 +241,24 @@ void Scene::clear()
 
     scene_buffers.clear();
     data_sources.clear();
+    cow_buffers.clear();
     profile_data = {};
 }
 
+// interval: time of this scene - time of neighbor
+void Scene::genVelocities(const Scene& neighbor, float interval)
+{
+    mu::parallel_for(0, (int)entities.size(), 10, [this, &neighbor, interval](int i) {
+        TransformPtr& e = entities[i];
+        if (!e->isGeometry())
+            return;
+        auto it = std::lower_bound(neighbor.entities.begin(), neighbor.entities.end(), e->id,
+            [](const TransformPtr& a, int id) { return a->id < id; });
+        if (it != neighbor.entities.end() && (*it)->id == e->id)
+            e->genVelocity(**it, interval);
+    });
+}
+
 uint64_t Scene::hash() const
 {
     uint64_t ret = 0;
@@ -328,7 +381,9 @@ void Scene::updateEntities(
             mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_SPLIT, true);
             mesh.refine_settings.split_unit = cv.mesh_split_unit;
             mesh.refine_settings.max_bone_influence = cv.mesh_max_bone_influence;
-            mesh.refine();
+            // unchanged meshes carry no geometry. the receiver keeps what it already has.
+            if (!mesh.md_flags.Get(MESH_DATA_FLAG_UNCHANGED))
+                mesh.refine();
         }
 
         if (!converters.empty()) {
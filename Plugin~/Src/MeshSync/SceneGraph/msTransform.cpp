@@ -160,6 +160,8 @@ uint64_t Transform::checksumTrans() const {
     ret += csum(layer);
     ret += csum(index);
     ret += csum(reference);
+    for (auto& prop : user_properties)
+        ret += csum(prop.name) + prop.checksum();
     return ret;
 }
 
@@ -33,4 +33,12 @@ bool NetworkUtils::IsInLocalNetwork(const std::string& hostAndPort) {
 
 }
 
+bool NetworkUtils::IsLocalHost(const std::string& host) {
+    static const Poco::RegularExpression regex(
+        "(^localhost$)"
+        "|(^127\\.[0-9]{1,3}\\.[0-9]{1,3}\\.[0-9]{1,3}$)"
+        "|(^::1$)|(^\\[::1\\]$)");
+    return regex.match(host);
+}
+
 } // namespace ms
@@ -0,0 +1,327 @@
+#include "pch.h"
+#include "MeshSync/msChannel.h"
+
+namespace ms {
+
+using namespace Poco::Net;
+
+// on the wire the header is 24 bytes, all little-endian whatever the host is:
+// magic (u32), stream id (u32), message type (u32), reserved (u32), payload size (u64).
+struct ChannelFrameHeader
+{
+    static const size_t Size = 24;
+
+    uint32_t magic = 0;
+    uint32_t stream_id = 0;
+    uint32_t type = 0;
+    uint32_t reserved = 0;
+    uint64_t size = 0;
+
+    void store(uint8_t *dst) const
+    {
+        StoreLE(dst + 0, magic, 4);
+        StoreLE(dst + 4, stream_id, 4);
+        StoreLE(dst + 8, type, 4);
+        StoreLE(dst + 12, reserved, 4);
+        StoreLE(dst + 16, size, 8);
+    }
+
+    void load(const uint8_t *src)
+    {
+        magic = static_cast<uint32_t>(LoadLE(src + 0, 4));
+        stream_id = static_cast<uint32_t>(LoadLE(src + 4, 4));
+        type = static_cast<uint32_t>(LoadLE(src + 8, 4));
+        reserved = static_cast<uint32_t>(LoadLE(src + 12, 4));
+        size = LoadLE(src + 16, 8);
+    }
+
+private:
+    static void StoreLE(uint8_t *dst, uint64_t v, int n)
+    {
+        for (int i = 0; i < n; ++i)
+            dst[i] = static_cast<uint8_t>(v >> (i * 8));
+    }
+
+    static uint64_t LoadLE(const uint8_t *src, int n)
+    {
+        uint64_t ret = 0;
+        for (int i = 0; i < n; ++i)
+            ret |= static_cast<uint64_t>(src[i]) << (i * 8);
+        return ret;
+    }
+};
+
+Channel::Channel(const StreamSocket& socket)
+    : m_socket(new StreamSocket(socket))
+{
+    m_socket->setNoDelay(true);
+}
+
+Channel::~Channel()
+{
+    close();
+}
+
+bool Channel::read(ChannelFrame& dst)
+{
+    uint8_t buf[ChannelFrameHeader::Size];
+    if (!receiveAll(buf, sizeof(buf)))
+        return false;
+    ChannelFrameHeader header;
+    header.load(buf);
+    if (header.magic != ChannelFrame::Magic || header.size > m_max_payload_size) {
+        // out of sync. nothing after this can be trusted.
+        close();
+        return false;
+    }
+
+    dst.stream_id = header.stream_id;
+    dst.type = static_cast<Message::Type>(header.type);
+    dst.payload.resize_discard(static_cast<size_t>(header.size));
+    return receiveAll(dst.payload.data(), dst.payload.size());
+}
+
+bool Channel::write(uint32_t stream_id, Message::Type type, const void *data, size_t size)
+{
+    ChannelFrameHeader header;
+    header.magic = ChannelFrame::Magic;
+    header.stream_id = stream_id;
+    header.type = static_cast<uint32_t>(type);
+    header.size = size;
+    uint8_t buf[ChannelFrameHeader::Size];
+    header.store(buf);
+
+    std::unique_lock<std::mutex> lock(m_write_mutex);
+    return sendAll(buf, sizeof(buf)) && sendAll(data, size);
+}
+
+void Channel::close()
+{
+    if (m_closed.exchange(true))
+        return;
+    try {
+        // wakes up the thread blocked in read()
+        m_socket->shutdown();
+    }
+    catch (...) {
+    }
+}
+
+bool Channel::isClosed() const
+{
+    return m_closed;
+}
+
+uint64_t Channel::getBytesSent() const
+{
+    return m_bytes_sent;
+}
+
+uint64_t Channel::getBytesReceived() const
+{
+    return m_bytes_received;
+}
+
+void Channel::setMaxPayloadSize(uint64_t v)
+{
+    m_max_payload_size = v;
+}
+
+bool Channel::sendAll(const void *data_, size_t size)
+{
+    auto *data = static_cast<const char*>(data_);
+    try {
+        while (size > 0 && !m_closed) {
+            int n = m_socket->sendBytes(data, static_cast<int>(std::min<size_t>(size, INT_MAX)));
+            if (n <= 0)
+                break;
+            m_bytes_sent += n;
+            data += n;
+            size -= n;
+        }
+    }
+    catch (...) {
+        close();
+    }
+    return size == 0;
+}
+
+bool Channel::receiveAll(void *data_, size_t size)
+{
+    auto *data = static_cast<char*>(data_);
+    try {
+        while (size > 0 && !m_closed) {
+            int n = m_socket->receiveBytes(data, static_cast<int>(std::min<size_t>(size, INT_MAX)));
+            if (n <= 0) {
+                // peer closed the connection
+                close();
+                break;
+            }
+            m_bytes_received += n;
+            data += n;
+            size -= n;
+        }
+    }
+    catch (...) {
+        close();
+    }
+    return size == 0;
+}
+
+
+ChannelClient::ChannelClient(const ClientSettings& settings)
+    : m_settings(settings)
+{
+}
+
+ChannelClient::~ChannelClient()
+{
+    disconnect();
+}
+
+bool ChannelClient::connect()
+{
+    std::unique_lock<std::mutex> connect_lock(m_connect_mutex);
+    if (isConnected())
+        return true;
+    disconnectImpl();
+
+    ChannelPtr channel;
+    try {
+        StreamSocket socket;
+        socket.connect(SocketAddress(m_settings.server, m_settings.channel_port), m_settings.timeout_ms * 1000);
+        channel = std::make_shared<Channel>(socket);
+    }
+    catch (...) {
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_channel = channel;
+    }
+    m_reader = std::thread([this, channel]() { readerMain(channel); });
+    return true;
+}
+
+void ChannelClient::disconnect()
+{
+    std::unique_lock<std::mutex> connect_lock(m_connect_mutex);
+    disconnectImpl();
+}
+
+// senders still holding the channel fail their write or get woken up by readerMain() when it exits
+void ChannelClient::disconnectImpl()
+{
+    ChannelPtr channel;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        channel.swap(m_channel);
+        m_live_edit_stream = 0;
+    }
+    if (channel)
+        channel->close();
+    if (m_reader.joinable())
+        m_reader.join();
+}
+
+ChannelPtr ChannelClient::getChannel() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_channel && !m_channel->isClosed() ? m_channel : nullptr;
+}
+
+bool ChannelClient::isConnected() const
+{
+    return getChannel() != nullptr;
+}
+
+ResponseMessagePtr ChannelClient::send(const Message& mes)
+{
+    uint32_t stream_id = ++m_stream_seed;
+    ChannelPtr channel;
+    std::future<ChannelFrame> reply;
+    {
+        // registered under the same lock readerMain() takes to fail everything pending,
+        // so a reply can't be missed between the check and the registration
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_channel || m_channel->isClosed())
+            return nullptr;
+        channel = m_channel;
+        reply = m_pending[stream_id].get_future();
+    }
+
+    auto discard = [this, stream_id]() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_pending.erase(stream_id);
+    };
+    if (!channel->write(stream_id, mes.getType(), mes)) {
+        discard();
+        return nullptr;
+    }
+    if (reply.wait_for(std::chrono::milliseconds(m_settings.timeout_ms)) != std::future_status::ready) {
+        discard();
+        return nullptr;
+    }
+
+    ChannelFrame frame = reply.get();
+    if (frame.type != Message::Type::Response)
+        return nullptr;
+    try {
+        auto ret = std::make_shared<ResponseMessage>();
+        mu::MemoryStream ms(std::move(frame.payload));
+        ret->deserialize(ms);
+        return ret;
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+bool ChannelClient::subscribeLiveEdit(const ServerLiveEditRequest& mes)
+{
+    ChannelPtr channel = getChannel();
+    if (!channel)
+        return false;
+
+    uint32_t stream_id = ++m_stream_seed;
+    m_live_edit_stream = stream_id;
+    return channel->write(stream_id, mes.getType(), mes);
+}
+
+void ChannelClient::readerMain(ChannelPtr channel)
+{
+    ChannelFrame frame;
+    while (channel->read(frame)) {
+        if (frame.stream_id == m_live_edit_stream) {
+            if (frame.type != Message::Type::RequestServerLiveEdit || !on_live_edit)
+                continue;
+            try {
+                ServerLiveEditResponse res;
+                mu::MemoryStream ms(std::move(frame.payload));
+                res.deserialize(ms);
+                // entities may refer to the frame buffer. make them own their data.
+                for (auto& e : res.entities)
+                    e->detach();
+                on_live_edit(res);
+            }
+            catch (...) {
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_pending.find(frame.stream_id);
+        if (it != m_pending.end()) {
+            it->second.set_value(std::move(frame));
+            m_pending.erase(it);
+        }
+    }
+
+    // wake up everyone still waiting for a reply
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (auto& kvp : m_pending)
+        kvp.second.set_value(ChannelFrame());
+    m_pending.clear();
+}
+
+} // namespace ms
@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "MeshSync/msChunkedTransfer.h"
+
+namespace ms {
+
+void ChunkAssembler::setTimeout(mu::nanosec v)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_timeout = v;
+}
+
+mu::nanosec ChunkAssembler::getTimeout() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_timeout;
+}
+
+void ChunkAssembler::setMaxTotalBytes(uint64_t v)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_max_total_bytes = v;
+}
+
+uint64_t ChunkAssembler::getMaxTotalBytes() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_max_total_bytes;
+}
+
+void ChunkAssembler::erase(Transfers::iterator it)
+{
+    m_total_bytes -= it->second.data.size();
+    m_transfers.erase(it);
+}
+
+// drop the transfer that was continued least recently, except keep. return false if there is none.
+bool ChunkAssembler::evictStalest(const std::string& keep)
+{
+    auto stalest = m_transfers.end();
+    for (auto it = m_transfers.begin(); it != m_transfers.end(); ++it) {
+        if (it->first != keep && (stalest == m_transfers.end() || it->second.last_update < stalest->second.last_update))
+            stalest = it;
+    }
+    if (stalest == m_transfers.end())
+        return false;
+    erase(stalest);
+    return true;
+}
+
+ChunkAssembler::Result ChunkAssembler::append(const std::string& id, uint64_t total_size, uint64_t offset,
+    const char *data, size_t size, RawVector<char>& body, uint64_t& received)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const mu::nanosec now = mu::Now();
+    for (auto it = m_transfers.begin(); it != m_transfers.end(); ) {
+        if (now - it->second.last_update > m_timeout) {
+            auto stale = it++;
+            erase(stale);
+        }
+        else
+            ++it;
+    }
+
+    if (std::find(m_completed.begin(), m_completed.end(), id) != m_completed.end()) {
+        // the response to the last chunk was lost and the sender resent it
+        received = total_size;
+        return Result::Accepted;
+    }
+
+    if (total_size == 0 || offset > total_size || size > total_size - offset)
+        throw std::runtime_error("SetMessage: chunk out of range");
+
+    auto it = m_transfers.find(id);
+    if (it == m_transfers.end()) {
+        if (total_size > m_max_total_bytes)
+            throw std::runtime_error("SetMessage: chunked message exceeds the memory limit for transfers");
+        while ((int)m_transfers.size() >= MaxTransfers)
+            evictStalest(id);
+        it = m_transfers.emplace(id, Transfer()).first;
+        it->second.total_size = total_size;
+    }
+    auto& transfer = it->second;
+    if (transfer.total_size != total_size) {
+        erase(it);
+        throw std::runtime_error("SetMessage: chunk out of range");
+    }
+    transfer.last_update = now;
+
+    received = transfer.data.size();
+    if (offset > received)
+        return Result::OutOfOrder;
+    if (offset + size > received) {
+        // a resent chunk may overlap what was already received
+        const size_t skip = static_cast<size_t>(received - offset);
+        while (m_total_bytes + (size - skip) > m_max_total_bytes && evictStalest(id)) {}
+        if (m_total_bytes + (size - skip) > m_max_total_bytes) {
+            erase(it);
+            throw std::runtime_error("SetMessage: chunked message exceeds the memory limit for transfers");
+        }
+        transfer.data.push_back(data + skip, size - skip);
+        m_total_bytes += size - skip;
+        received = transfer.data.size();
+    }
+    if (received < total_size)
+        return Result::Accepted;
+
+    body.swap(transfer.data);
+    m_total_bytes -= body.size();
+    m_transfers.erase(it);
+    m_completed.push_back(id);
+    if ((int)m_completed.size() > MaxTransfers)
+        m_completed.pop_front();
+    return Result::Completed;
+}
+
+void ChunkAssembler::clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_transfers.clear();
+    m_completed.clear();
+    m_total_bytes = 0;
+}
+
+int ChunkAssembler::getNumTransfers() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return (int)m_transfers.size();
+}
+
+uint64_t ChunkAssembler::getTotalBytes() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_total_bytes;
+}
+
+
+namespace {
+
+// uploads the serialized message one chunk at a time, starting at what the receiver already has.
+// fails with needsRewind() when the receiver lost bytes that are no longer in the buffer.
+class ChunkUploadStreamBuf : public std::streambuf
+{
+public:
+    ChunkUploadStreamBuf(size_t chunk_size, uint64_t received, const ChunkUploader::Upload& upload)
+        : m_upload(upload)
+        , m_received(received)
+    {
+        m_buffer.resize_discard(chunk_size);
+        this->setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+    int overflow(int c) override
+    {
+        if (!flushChunk())
+            return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *this->pptr() = (char)c;
+            this->pbump(1);
+        }
+        return c;
+    }
+
+    int sync() override
+    {
+        return flushChunk() ? 0 : -1;
+    }
+
+    uint64_t getReceived() const { return m_received; }
+    uint64_t getNumBytesSent() const { return m_num_bytes_sent; }
+    bool needsRewind() const { return m_needs_rewind; }
+
+private:
+    bool flushChunk()
+    {
+        const size_t size = size_t(this->pptr() - this->pbase());
+        if (size == 0)
+            return true;
+
+        const uint64_t end = m_offset + size;
+        int attempts = 0;
+        while (m_received < end) {
+            if (m_received < m_offset) {
+                m_needs_rewind = true;
+                return false;
+            }
+            if (attempts++ == ChunkUploader::MaxAttempts)
+                return false;
+
+            const size_t skip = size_t(m_received - m_offset);
+            const int64_t ret = m_upload(m_buffer.cdata() + skip, size - skip, m_received);
+            m_num_bytes_sent += size - skip;
+            if (ret == ChunkUploader::Rejected)
+                return false;
+            if (ret >= 0) {
+                // NoAnswer resends the same range. the receiver ignores the part it already has.
+                if ((uint64_t)ret > m_received)
+                    attempts = 0;
+                m_received = (uint64_t)ret;
+            }
+        }
+        m_offset = end;
+        this->setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        return true;
+    }
+
+    const ChunkUploader::Upload& m_upload;
+    RawVector<char> m_buffer;
+    uint64_t m_offset = 0;
+    uint64_t m_received = 0;
+    uint64_t m_num_bytes_sent = 0;
+    bool m_needs_rewind = false;
+};
+
+} // namespace
+
+ChunkUploader::ChunkUploader(size_t chunk_size, const Upload& upload)
+    : m_chunk_size(std::max<size_t>(chunk_size, 1))
+    , m_upload(upload)
+{
+}
+
+bool ChunkUploader::send(const Serialize& serialize, uint64_t total_size)
+{
+    m_num_passes = 0;
+    m_num_bytes_sent = 0;
+
+    uint64_t received = 0;
+    while (m_num_passes < MaxPasses) {
+        ++m_num_passes;
+        ChunkUploadStreamBuf buf(m_chunk_size, received, m_upload);
+        std::ostream os(&buf);
+        serialize(os);
+        os.flush();
+        m_num_bytes_sent += buf.getNumBytesSent();
+        if (os.good())
+            return buf.getReceived() >= total_size;
+        if (!buf.needsRewind())
+            return false;
+        // e.g. the receiver timed the transfer out. serialize again and skip what it still has.
+        received = buf.getReceived();
+    }
+    return false;
+}
+
+int ChunkUploader::getNumPasses() const { return m_num_passes; }
+uint64_t ChunkUploader::getNumBytesSent() const { return m_num_bytes_sent; }
+
+} // namespace ms
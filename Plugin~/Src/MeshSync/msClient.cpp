@@ -1,7 +1,13 @@
 #include "pch.h"
 #include "MeshSync/msClient.h"
+#include "MeshSync/msChannel.h"
+#include "MeshSync/msChunkedTransfer.h"
 #include "MeshSync/SceneGraph/msScene.h" //Scene
 #include "MeshSync/SceneGraph/msCurve.h"
+#include "MeshSync/SceneCache/msSceneCacheEncoderSettings.h"
+#include "MeshSync/Utility/msNetworkUtility.h" //IsLocalHost()
+
+#include "SceneCache/BufferEncoder.h"
 
 namespace ms {
 
@@ -12,6 +18,11 @@ HTTPClientSession* m_live_edit_session;
 
 Client::Client(const ClientSettings & settings)
     : m_settings(settings)
+    , m_counters(std::make_shared<ClientCounters>())
+{
+}
+
+Client::~Client()
 {
 }
 
@@ -20,6 +31,51 @@ const std::string& Client::getErrorMessage() const
     return m_error_message;
 }
 
+const ClientSettings& Client::getSettings() const
+{
+    return m_settings;
+}
+
+ClientStats Client::getStats() const
+{
+    return m_counters->getStats();
+}
+
+void Client::resetStats()
+{
+    m_counters->reset();
+}
+
+void Client::setCounters(ClientCountersPtr v)
+{
+    m_counters = v ? v : std::make_shared<ClientCounters>();
+}
+
+// the server advertises request encodings it can decode by Accept-Encoding in its responses (RFC 7694).
+// old servers don't send it, in that case messages are always sent uncompressed.
+// the server session id comes with every response too. it changes when the server restarts.
+// servers that don't send it leave InvalidID, so that nothing is assumed about their state.
+void Client::updateServerCapabilities(const HTTPResponse& response)
+{
+    server_session_id = std::stoi(response.get(SERVER_SESSION_ID, InvalidID_str));
+    const std::string& encodings = response.get("Accept-Encoding", "");
+    m_server_accepts_zstd = encodings.find(CONTENT_ENCODING_ZSTD) != std::string::npos;
+    const std::string& transports = response.get(TRANSPORTS, "");
+    m_server_accepts_shm = transports.find(TRANSPORT_SHARED_MEMORY) != std::string::npos;
+    m_server_accepts_chunks = transports.find(TRANSPORT_CHUNKS) != std::string::npos;
+}
+
+bool Client::shouldCompress(uint64_t size) const
+{
+    return m_settings.compression && m_server_accepts_zstd && size >= (uint64_t)m_settings.compression_threshold;
+}
+
+bool Client::shouldUseSharedMemory(uint64_t size) const
+{
+    return m_settings.shared_memory && m_server_accepts_shm && !m_shm_disabled && size >= (uint64_t)m_settings.shared_memory_threshold &&
+        NetworkUtils::IsLocalHost(m_settings.server);
+}
+
 bool Client::isServerAvailable(int timeout_ms)
 {
     try {
@@ -31,7 +87,7 @@ bool Client::isServerAvailable(int timeout_ms)
 
         HTTPResponse response;
         auto& rs = session.receiveResponse(response);
-        server_session_id = std::stoi(response.get(SERVER_SESSION_ID, InvalidID_str));
+        updateServerCapabilities(response);
         std::ostringstream ostr;
         StreamCopier::copyStream(rs, ostr);
         auto content = ostr.str();
@@ -97,47 +153,245 @@ ScenePtr Client::send(const GetMessage& mes)
     return ret;
 }
 
-bool Client::send(const SetMessage& mes)
+// unique among clients on this machine and (practically) among hosts
+static std::string GenerateUniqueName()
+{
+    static std::atomic_int s_count{ 0 };
+    std::random_device rd;
+    return "MeshSync-" + std::to_string(rd()) + "-" + std::to_string(++s_count);
+}
+
+// serialize directly into a mapped segment and send only its name and size.
+// the server copies the data out before it responds, so the segment can be reused right after.
+// Unavailable and Rejected mean the server hasn't imported the message and it can go through HTTP instead.
+// Unavailable also turns shared memory off for this client when either side can't use the segment.
+Client::SendResult Client::sendSharedMemory(const SetMessage& mes, uint64_t size)
 {
+    try {
+        if (!m_shm || m_shm_capacity < size) {
+            m_shm.reset();
+            m_shm_capacity = std::max<size_t>(static_cast<size_t>(size) * 3 / 2, m_settings.shared_memory_threshold);
+            m_shm_name = GenerateUniqueName();
+            m_shm.reset(new SharedMemory(m_shm_name, m_shm_capacity, SharedMemory::AM_WRITE));
+        }
+    }
+    catch (...) {
+        m_shm_disabled = true;
+        m_shm.reset();
+        return SendResult::Unavailable;
+    }
+
+    try {
+        mu::FixedMemoryStream os(m_shm->begin(), m_shm_capacity);
+        mes.serialize(os);
+        if (!os || os.size() != size)
+            return SendResult::Unavailable;
+    }
+    catch (...) {
+        return SendResult::Unavailable;
+    }
+
+    try {
+        HTTPClientSession session{ m_settings.server, m_settings.port };
+        session.setTimeout(m_settings.timeout_ms * 1000);
+
+        HTTPRequest request{ HTTPRequest::HTTP_POST, "set" };
+        request.set(SHARED_MEMORY_NAME, m_shm_name);
+        request.set(SHARED_MEMORY_SIZE, std::to_string(size));
+        request.setContentLength(0);
+        session.sendRequest(request);
+
+        HTTPResponse response;
+        auto& rs = session.receiveResponse(response);
+        updateServerCapabilities(response);
+        std::ostringstream ostr;
+        StreamCopier::copyStream(rs, ostr);
+        if (response.getStatus() == HTTPResponse::HTTP_OK) {
+            m_counters->countSharedMemory();
+            return SendResult::Sent;
+        }
+        if (response.has(SHARED_MEMORY_UNAVAILABLE)) {
+            m_shm_disabled = true;
+            m_shm.reset();
+            return SendResult::Unavailable;
+        }
+        // e.g. 503 while the server doesn't serve or 413. HTTP gets the same answer, but it's the server's to give
+        return SendResult::Rejected;
+    }
+    catch (...) {
+        // the server may have imported it before the connection broke
+        return SendResult::Failed;
+    }
+}
+
+bool Client::shouldSendChunked(uint64_t size) const
+{
+    return m_settings.chunk_size > 0 && m_server_accepts_chunks && size > (uint64_t)m_settings.chunk_size;
+}
+
+// send one byte range of a chunked transfer. return what the server has of it (see ChunkUploader::Upload).
+int64_t Client::sendChunk(const std::string& transfer_id, uint64_t total_size, const char *data, size_t size, uint64_t offset)
+{
+    RawVector<char> encoded;
+    if (shouldCompress(size)) {
+        SceneCacheEncoderSettings encoder_settings;
+        encoder_settings.zstd.compressionLevel = m_settings.compression_level;
+        RawVector<char> src;
+        src.assign(data, size);
+        BufferEncoder::CreateEncoder(SceneCacheEncoding::ZSTD, encoder_settings)->EncodeV(encoded, src);
+        if (encoded.size() >= size)
+            encoded.clear();
+    }
+
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
         session.setTimeout(m_settings.timeout_ms * 1000);
 
         HTTPRequest request{ HTTPRequest::HTTP_POST, "set" };
         request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
+        request.set(TRANSFER_ID, transfer_id);
+        request.set(TRANSFER_SIZE, std::to_string(total_size));
+        request.set(CHUNK_OFFSET, std::to_string(offset));
+        if (!encoded.empty()) {
+            request.set("Content-Encoding", CONTENT_ENCODING_ZSTD);
+            request.setContentLength(encoded.size());
+            auto& os = session.sendRequest(request);
+            os.write(encoded.cdata(), encoded.size());
+            os.flush();
+        }
+        else {
+            request.setContentLength(size);
+            auto& os = session.sendRequest(request);
+            os.write(data, size);
+            os.flush();
+        }
 
         HTTPResponse response;
         auto& rs = session.receiveResponse(response);
+        updateServerCapabilities(response);
         std::ostringstream ostr;
         StreamCopier::copyStream(rs, ostr);
-        return response.getStatus() == HTTPResponse::HTTP_OK;
+
+        const HTTPResponse::HTTPStatus status = response.getStatus();
+        if (status == HTTPResponse::HTTP_SERVICE_UNAVAILABLE)
+            return ChunkUploader::NoAnswer;
+        if ((status == HTTPResponse::HTTP_OK || status == HTTPResponse::HTTP_CONFLICT) && response.has(CHUNK_RECEIVED))
+            return static_cast<int64_t>(std::stoull(response.get(CHUNK_RECEIVED)));
+        m_error_message = ostr.str();
+        return ChunkUploader::Rejected;
     }
     catch (...) {
-        return false;
+        // the server may or may not have the chunk. resending it makes it answer where it is.
+        return ChunkUploader::NoAnswer;
     }
 }
 
-bool Client::send(const DeleteMessage& mes)
+// the same transfer id is kept for the whole message, so a dropped chunk or a lost response only costs that chunk.
+bool Client::sendChunked(const SetMessage& mes, uint64_t size)
 {
+    const std::string transfer_id = GenerateUniqueName();
+    ChunkUploader uploader(m_settings.chunk_size, [&](const char *data, size_t chunk_size, uint64_t offset) {
+        return sendChunk(transfer_id, size, data, chunk_size, offset);
+    });
+    return uploader.send([&](std::ostream& os) { mes.serialize(os); }, size);
+}
+
+// send a message through the persistent channel. the connection is made here and kept for the next messages.
+// Unavailable means there is no channel to use and the message goes through HTTP.
+// the channel doesn't carry the server session id, so it is asked for over HTTP on each new connection.
+// a restarted server drops the connection, which fails the message in flight and makes the next one reconnect.
+Client::SendResult Client::sendChannel(const Message& mes)
+{
+    if (m_settings.channel_port == 0)
+        return SendResult::Unavailable;
+
+    if (!m_channel)
+        m_channel.reset(new ChannelClient(m_settings));
+    if (!m_channel->isConnected()) {
+        if (!m_channel->connect())
+            return SendResult::Unavailable;
+        if (!isServerAvailable(m_settings.timeout_ms)) {
+            m_channel->disconnect();
+            return SendResult::Unavailable;
+        }
+    }
+
+    ResponseMessagePtr res = m_channel->send(mes);
+    if (!res)
+        return SendResult::Failed;
+    if (res->text.size() == 1 && res->text[0] == "ok") {
+        m_counters->countChannel();
+        return SendResult::Sent;
+    }
+    m_error_message = res->text.empty() ? std::string() : res->text[0];
+    return SendResult::Rejected;
+}
+
+bool Client::send(const SetMessage& mes)
+{
+    const mu::nanosec begin = mu::Now();
+    const uint64_t size = ssize(mes);
+    bool ret = sendSet(mes, size);
+    m_counters->add(Message::Type::Set, size, ret, mu::Now() - begin);
+    return ret;
+}
+
+bool Client::sendSet(const SetMessage& mes, uint64_t size)
+{
+    if (shouldUseSharedMemory(size)) {
+        // a server that answered hasn't imported the message, so it goes through HTTP.
+        // without an answer the server may have it, and resending could import it twice.
+        const SendResult result = sendSharedMemory(mes, size);
+        if (result == SendResult::Sent)
+            return true;
+        if (result == SendResult::Failed)
+            return false;
+    }
+    if (shouldSendChunked(size))
+        return sendChunked(mes, size);
+    // the server gives HTTP the same answer as the channel. only Unavailable is worth another try
+    const SendResult result = sendChannel(mes);
+    if (result != SendResult::Unavailable)
+        return result == SendResult::Sent;
+
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
         session.setTimeout(m_settings.timeout_ms * 1000);
 
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "delete" };
+        HTTPRequest request{ HTTPRequest::HTTP_POST, "set" };
         request.setContentType("application/octet-stream");
         request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
+
+        RawVector<char> encoded;
+        if (shouldCompress(size)) {
+            mu::MemoryStream ms;
+            mes.serialize(ms);
+            ms.flush();
+
+            SceneCacheEncoderSettings encoder_settings;
+            encoder_settings.zstd.compressionLevel = m_settings.compression_level;
+            BufferEncoder::CreateEncoder(SceneCacheEncoding::ZSTD, encoder_settings)->EncodeV(encoded, ms.getBuffer());
+            if (encoded.size() >= size)
+                encoded.clear(); // incompressible. send as is
+        }
+
+        if (!encoded.empty()) {
+            request.set("Content-Encoding", CONTENT_ENCODING_ZSTD);
+            request.setContentLength(encoded.size());
+            auto& os = session.sendRequest(request);
+            os.write(encoded.cdata(), encoded.size());
+            os.flush();
+        }
+        else {
+            request.setContentLength(size);
+            auto& os = session.sendRequest(request);
+            mes.serialize(os);
+            os.flush();
+        }
 
         HTTPResponse response;
         auto& rs = session.receiveResponse(response);
+        updateServerCapabilities(response);
         std::ostringstream ostr;
         StreamCopier::copyStream(rs, ostr);
         return response.getStatus() == HTTPResponse::HTTP_OK;
@@ -147,29 +401,52 @@ bool Client::send(const DeleteMessage& mes)
     }
 }
 
-bool Client::send(const FenceMessage& mes)
+// post a message that is answered by a status only
+bool Client::post(const char *uri, const Message& mes)
 {
+    const mu::nanosec begin = mu::Now();
+    const uint64_t size = ssize(mes);
+    bool ret = false;
+    const SendResult result = sendChannel(mes);
+    if (result != SendResult::Unavailable) {
+        ret = result == SendResult::Sent;
+        m_counters->add(mes.getType(), size, ret, mu::Now() - begin);
+        return ret;
+    }
+
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
         session.setTimeout(m_settings.timeout_ms * 1000);
 
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "fence" };
+        HTTPRequest request{ HTTPRequest::HTTP_POST, uri };
         request.setContentType("application/octet-stream");
         request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
+        request.setContentLength(size);
         auto& os = session.sendRequest(request);
         mes.serialize(os);
         os.flush();
 
         HTTPResponse response;
         auto& rs = session.receiveResponse(response);
+        updateServerCapabilities(response);
         std::ostringstream ostr;
         StreamCopier::copyStream(rs, ostr);
-        return response.getStatus() == HTTPResponse::HTTP_OK;
+        ret = response.getStatus() == HTTPResponse::HTTP_OK;
     }
     catch (...) {
-        return false;
     }
+    m_counters->add(mes.getType(), size, ret, mu::Now() - begin);
+    return ret;
+}
+
+bool Client::send(const DeleteMessage& mes)
+{
+    return post("delete", mes);
+}
+
+bool Client::send(const FenceMessage& mes)
+{
+    return post("fence", mes);
 }
 
 #ifndef WIN32
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "MeshSync/msPool.h"
+
+namespace ms {
+
+struct PoolRegistry
+{
+    std::mutex mutex;
+    std::vector<PoolBase*> pools;
+
+    static PoolRegistry& instance()
+    {
+        // constructed before the first pool, hence destroyed after the last one
+        static PoolRegistry s_instance;
+        return s_instance;
+    }
+};
+
+int PoolBase::getPoolCount()
+{
+    PoolRegistry& reg = PoolRegistry::instance();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    return (int)reg.pools.size();
+}
+
+PoolBase* PoolBase::getPool(int i)
+{
+    PoolRegistry& reg = PoolRegistry::instance();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    return i >= 0 && i < (int)reg.pools.size() ? reg.pools[i] : nullptr;
+}
+
+PoolBase* PoolBase::findPool(const char *name)
+{
+    if (!name)
+        return nullptr;
+    PoolRegistry& reg = PoolRegistry::instance();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    for (PoolBase *pool : reg.pools) {
+        if (std::strcmp(pool->m_name, name) == 0)
+            return pool;
+    }
+    return nullptr;
+}
+
+PoolBase::PoolBase(const char *name, size_t object_size)
+    : m_name(name)
+    , m_object_size(object_size)
+{
+    PoolRegistry& reg = PoolRegistry::instance();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    reg.pools.push_back(this);
+}
+
+PoolBase::~PoolBase()
+{
+    PoolRegistry& reg = PoolRegistry::instance();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    reg.pools.erase(std::remove(reg.pools.begin(), reg.pools.end(), this), reg.pools.end());
+}
+
+void PoolBase::addCache(const std::atomic<int> *count)
+{
+    std::unique_lock<std::mutex> lock(m_caches_mutex);
+    m_caches.push_back(count);
+}
+
+void PoolBase::removeCache(const std::atomic<int> *count)
+{
+    std::unique_lock<std::mutex> lock(m_caches_mutex);
+    m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), count), m_caches.end());
+}
+
+const char* PoolBase::getName() const
+{
+    return m_name;
+}
+
+size_t PoolBase::getObjectSize() const
+{
+    return m_object_size;
+}
+
+PoolStats PoolBase::getStats() const
+{
+    PoolStats ret;
+    ret.num_hits = m_hits.load(std::memory_order_relaxed);
+    ret.num_misses = m_misses.load(std::memory_order_relaxed);
+    ret.num_trimmed = m_trimmed.load(std::memory_order_relaxed);
+    ret.num_allocated = m_allocated.load(std::memory_order_relaxed);
+    ret.num_retained = m_retained.load(std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> lock(m_caches_mutex);
+        for (const std::atomic<int> *count : m_caches)
+            ret.num_cached += count->load(std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+void PoolBase::resetStats()
+{
+    // num_allocated and num_retained track live state. they are not statistics to reset.
+    m_hits = 0;
+    m_misses = 0;
+    m_trimmed = 0;
+}
+
+int PoolBase::getMaxRetained() const
+{
+    return m_max_retained;
+}
+
+void PoolBase::setMaxRetained(int v)
+{
+    m_max_retained = std::max(v, 0);
+}
+
+} // namespace ms
@@ -6,9 +6,48 @@
 
 namespace ms {
 
+ReadySignal& ReadySignal::operator=(bool v)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready = v;
+    }
+    if (v)
+        m_cond.notify_all();
+    return *this;
+}
+
+ReadySignal::operator bool() const
+{
+    return m_ready;
+}
+
+void ReadySignal::notify()
+{
+    {
+        // make sure waiters are either blocked or haven't checked their condition yet
+        std::unique_lock<std::mutex> lock(m_mutex);
+    }
+    m_cond.notify_all();
+}
+
+bool ReadySignal::wait_for(int timeout_ms, const std::atomic_bool* cancelled)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, cancelled]() {
+        return m_ready || (cancelled && *cancelled);
+    });
+    return m_ready;
+}
+
+
 Message::~Message()
 {
 }
+Message::Type Message::getType() const
+{
+    return Type::Unknown;
+}
 void Message::serialize(std::ostream& os) const
 {
     write(os, protocol_version);
@@ -31,6 +70,10 @@ GetMessage::GetMessage()
 {
     SetAllGetFlags(flags);
 }
+Message::Type GetMessage::getType() const
+{
+    return Type::Get;
+}
 void GetMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
@@ -55,6 +98,10 @@ SetMessage::SetMessage(ScenePtr s)
 {
     scene = s;
 }
+Message::Type SetMessage::getType() const
+{
+    return Type::Set;
+}
 void SetMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
@@ -70,6 +117,10 @@ void SetMessage::deserialize(std::istream& is)
 DeleteMessage::DeleteMessage()
 {
 }
+Message::Type DeleteMessage::getType() const
+{
+    return Type::Delete;
+}
 void DeleteMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
@@ -87,6 +138,10 @@ void DeleteMessage::deserialize(std::istream& is)
 
 
 FenceMessage::~FenceMessage() {}
+Message::Type FenceMessage::getType() const
+{
+    return Type::Fence;
+}
 void FenceMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
@@ -101,6 +156,10 @@ void FenceMessage::deserialize(std::istream& is)
 }
 
 TextMessage::~TextMessage() {}
+Message::Type TextMessage::getType() const
+{
+    return Message::Type::Text;
+}
 void TextMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
@@ -116,6 +175,7 @@ void TextMessage::deserialize(std::istream& is)
 
 
 ScreenshotMessage::ScreenshotMessage() {}
+Message::Type ScreenshotMessage::getType() const { return Type::Screenshot; }
 void ScreenshotMessage::serialize(std::ostream& os) const { super::serialize(os); }
 void ScreenshotMessage::deserialize(std::istream& is) { super::deserialize(is); }
 
@@ -124,6 +184,10 @@ ResponseMessage::ResponseMessage()
 {
 }
 
+Message::Type ResponseMessage::getType() const
+{
+    return Type::Response;
+}
 void ResponseMessage::serialize(std::ostream & os) const
 {
     super::serialize(os);
@@ -141,6 +205,10 @@ QueryMessage::QueryMessage()
 {
 }
 
+Message::Type QueryMessage::getType() const
+{
+    return Type::Query;
+}
 void QueryMessage::serialize(std::ostream & os) const
 {
     super::serialize(os);
@@ -170,6 +238,9 @@ void PollMessage::deserialize(std::istream& is)
 }
 
 ServerLiveEditRequest::ServerLiveEditRequest() {}
+Message::Type ServerLiveEditRequest::getType() const {
+    return Type::RequestServerLiveEdit;
+}
 void ServerLiveEditRequest::serialize(std::ostream& os) const {
     super::serialize(os);
 
@@ -196,6 +267,9 @@ void ServerLiveEditResponse::deserialize(std::istream& is)
 EditorCommandMessage::EditorCommandMessage() {
     buffer[0] = '\0';
 }
+Message::Type EditorCommandMessage::getType() const {
+    return Type::EditorCommand;
+}
 void EditorCommandMessage::serialize(std::ostream& os) const {
     super::serialize(os);
     write(os, command_type);
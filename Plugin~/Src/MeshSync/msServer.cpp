@@ -1,5 +1,12 @@
 #include "pch.h"
 
+#ifndef _WIN32
+    #include <fcntl.h> //shm_open()
+    #include <sys/mman.h>
+    #include <sys/stat.h> //fstat()
+    #include <unistd.h>
+#endif
+
 #include "msServerRequestHandler.h"
 
 #include "MeshUtils/muLog.h"
@@ -7,6 +14,7 @@
 #include "MeshSync/msMisc.h" //StartsWith()
 #include "MeshSync/msProtocol.h" //GetMessagePtr
 #include "MeshSync/msServer.h"
+#include "MeshSync/msChannel.h"
 #include "MeshSync/MeshSync.h" //TestMessagePtr
 #include "MeshSync/SceneGraph/msScene.h"
 #include "MeshSync/SceneGraph/msMesh.h"
@@ -14,15 +22,23 @@
 
 #include "MeshSync/SceneGraph/msEntityConverter.h"
 #include "MeshSync/Utility/msIdUtility.h"
+#include "MeshSync/SceneCache/msSceneCacheEncoderSettings.h"
+
+#include "SceneCache/BufferEncoder.h"
 
 namespace ms {
 
 using namespace Poco::Net;
 
+// how long request handlers wait for the main thread to respond
+static const int RequestTimeoutMS = 3000;
+static const int PollTimeoutMS = 10000;
+
 
 Server::Server(const ServerSettings& settings)
     : m_settings(settings)
 {
+    m_zstd_decoder = BufferEncoder::CreateEncoder(SceneCacheEncoding::ZSTD, SceneCacheEncoderSettings());
     m_server_session_id = IdUtility::GenerateSessionId();
 }
 
@@ -41,8 +57,13 @@ bool Server::start()
         if (m_settings.max_threads > 0)
             params->setMaxThreads(m_settings.max_threads);
 
+        int num_workers = m_import_worker_count > 0 ? m_import_worker_count : (int)std::thread::hardware_concurrency();
+        m_import_workers.reset(new WorkerPool(num_workers, m_max_pending_imports));
+        m_stopping = false;
+
         try {
             ServerSocket svs(m_settings.port);
+            m_settings.port = svs.address().port();
             m_server.reset(new HTTPServer(new ServerRequestHandlerFactory(this), svs, params));
             m_server->start();
         }
@@ -50,20 +71,133 @@ bool Server::start()
             printf("%s\n", e.what());
             return false;
         }
+        startChannel();
     }
 
     return true;
 }
 
+void Server::startChannel()
+{
+    if (m_channel_port == 0)
+        return;
+
+    m_channels_closing = false;
+    try {
+        auto* params = new TCPServerParams;
+        if (m_settings.max_threads > 0)
+            params->setMaxThreads(m_settings.max_threads);
+
+        ServerSocket svs(m_channel_port == AnyChannelPort ? 0 : m_channel_port);
+        m_channel_bound_port = svs.address().port();
+        m_channel_server.reset(new TCPServer(new ChannelConnectionFactory(this), svs, params));
+        m_channel_server->start();
+    }
+    catch (Poco::IOException &e) {
+        // HTTP keeps working without the channel
+        printf("%s\n", e.what());
+    }
+}
+
 void Server::stop()
 {
+    // HTTPServer::stop() only stops accepting. handlers that are already running keep using this server
+    if (m_server)
+        m_server->stop();
+    stopRequests();
+    closeChannels(true);
     m_server.reset();
+    // request handlers are gone at this point. pending imports are finished before the pool goes away.
+    m_import_workers.reset();
+}
+
+// wake up the requests that wait for the main thread (channel ones included) and wait for the HTTP ones to return
+void Server::stopRequests()
+{
+    m_stopping = true;
+    {
+        lock_t lock(m_properties_mutex);
+        if (m_current_live_edit_request) {
+            m_current_live_edit_request->cancelled = true;
+            m_current_live_edit_request->ready.notify();
+        }
+    }
+
+    lock_t lock(m_requests_mutex);
+    for (auto *ready : m_waiting_requests)
+        ready->notify();
+    m_requests_cond.wait(lock, [this]() { return m_num_active_requests == 0; });
+}
+
+bool Server::beginRequest()
+{
+    lock_t lock(m_requests_mutex);
+    if (m_stopping)
+        return false;
+    ++m_num_active_requests;
+    return true;
+}
+
+void Server::endRequest()
+{
+    {
+        lock_t lock(m_requests_mutex);
+        --m_num_active_requests;
+    }
+    m_requests_cond.notify_all();
+}
+
+// wait for the main thread to handle a request. return false on timeout or when the server is stopping.
+bool Server::waitReady(ReadySignal& ready, int timeout_ms)
+{
+    {
+        lock_t lock(m_requests_mutex);
+        m_waiting_requests.push_back(&ready);
+    }
+    // stopRequests() sets m_stopping before it notifies, so a waiter that registers after that doesn't block either
+    const bool ret = ready.wait_for(timeout_ms, &m_stopping);
+    {
+        lock_t lock(m_requests_mutex);
+        m_waiting_requests.erase(std::find(m_waiting_requests.begin(), m_waiting_requests.end(), &ready));
+    }
+    return ret;
 }
 
 void Server::abort() {
     if (m_server) {
         m_server->stopAll(true);
     }
+    closeChannels(false);
+}
+
+void Server::setChannelPort(uint16_t v)
+{
+    if (v == m_channel_port)
+        return;
+
+    m_channel_port = v;
+    if (m_server) {
+        closeChannels(true);
+        startChannel();
+    }
+}
+
+uint16_t Server::getChannelPort() const
+{
+    return m_channel_server ? m_channel_bound_port : m_channel_port;
+}
+
+void Server::closeChannels(bool wait)
+{
+    if (wait)
+        m_channel_server.reset(); // stop accepting
+
+    lock_t lock(m_channels_mutex);
+    m_channels_closing = true; // cleared by startChannel()
+    for (auto& channel : m_channels)
+        channel->close();
+    if (wait)
+        m_channels_cond.wait(lock, [this]() { return m_channels.empty(); });
 }
 
 void Server::clear()
@@ -71,6 +205,13 @@ void Server::clear()
     lock_t lock(m_message_mutex);
     m_received_messages.clear();
     m_host_scene.reset();
+
+    int num_entities = 0;
+    for (auto& holder : m_processing_messages) {
+        if (holder.type == Message::Type::Set)
+            num_entities += (int)std::static_pointer_cast<SetMessage>(holder.message)->scene->entities.size();
+    }
+    m_counters.num_queued_entities = num_entities;
 }
 
 ServerSettings& Server::getSettings()
@@ -85,11 +226,10 @@ int Server::getNumMessages() const
 
 int Server::processMessages(const MessageHandler& handler)
 {
-    {
-        lock_t lm(m_message_mutex);
-        // just move messages to processing list to minimize contention
-        m_processing_messages.splice(m_processing_messages.end(), m_received_messages);
-    }
+    // take all received messages at once. server threads keep pushing without waiting for us
+    m_received_messages.pop_all([this](MessageHolder& holder) {
+        m_processing_messages.push_back(std::move(holder));
+    });
 
     int ret = 0;
     for (auto i = m_processing_messages.begin(); i != m_processing_messages.end(); /**/) {
@@ -100,83 +240,108 @@ int Server::processMessages(const MessageHandler& handler)
         if (holder.task.valid())
             holder.task.wait();
 
-        bool skip = false;
-        auto& mes = holder.message;
-        if (!mes)
-            goto next;
+        const mu::nanosec begin = mu::Now();
+        bool skip = holder.message ? dispatchMessage(holder, handler) : false;
+        m_counters.dispatch_latency.add(mu::Now() - begin);
+        if (skip) {
+            ++i;
+        }
+        else {
+            m_processing_messages.erase(i++);
+            ++ret;
+        }
+    }
+    return ret;
+}
 
-        if (auto get = std::dynamic_pointer_cast<GetMessage>(mes)) {
-            m_current_get_request = get;
-            handler(Message::Type::Get, *mes);
-            m_current_get_request = nullptr;
+// return true if the message has to be kept for later (belongs to another scene session)
+bool Server::dispatchMessage(MessageHolder& holder, const MessageHandler& handler)
+{
+    bool skip = false;
+    auto& mes = holder.message;
+
+    // messages are tagged by type when queued. no need to try casting to every message class
+    switch (holder.type) {
+    case Message::Type::Get:
+        m_current_get_request = std::static_pointer_cast<GetMessage>(mes);
+        handler(Message::Type::Get, *mes);
+        m_current_get_request = nullptr;
+        break;
+
+    case Message::Type::Set:
+        if (mes->session_id == m_current_scene_session) {
+            m_counters.num_queued_entities -= (int)std::static_pointer_cast<SetMessage>(mes)->scene->entities.size();
+            handler(Message::Type::Set, *mes);
+            m_scene_cache.push_back(std::static_pointer_cast<SetMessage>(mes));
         }
-        else if (auto set = std::dynamic_pointer_cast<SetMessage>(mes)) {
-            if (mes->session_id == m_current_scene_session)
-            {
-                handler(Message::Type::Set, *mes);
-                m_scene_cache.push_back(set);
-            }
+        else
+            skip = true;
+        break;
+
+    case Message::Type::Delete:
+        if (mes->session_id == m_current_scene_session)
+            handler(Message::Type::Delete, *mes);
+        else
+            skip = true;
+        break;
+
+    case Message::Type::Fence:
+    {
+        auto fence = std::static_pointer_cast<FenceMessage>(mes);
+        if (fence->type == FenceMessage::FenceType::SceneBegin) {
+            if (m_current_scene_session == InvalidID)
+                m_current_scene_session = fence->session_id;
             else
                 skip = true;
         }
-        else if (auto del = std::dynamic_pointer_cast<DeleteMessage>(mes)) {
-            if (mes->session_id == m_current_scene_session)
-                handler(Message::Type::Delete, *mes);
+        else if (fence->type == FenceMessage::FenceType::SceneEnd) {
+            if (m_current_scene_session == fence->session_id)
+                m_current_scene_session = InvalidID;
             else
                 skip = true;
         }
-        else if (auto fence = std::dynamic_pointer_cast<FenceMessage>(mes)) {
-            if (fence->type == FenceMessage::FenceType::SceneBegin) {
-                if (m_current_scene_session == InvalidID)
-                    m_current_scene_session = fence->session_id;
-                else
-                    skip = true;
-            }
-            else if (fence->type == FenceMessage::FenceType::SceneEnd) {
-                if (m_current_scene_session == fence->session_id)
-                    m_current_scene_session = InvalidID;
-                else
-                    skip = true;
-            }
 
-            if (!skip) {
-                handler(Message::Type::Fence, *mes);
-                if (fence->type == FenceMessage::FenceType::SceneEnd)
-                    m_scene_cache.clear();
-            }
-        }
-        else if (std::dynamic_pointer_cast<TextMessage>(mes)) {
-            handler(Message::Type::Text, *mes);
-        }
-        else if (auto shot = std::dynamic_pointer_cast<ScreenshotMessage>(mes)) {
-            m_current_screenshot_request = shot;
-            handler(Message::Type::Screenshot, *mes);
-        }
-        else if (auto q = std::dynamic_pointer_cast<QueryMessage>(mes)) {
-            handler(Message::Type::Query, *mes);
-        }
-        else if (auto req = std::dynamic_pointer_cast<ServerLiveEditRequest>(mes)) {
-            lock_t lock(m_properties_mutex);
-            if (m_current_live_edit_request) {
-                m_current_live_edit_request->cancelled = true;
-            }
-            m_current_live_edit_request = req;
-            handler(Message::Type::RequestServerLiveEdit, *mes);
-        }
-        else if (auto command = std::dynamic_pointer_cast<EditorCommandMessage>(mes)) {
-            handler(Message::Type::EditorCommand, *mes);
+        if (!skip) {
+            handler(Message::Type::Fence, *mes);
+            if (fence->type == FenceMessage::FenceType::SceneEnd)
+                m_scene_cache.clear();
         }
+        break;
+    }
 
-    next:
-        if (skip) {
-            ++i;
-        }
-        else {
-            m_processing_messages.erase(i++);
-            ++ret;
+    case Message::Type::Text:
+        handler(Message::Type::Text, *mes);
+        break;
+
+    case Message::Type::Screenshot:
+        m_current_screenshot_request = std::static_pointer_cast<ScreenshotMessage>(mes);
+        handler(Message::Type::Screenshot, *mes);
+        break;
+
+    case Message::Type::Query:
+        handler(Message::Type::Query, *mes);
+        break;
+
+    case Message::Type::RequestServerLiveEdit:
+    {
+        lock_t lock(m_properties_mutex);
+        if (m_current_live_edit_request) {
+            m_current_live_edit_request->cancelled = true;
+            m_current_live_edit_request->ready.notify();
         }
+        m_current_live_edit_request = std::static_pointer_cast<ServerLiveEditRequest>(mes);
+        handler(Message::Type::RequestServerLiveEdit, *mes);
+        break;
     }
-    return ret;
+
+    case Message::Type::EditorCommand:
+        handler(Message::Type::EditorCommand, *mes);
+        break;
+
+    default:
+        break;
+    }
+    return skip;
 }
 
 void Server::serveText(HTTPServerResponse& response, const char* text, int stat)
@@ -187,6 +352,8 @@ void Server::serveText(HTTPServerResponse& response, const char* text, int stat)
     response.setContentType("text/plain");
     response.setContentLength(size);
     response.set(SERVER_SESSION_ID, std::to_string(m_server_session_id));
+    response.set("Accept-Encoding", CONTENT_ENCODING_ZSTD); // request encodings we can decode (RFC 7694)
+    response.set(TRANSPORTS, TRANSPORT_SHARED_MEMORY + "," + TRANSPORT_CHUNKS);
 
     auto& os = response.send();
     os.write(text, size);
@@ -361,57 +528,52 @@ Scene* Server::getHostScene()
     return m_host_scene.get();
 }
 
-Server::MessageHolder* Server::queueMessage(MessagePtr mes)
+void Server::queueMessage(MessagePtr mes)
 {
     if (!mes)
-        return nullptr;
+        return;
 
     MessageHolder t;
     t.message = mes;
+    t.type = mes->getType();
     t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
-    return &m_received_messages.back();
+    ++m_counters.num_messages[(int)t.type];
+    m_received_messages.push(std::move(t));
 }
 
-Server::MessageHolder* Server::queueMessage(MessagePtr mes, std::future<void>&& task)
+void Server::queueMessage(MessagePtr mes, std::future<void>&& task)
 {
     if (!mes)
-        return nullptr;
+        return;
 
     MessageHolder t;
     t.message = mes;
+    t.type = mes->getType();
     t.task = std::move(task);
     t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
-    return &m_received_messages.back();
+    ++m_counters.num_messages[(int)t.type];
+    m_received_messages.push(std::move(t));
 }
 
 void Server::queueTextMessage(const char *mes, TextMessage::Type type)
 {
-    auto txt = new TextMessage();
+    auto txt = std::make_shared<TextMessage>();
     txt->type = type;
     txt->text = mes;
-
-    MessageHolder t;
-    t.message.reset(txt);
-    t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
+    queueMessage(txt);
 }
 
 
 template<class MessageT>
 std::shared_ptr<MessageT> Server::deserializeMessage(HTTPServerRequest& request, HTTPServerResponse& response)
 {
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::Server);
     try {
+        const mu::nanosec begin = mu::Now();
         auto mes = std::make_shared<MessageT>();
         mes->deserialize(request.stream());
         mes->timestamp_recv = mu::Now();
+        m_counters.decode_latency.add(mes->timestamp_recv - begin);
         return mes;
     }
     catch (const std::exception& e) {
@@ -421,6 +583,150 @@ std::shared_ptr<MessageT> Server::deserializeMessage(HTTPServerRequest& request,
     }
 }
 
+// read the whole body into one buffer and deserialize from memory.
+// vertex buffers of the scene share the body buffer instead of being copied attribute by attribute.
+SetMessagePtr Server::deserializeSetMessage(HTTPServerRequest& request, HTTPServerResponse& response)
+{
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::Server);
+    const std::string& encoding = request.get("Content-Encoding", "");
+    const std::streamsize size = request.getContentLength();
+    const bool shared_memory = request.has(SHARED_MEMORY_NAME);
+    if (size > 0 && static_cast<uint64_t>(size) > m_max_message_size) {
+        const char *error = "SetMessage: request body too large";
+        queueTextMessage(error, TextMessage::Type::Error);
+        serveText(response, error, HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+        return nullptr;
+    }
+    if (size <= 0 && encoding.empty() && !shared_memory) {
+        // content length is unknown (e.g. chunked transfer). fall back to stream deserialization.
+        return deserializeMessage<SetMessage>(request, response);
+    }
+
+    try {
+        if (!encoding.empty() && encoding != CONTENT_ENCODING_ZSTD)
+            throw std::runtime_error("SetMessage: unsupported Content-Encoding " + encoding);
+
+        RawVector<char> body;
+        if (shared_memory) {
+            if (std::stoull(request.get(SHARED_MEMORY_SIZE, "0")) > m_max_message_size) {
+                const char *error = "SetMessage: shared memory message too large";
+                queueTextMessage(error, TextMessage::Type::Error);
+                serveText(response, error, HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+                return nullptr;
+            }
+            if (!readSharedMemory(request, body)) {
+                // not an error of the message. the client sends it over HTTP right after this
+                response.set(SHARED_MEMORY_UNAVAILABLE, "1");
+                serveText(response, "SetMessage: shared memory segment is not accessible", HTTPResponse::HTTP_BAD_REQUEST);
+                return nullptr;
+            }
+        }
+        else {
+            if (size <= 0)
+                throw std::runtime_error("SetMessage: encoded body requires Content-Length");
+            body.resize_discard(static_cast<size_t>(size));
+            std::istream& is = request.stream();
+            is.read(body.data(), size);
+            if (is.gcount() != size)
+                throw std::runtime_error("SetMessage: incomplete request body");
+        }
+
+        return decodeSetMessage(std::move(body), encoding);
+    }
+    catch (const std::exception& e) {
+        queueTextMessage(e.what(), TextMessage::Type::Error);
+        serveText(response, e.what(), HTTPResponse::HTTP_BAD_REQUEST);
+        return nullptr;
+    }
+}
+
+SetMessagePtr Server::decodeSetMessage(RawVector<char>&& body, const std::string& encoding)
+{
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::Server);
+    const mu::nanosec begin = mu::Now();
+    if (encoding == CONTENT_ENCODING_ZSTD) {
+        RawVector<char> decoded;
+        m_zstd_decoder->DecodeV(decoded, body, static_cast<size_t>(std::min<uint64_t>(m_max_message_size, SIZE_MAX)));
+        if (decoded.empty())
+            throw std::runtime_error("SetMessage: invalid or too large zstd body");
+        body.swap(decoded);
+    }
+
+    mu::MemoryStream ms(std::move(body));
+    auto mes = std::make_shared<SetMessage>();
+    mes->deserialize(ms);
+    mes->timestamp_recv = mu::Now();
+    m_counters.decode_latency.add(mes->timestamp_recv - begin);
+
+    // keep body buffer alive. meshes etc. use it as their vertex buffers
+    mes->scene->scene_buffers.push_back(ms.moveBuffer());
+    return mes;
+}
+
+// size of an existing shared memory segment. 0 if it can't be opened.
+// Poco maps whatever size it is given, and reading past the end of the segment crashes (SIGBUS).
+static uint64_t GetSharedMemorySize(const std::string& name)
+{
+#ifdef _WIN32
+    const std::wstring wname(name.begin(), name.end()); // names are checked to be ascii
+    HANDLE handle = ::OpenFileMappingW(FILE_MAP_READ, FALSE, wname.c_str());
+    if (!handle)
+        return 0;
+    uint64_t ret = 0;
+    if (void *view = ::MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0)) {
+        // rounded up to pages. the rest of the last page is readable too.
+        MEMORY_BASIC_INFORMATION info;
+        if (::VirtualQuery(view, &info, sizeof(info)))
+            ret = info.RegionSize;
+        ::UnmapViewOfFile(view);
+    }
+    ::CloseHandle(handle);
+    return ret;
+#else
+    // Poco opens "/" + name (see SharedMemory_POSIX.cpp)
+    const int fd = ::shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    const uint64_t ret = ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    ::close(fd);
+    return ret;
+#endif
+}
+
+// copy the message out of the client's segment. the client reuses it as soon as we respond.
+// return false if the segment can't be reached from this process. malformed requests throw.
+bool Server::readSharedMemory(HTTPServerRequest& request, RawVector<char>& dst)
+{
+    if (!request.clientAddress().host().isLoopback())
+        return false;
+
+    // only names made by Client. anything else could refer to an unrelated object.
+    const std::string& name = request.get(SHARED_MEMORY_NAME);
+    if (!StartsWith(name, "MeshSync-") || name.size() > 64 ||
+        std::find_if(name.begin(), name.end(), [](char c) { return !std::isalnum((unsigned char)c) && c != '-'; }) != name.end())
+        throw std::runtime_error("SetMessage: invalid shared memory name");
+
+    const uint64_t size = std::stoull(request.get(SHARED_MEMORY_SIZE, "0"));
+    if (size == 0)
+        throw std::runtime_error("SetMessage: invalid shared memory size");
+    if (size > m_max_message_size)
+        throw std::runtime_error("SetMessage: shared memory message too large");
+    // a segment that doesn't exist here is 0
+    if (size > GetSharedMemorySize(name))
+        return false;
+
+    try {
+        Poco::SharedMemory shm(name, static_cast<size_t>(size), Poco::SharedMemory::AM_READ, nullptr, false);
+        dst.assign(shm.begin(), static_cast<size_t>(size));
+    }
+    catch (const Poco::Exception&) {
+        return false;
+    }
+    m_counters.bytes_received += size;
+    return true;
+}
+
 void Server::sanitizeHierarchyPath(std::string& /*path*/)
 {
     // nothing to do for now
@@ -429,15 +735,87 @@ void Server::sanitizeHierarchyPath(std::string& /*path*/)
 
 void Server::recvSet(HTTPServerRequest& request, HTTPServerResponse& response)
 {
-    auto mes = deserializeMessage<SetMessage>(request, response);
+    if (request.has(TRANSFER_ID)) {
+        recvSetChunk(request, response);
+        return;
+    }
+
+    auto mes = deserializeSetMessage(request, response);
     if (!mes)
         return;
 
-    auto task = std::async(std::launch::async, [this, mes]() {
+    importSetMessage(mes);
+    serveText(response, "ok");
+}
+
+// one byte range of a chunked SetMessage (see ChunkAssembler).
+// the answer always carries CHUNK_RECEIVED, which is where the client continues from.
+void Server::recvSetChunk(HTTPServerRequest& request, HTTPServerResponse& response)
+{
+    try {
+        const std::string& id = request.get(TRANSFER_ID);
+        const uint64_t total_size = std::stoull(request.get(TRANSFER_SIZE, "0"));
+        const uint64_t offset = std::stoull(request.get(CHUNK_OFFSET, "0"));
+        const std::string& encoding = request.get("Content-Encoding", "");
+        const std::streamsize size = request.getContentLength();
+        if (total_size == 0 || size <= 0)
+            throw std::runtime_error("SetMessage: invalid chunk");
+        if (total_size > m_max_message_size || (uint64_t)size > total_size) {
+            const char *error = "SetMessage: chunked message too large";
+            queueTextMessage(error, TextMessage::Type::Error);
+            serveText(response, error, HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+            return;
+        }
+        if (!encoding.empty() && encoding != CONTENT_ENCODING_ZSTD)
+            throw std::runtime_error("SetMessage: unsupported Content-Encoding " + encoding);
+
+        RawVector<char> chunk;
+        chunk.resize_discard(static_cast<size_t>(size));
+        std::istream& is = request.stream();
+        is.read(chunk.data(), size);
+        if (is.gcount() != size)
+            throw std::runtime_error("SetMessage: incomplete request body");
+        if (encoding == CONTENT_ENCODING_ZSTD) {
+            // a chunk never decodes to more than the whole message
+            RawVector<char> decoded;
+            m_zstd_decoder->DecodeV(decoded, chunk, static_cast<size_t>(total_size));
+            if (decoded.empty())
+                throw std::runtime_error("SetMessage: invalid or too large zstd chunk");
+            chunk.swap(decoded);
+        }
+
+        RawVector<char> body;
+        uint64_t received = 0;
+        const ChunkAssembler::Result result = m_chunks.append(id, total_size, offset, chunk.cdata(), chunk.size(), body, received);
+
+        response.set(CHUNK_RECEIVED, std::to_string(received));
+        if (result == ChunkAssembler::Result::OutOfOrder) {
+            serveText(response, "chunk out of order", HTTPResponse::HTTP_CONFLICT);
+            return;
+        }
+        if (result == ChunkAssembler::Result::Completed)
+            importSetMessage(decodeSetMessage(std::move(body), ""));
+        serveText(response, "ok");
+    }
+    catch (const std::exception& e) {
+        queueTextMessage(e.what(), TextMessage::Type::Error);
+        serveText(response, e.what(), HTTPResponse::HTTP_BAD_REQUEST);
+    }
+}
+
+void Server::importSetMessage(SetMessagePtr mes)
+{
+    const int num_entities = (int)mes->scene->entities.size();
+    m_counters.num_entities_received += num_entities;
+    m_counters.num_queued_entities += num_entities;
+
+    // may block while the import queue is full. this holds the response back and throttles the client.
+    auto task = m_import_workers->submit([this, mes]() {
+        const mu::nanosec begin = mu::Now();
         mes->scene->import(m_settings.import_settings);
+        m_counters.import_latency.add(mu::Now() - begin);
     });
     queueMessage(mes, std::move(task));
-    serveText(response, "ok");
 }
 
 void Server::recvDelete(HTTPServerRequest& request, HTTPServerResponse& response)
@@ -467,11 +845,7 @@ void Server::recvGet(HTTPServerRequest& request, HTTPServerResponse& response)
     queueMessage(mes);
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 300; ++i) {
-        if (mes->ready)
-            break;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    waitReady(mes->ready, RequestTimeoutMS);
 
     // serve data
     {
@@ -502,24 +876,7 @@ void Server::recvQuery(HTTPServerRequest& request, HTTPServerResponse& response)
     if (!mes)
         return;
 
-    mes->response.reset(new ResponseMessage());
-
-    if (mes->query_type == QueryMessage::QueryType::PluginVersion) {
-        mes->response->text.push_back(msPluginVersionStr);
-    }
-    else if (mes->query_type == QueryMessage::QueryType::ProtocolVersion) {
-        mes->response->text.push_back(std::to_string(msProtocolVersion));
-    }
-    else {
-        queueMessage(mes);
-
-        // wait for data arrive (or timeout)
-        for (int i = 0; i < 300; ++i) {
-            if (mes->ready)
-                break;
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-    }
+    answerQuery(mes);
 
     // serve data
     {
@@ -537,6 +894,24 @@ void Server::recvQuery(HTTPServerRequest& request, HTTPServerResponse& response)
     }
 }
 
+void Server::answerQuery(QueryMessagePtr mes)
+{
+    mes->response.reset(new ResponseMessage());
+
+    if (mes->query_type == QueryMessage::QueryType::PluginVersion) {
+        mes->response->text.push_back(msPluginVersionStr);
+    }
+    else if (mes->query_type == QueryMessage::QueryType::ProtocolVersion) {
+        mes->response->text.push_back(std::to_string(msProtocolVersion));
+    }
+    else {
+        queueMessage(mes);
+
+        // wait for data arrive (or timeout)
+        waitReady(mes->ready, RequestTimeoutMS);
+    }
+}
+
 void Server::recvText(HTTPServerRequest& request, HTTPServerResponse& response)
 {
     bool respond_form = false;
@@ -585,11 +960,7 @@ void Server::recvScreenshot(HTTPServerRequest& /*request*/, HTTPServerResponse&
     queueMessage(mes);
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 300; ++i) {
-        if (mes->ready)
-            break;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    waitReady(mes->ready, RequestTimeoutMS);
 
     // serve data
     response.set("Cache-Control", "no-store, must-revalidate");
@@ -615,12 +986,7 @@ void Server::recvPoll(HTTPServerRequest& request, HTTPServerResponse& response)
     }
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 400; ++i) {
-        if (mes->ready) {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(25));
-    }
+    waitReady(mes->ready, PollTimeoutMS);
 
     // serve data
     if (mes->ready) {
@@ -634,34 +1000,48 @@ void Server::recvPoll(HTTPServerRequest& request, HTTPServerResponse& response)
 void Server::recvServerLiveEditRequest(HTTPServerRequest& request, HTTPServerResponse& response)
 {
     auto mes = deserializeMessage<ServerLiveEditRequest>(request, response);
+    if (!mes)
+        return;
 
     queueMessage(mes);
 
-    // wait for data arrive
-    for (int i = 0; ; ++i) {
-        if (mes->ready)
-            break;
-        if (mes->cancelled)
+    // wait for data arrive. no timeout, this request is answered or cancelled by the main thread
+    while (!mes->ready) {
+        if (mes->cancelled || m_stopping)
             return;
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        mes->ready.wait_for(RequestTimeoutMS, &mes->cancelled);
     }
 
     // serve data
     response.set("Cache-Control", "no-store, must-revalidate");
-    
+
+    ServerLiveEditResponse reqResponse = buildLiveEditResponse(*mes);
+    auto& os = response.send();
+    reqResponse.serialize(os);
+    os.flush();
+}
+
+ServerLiveEditResponse Server::buildLiveEditResponse(const ServerLiveEditRequest& request)
+{
     auto reqResponse = ServerLiveEditResponse();
 
-    for (const auto& [key, prop] : m_pending_properties)
+    std::vector<EntityPtr> entities;
+    std::map<uint64_t, PropertyInfoPtr> properties;
+    {
+        lock_t lock(m_pending_mutex);
+        entities.swap(m_pending_entities);
+        properties.swap(m_pending_properties);
+    }
+
+    for (const auto& [key, prop] : properties)
     {
         auto p = PropertyInfo(*prop);
         reqResponse.properties.push_back(p);
     }
-    m_pending_properties.clear();
 
-    auto converters = Scene::getConverters(m_settings.import_settings, m_current_live_edit_request->scene_settings, true);
+    auto converters = Scene::getConverters(m_settings.import_settings, request.scene_settings, true);
 
-    for (auto entity : m_pending_entities) {
+    for (auto entity : entities) {
         for (auto& cv : converters) {
             cv->convert(*entity);
         }
@@ -669,8 +1049,6 @@ void Server::recvServerLiveEditRequest(HTTPServerRequest& request, HTTPServerRes
         reqResponse.entities.push_back(entity);
     }
 
-    m_pending_entities.clear();
-
     if (m_userScriptCallbackRequested)
     {
         reqResponse.message = REQUEST_USER_SCRIPT_CALLBACK;
@@ -680,10 +1058,7 @@ void Server::recvServerLiveEditRequest(HTTPServerRequest& request, HTTPServerRes
         reqResponse.message = REQUEST_SYNC;
         m_syncRequested = false;
     }
-
-    auto& os = response.send();
-    reqResponse.serialize(os);
-    os.flush();
+    return reqResponse;
 }
 
 void Server::recvCommand(HTTPServerRequest& request, HTTPServerResponse& response) 
@@ -692,6 +1067,18 @@ void Server::recvCommand(HTTPServerRequest& request, HTTPServerResponse& respons
     if (!mes)
         return;
 
+    // serve data
+    if (runCommand(mes)) {
+        serveText(response, mes->GetBuffer(), HTTPResponse::HTTP_OK);
+    }
+    else {
+        serveText(response, "timeout", HTTPResponse::HTTP_REQUEST_TIMEOUT);
+    }
+}
+
+// queue the command for the main thread and wait for its reply. return false on timeout.
+bool Server::runCommand(EditorCommandMessagePtr mes)
+{
     if (mes->message_id == InvalidID) {
         throw std::invalid_argument("Invalid EditorCommandMessage::id");
     }
@@ -708,25 +1095,13 @@ void Server::recvCommand(HTTPServerRequest& request, HTTPServerResponse& respons
     queueMessage(mes);
 
     // Wait for command to be executed
-    for (int i = 0; i < 300 ; ++i) {
-        if (mes->ready)
-            break;
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    waitReady(mes->ready, RequestTimeoutMS);
 
     {
         lock_t lock(m_commands_mutex);
         m_current_commands.erase(std::pair{ mes->message_id, mes->session_id });
     }
-
-    // serve data
-    if (mes->ready) {
-        serveText(response, mes->GetBuffer(), HTTPResponse::HTTP_OK);
-    }
-    else {
-        serveText(response, "timeout", HTTPResponse::HTTP_REQUEST_TIMEOUT);
-    }
+    return mes->ready;
 }
 
 void Server::notifyCommand(const char* reply, int messageId, int sessionId) {
@@ -752,10 +1127,98 @@ void Server::notifyPoll(PollMessage::PollType t)
     m_polls.erase(std::remove(m_polls.begin(), m_polls.end(), PollMessagePtr()), m_polls.end());
 }
 
+void Server::setImportWorkerCount(int v)
+{
+    m_import_worker_count = std::max(v, 0);
+}
+
+int Server::getImportWorkerCount() const
+{
+    return m_import_workers ? m_import_workers->getNumWorkers() : m_import_worker_count;
+}
+
+void Server::setMaxPendingImports(int v)
+{
+    m_max_pending_imports = std::max(v, 1);
+    if (m_import_workers)
+        m_import_workers->setMaxQueued(m_max_pending_imports);
+}
+
+int Server::getMaxPendingImports() const
+{
+    return m_max_pending_imports;
+}
+
+void Server::setMaxMessageSize(uint64_t v)
+{
+    m_max_message_size = v;
+    // one message of the largest size always fits
+    m_chunks.setMaxTotalBytes(std::max<uint64_t>(v, ChunkAssembler::DefaultMaxTotalBytes));
+}
+
+uint64_t Server::getMaxMessageSize() const
+{
+    return m_max_message_size;
+}
+
+WorkerPoolStats Server::getImportStats() const
+{
+    return m_import_workers ? m_import_workers->getStats() : WorkerPoolStats();
+}
+
+ServerStats Server::getStats() const
+{
+    ServerStats ret;
+    m_counters.getStats(ret);
+    ret.num_queued_messages = (int)m_received_messages.size();
+    {
+        lock_t lock(m_pending_mutex);
+        ret.num_pending_entities = (int)m_pending_entities.size();
+    }
+    ret.import_workers = getImportStats();
+    ret.memory = GetMemoryStats();
+    return ret;
+}
+
+void Server::resetStats()
+{
+    m_counters.reset();
+    if (m_import_workers)
+        m_import_workers->resetStats();
+}
+
+void Server::countRequest(int status, uint64_t bytes_received, uint64_t bytes_sent, mu::nanosec elapsed)
+{
+    ++m_counters.num_requests;
+    if (status >= 400)
+        ++m_counters.num_failed_requests;
+    m_counters.bytes_received += bytes_received;
+    m_counters.bytes_sent += bytes_sent;
+    m_counters.request_latency.add(elapsed);
+}
+
+void Server::recvStats(HTTPServerRequest& /*request*/, HTTPServerResponse& response)
+{
+    const std::string json = ToJSON(getStats());
+
+    response.set("Cache-Control", "no-store, must-revalidate");
+    response.setContentType("application/json");
+    response.setContentLength(json.size());
+    auto& os = response.send();
+    os.write(json.data(), json.size());
+    os.flush();
+}
+
 void Server::receivedProperty(PropertyInfoPtr prop) {
+    lock_t lock(m_pending_mutex);
     m_pending_properties[prop->hash()] = prop;
 }
 
+void Server::addPendingEntity(EntityPtr entity) {
+    lock_t lock(m_pending_mutex);
+    m_pending_entities.push_back(entity);
+}
+
 void Server::syncRequested() {
     m_syncRequested = true;
 }
@@ -780,6 +1243,161 @@ bool Server::readyForProperties() {
     return false;
 }
 
+template<class MessageT>
+static std::shared_ptr<MessageT> DeserializeFrame(ChannelFrame& frame)
+{
+    auto ret = std::make_shared<MessageT>();
+    mu::MemoryStream ms(std::move(frame.payload));
+    ret->deserialize(ms);
+    ret->timestamp_recv = mu::Now();
+    return ret;
+}
+
+// serve one channel connection until it is closed.
+// frames are handled in the order they arrive. Set/Delete/Fence/Text are answered with "ok" or an error text,
+// Query with its response and EditorCommand with the command's reply.
+// RequestServerLiveEdit opens a stream that live edits are pushed to.
+// Get, Screenshot and Poll are HTTP only: their replies are a scene, a file and a long poll, not a ResponseMessage.
+// other types are answered with an error.
+void Server::serveChannel(const StreamSocket& socket)
+{
+    mu::MemoryTagScope memory_tag(mu::MemoryTag::Server);
+    auto channel = std::make_shared<Channel>(socket);
+    channel->setMaxPayloadSize(m_max_message_size);
+    {
+        lock_t lock(m_channels_mutex);
+        if (m_channels_closing)
+            return;
+        m_channels.push_back(channel);
+    }
+
+    ServerLiveEditRequestPtr live_edit;
+    std::thread live_edit_pusher;
+    auto end_live_edit = [&]() {
+        if (live_edit) {
+            live_edit->cancelled = true;
+            live_edit->ready.notify();
+        }
+        if (live_edit_pusher.joinable())
+            live_edit_pusher.join();
+        live_edit.reset();
+    };
+
+    auto reply = [&channel](uint32_t stream_id, const char* text) {
+        ResponseMessage res;
+        res.text.push_back(text);
+        channel->write(stream_id, Message::Type::Response, res);
+    };
+
+    // each frame counts as a request. bytes are taken from the channel's totals, live edit pushes included.
+    uint64_t counted_received = 0, counted_sent = 0;
+    auto count = [&](int status, mu::nanosec begin) {
+        uint64_t received = channel->getBytesReceived(), sent = channel->getBytesSent();
+        countRequest(status, received - counted_received, sent - counted_sent, mu::Now() - begin);
+        counted_received = received;
+        counted_sent = sent;
+    };
+
+    ChannelFrame frame;
+    while (channel->read(frame)) {
+        const mu::nanosec begin = mu::Now();
+        if (!isServing()) {
+            reply(frame.stream_id, "not serving");
+            count(HTTPResponse::HTTP_SERVICE_UNAVAILABLE, begin);
+            continue;
+        }
+
+        int status = HTTPResponse::HTTP_OK;
+        try {
+            switch (frame.type) {
+            case Message::Type::Set:
+                importSetMessage(decodeSetMessage(std::move(frame.payload), ""));
+                reply(frame.stream_id, "ok");
+                break;
+            case Message::Type::Delete:
+                queueMessage(DeserializeFrame<DeleteMessage>(frame));
+                reply(frame.stream_id, "ok");
+                break;
+            case Message::Type::Fence:
+                queueMessage(DeserializeFrame<FenceMessage>(frame));
+                reply(frame.stream_id, "ok");
+                break;
+            case Message::Type::Text:
+            {
+                auto mes = DeserializeFrame<TextMessage>(frame);
+                if (!mes->text.empty())
+                    queueMessage(mes);
+                reply(frame.stream_id, "ok");
+                break;
+            }
+            case Message::Type::Query:
+            {
+                auto mes = DeserializeFrame<QueryMessage>(frame);
+                answerQuery(mes);
+                channel->write(frame.stream_id, Message::Type::Response, mes->response ? *mes->response : ResponseMessage());
+                mes->response.reset();
+                break;
+            }
+            case Message::Type::EditorCommand:
+            {
+                auto mes = DeserializeFrame<EditorCommandMessage>(frame);
+                if (runCommand(mes)) {
+                    reply(frame.stream_id, mes->GetBuffer());
+                }
+                else {
+                    reply(frame.stream_id, "timeout");
+                    status = HTTPResponse::HTTP_REQUEST_TIMEOUT;
+                }
+                break;
+            }
+            case Message::Type::RequestServerLiveEdit:
+            {
+                end_live_edit();
+                live_edit = DeserializeFrame<ServerLiveEditRequest>(frame);
+                queueMessage(live_edit);
+                live_edit_pusher = std::thread([this, channel, stream_id = frame.stream_id, mes = live_edit]() {
+                    pushLiveEdits(channel, stream_id, mes);
+                });
+                break;
+            }
+            default:
+                throw std::runtime_error("channel: unsupported message type");
+            }
+        }
+        catch (const std::exception& e) {
+            queueTextMessage(e.what(), TextMessage::Type::Error);
+            reply(frame.stream_id, e.what());
+            status = HTTPResponse::HTTP_BAD_REQUEST;
+        }
+        count(status, begin);
+    }
+
+    end_live_edit();
+    channel->close();
+    m_counters.bytes_received += channel->getBytesReceived() - counted_received;
+    m_counters.bytes_sent += channel->getBytesSent() - counted_sent;
+    {
+        lock_t lock(m_channels_mutex);
+        m_channels.erase(std::remove(m_channels.begin(), m_channels.end(), channel), m_channels.end());
+    }
+    m_channels_cond.notify_all();
+}
+
+// the channel version of recvServerLiveEditRequest(). instead of answering once,
+// the request is re-armed after each push so that the DCC keeps receiving edits without asking again.
+void Server::pushLiveEdits(ChannelPtr channel, uint32_t stream_id, ServerLiveEditRequestPtr mes)
+{
+    while (!mes->cancelled && !channel->isClosed()) {
+        if (!mes->ready.wait_for(RequestTimeoutMS, &mes->cancelled))
+            continue;
+
+        ServerLiveEditResponse res = buildLiveEditResponse(*mes);
+        mes->ready = false;
+        if (!channel->write(stream_id, Message::Type::RequestServerLiveEdit, res))
+            break;
+    }
+}
+
 Server::MessageHolder::MessageHolder()
 {
 }
@@ -787,6 +1405,7 @@ Server::MessageHolder::MessageHolder()
 Server::MessageHolder::MessageHolder(MessageHolder && v)
 {
     message = std::move(v.message);
+    type = v.type;
     task = std::move(v.task);
     ready = v.ready.load();
 }
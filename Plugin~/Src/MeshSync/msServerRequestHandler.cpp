@@ -16,6 +16,8 @@ public:
     void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) override;
 
 private:
+    void dispatchRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+
     Server *m_server = nullptr;
 };
 
@@ -23,6 +25,28 @@ ServerRequestHandler::ServerRequestHandler(Server *server) : m_server(server) {
 }
 
 void ServerRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+{
+    const mu::nanosec begin = mu::Now();
+    if (!m_server->beginRequest()) {
+        // the server is stopping and may be gone once this returns
+        response.setStatusAndReason(HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+        response.setContentLength(0);
+        response.send();
+        return;
+    }
+    struct RequestScope {
+        Server *server;
+        ~RequestScope() { server->endRequest(); }
+    } scope{ m_server };
+
+    dispatchRequest(request, response);
+
+    const std::streamsize received = request.getContentLength();
+    const std::streamsize sent = response.getContentLength();
+    m_server->countRequest(response.getStatus(), received > 0 ? received : 0, sent > 0 ? sent : 0, mu::Now() - begin);
+}
+
+void ServerRequestHandler::dispatchRequest(HTTPServerRequest& request, HTTPServerResponse& response)
 {
     //check the source connection
     if (!m_server->IsPublicAccessAllowed()) {
@@ -86,6 +110,9 @@ void ServerRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerR
     else if (StartsWith(uri, "command")) {
         m_server->recvCommand(request, response);
     }
+    else if (StartsWith(uri, "/stats")) {
+        m_server->recvStats(request, response);
+    }
     else {
         // note: Poco handles commas in URI
         // e.g. "hoge/hage/../hige" -> "hoge/hige"
@@ -103,6 +130,36 @@ HTTPRequestHandler* ServerRequestHandlerFactory::createRequestHandler(const HTTP
     return new ServerRequestHandler(m_server);
 }
 
+//--------------------------------------------------------------------------------------------------------------------- 
+
+class ChannelConnection : public TCPServerConnection {
+public:
+    ChannelConnection(const StreamSocket& socket, Server *server);
+    void run() override;
+
+private:
+    Server *m_server = nullptr;
+};
+
+ChannelConnection::ChannelConnection(const StreamSocket& socket, Server *server)
+    : TCPServerConnection(socket), m_server(server) {
+}
+
+void ChannelConnection::run()
+{
+    // same restriction as HTTP requests. the channel has no Host header, the peer address is checked instead.
+    if (!m_server->IsPublicAccessAllowed() && !NetworkUtils::IsInLocalNetwork(socket().peerAddress().toString()))
+        return;
+    m_server->serveChannel(socket());
+}
+
+ChannelConnectionFactory::ChannelConnectionFactory(Server *server) : m_server(server) {
+}
+
+TCPServerConnection* ChannelConnectionFactory::createConnection(const StreamSocket& socket) {
+    return new ChannelConnection(socket, m_server);
+}
+
 
 
 } // namespace ms
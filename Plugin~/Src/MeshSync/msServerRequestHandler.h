@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Poco/Net/HTTPRequestHandlerFactory.h" //HTTPRequestHandlerFactory
+#include "Poco/Net/TCPServerConnectionFactory.h" //TCPServerConnectionFactory
 #include "MeshSync/msProtocol.h"
 
 namespace Poco {
@@ -24,5 +25,15 @@ namespace ms {
         Server *m_server = nullptr;
     };
 
+    // connections to the persistent channel. each one lives until the peer disconnects or the server stops.
+    class ChannelConnectionFactory : public Poco::Net::TCPServerConnectionFactory {
+    public:
+        ChannelConnectionFactory(Server *server);
+        Poco::Net::TCPServerConnection* createConnection(const Poco::Net::StreamSocket &socket) override;
+
+    private:
+        Server *m_server = nullptr;
+    };
+
 } // namespace ms
 
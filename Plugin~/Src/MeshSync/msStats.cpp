@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "MeshSync/msStats.h"
+#include "MeshSync/msPool.h"
+
+namespace ms {
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::add(mu::nanosec v)
+{
+    int bucket = 0;
+    for (uint64_t us = v / 1000; us != 0 && bucket < NumBuckets - 1; us >>= 1)
+        ++bucket;
+
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(v, std::memory_order_relaxed);
+
+    uint64_t prev = m_max.load(std::memory_order_relaxed);
+    while (prev < v && !m_max.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& b : m_buckets)
+        b = 0;
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+LatencyStats LatencyHistogram::getStats() const
+{
+    LatencyStats ret;
+    uint64_t buckets[NumBuckets];
+    uint64_t count = 0;
+    for (int i = 0; i < NumBuckets; ++i) {
+        buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    if (count == 0)
+        return ret;
+
+    ret.count = count;
+    ret.average_ms = mu::NS2MS(m_total.load(std::memory_order_relaxed) / std::max<uint64_t>(m_count.load(), 1));
+    ret.max_ms = mu::NS2MS(m_max.load(std::memory_order_relaxed));
+
+    auto percentile = [&](double p) {
+        uint64_t threshold = std::max<uint64_t>(static_cast<uint64_t>(count * p + 0.5), 1);
+        uint64_t sum = 0;
+        for (int i = 0; i < NumBuckets; ++i) {
+            sum += buckets[i];
+            if (sum >= threshold)
+                return std::min(mu::NS2MS((1ull << i) * 1000), ret.max_ms);
+        }
+        return ret.max_ms;
+    };
+    ret.p50_ms = percentile(0.5);
+    ret.p90_ms = percentile(0.9);
+    ret.p99_ms = percentile(0.99);
+    return ret;
+}
+
+
+MemoryStats GetMemoryStats()
+{
+    MemoryStats ret;
+    const mu::MemoryTagStats total = mu::GetMemoryTotalStats();
+    ret.heap_bytes = total.bytes;
+    ret.heap_peak_bytes = total.peak_bytes;
+    ret.heap_blocks = total.blocks;
+    ret.general_bytes = mu::GetMemoryTagStats(mu::MemoryTag::General).bytes;
+    ret.stream_bytes = mu::GetMemoryTagStats(mu::MemoryTag::Stream).bytes;
+    ret.scene_cache_bytes = mu::GetMemoryTagStats(mu::MemoryTag::SceneCache).bytes;
+    ret.server_bytes = mu::GetMemoryTagStats(mu::MemoryTag::Server).bytes;
+
+    const int pool_count = PoolBase::getPoolCount();
+    for (int i = 0; i < pool_count; ++i) {
+        PoolBase *pool = PoolBase::getPool(i);
+        if (!pool)
+            continue;
+        const PoolStats stats = pool->getStats();
+        ret.pool_bytes += (uint64_t)std::max(stats.num_allocated, 0) * pool->getObjectSize();
+        ret.pool_retained_bytes += (uint64_t)std::max(stats.num_retained + stats.num_cached, 0) * pool->getObjectSize();
+    }
+    ret.total_bytes = ret.heap_bytes + ret.pool_bytes;
+    return ret;
+}
+
+
+ServerCounters::ServerCounters()
+{
+    num_queued_entities = 0;
+    reset();
+}
+
+void ServerCounters::reset()
+{
+    num_requests = 0;
+    num_failed_requests = 0;
+    bytes_received = 0;
+    bytes_sent = 0;
+    for (auto& n : num_messages)
+        n = 0;
+    num_entities_received = 0;
+    // num_queued_entities tracks live state. it is not a statistic to reset.
+
+    request_latency.reset();
+    decode_latency.reset();
+    import_latency.reset();
+    dispatch_latency.reset();
+}
+
+void ServerCounters::getStats(ServerStats& dst) const
+{
+    dst.num_requests = num_requests;
+    dst.num_failed_requests = num_failed_requests;
+    dst.bytes_received = bytes_received;
+    dst.bytes_sent = bytes_sent;
+    for (int i = 0; i < NumMessageTypes; ++i)
+        dst.num_messages[i] = num_messages[i];
+    dst.num_entities_received = num_entities_received;
+    dst.num_queued_entities = num_queued_entities;
+
+    dst.request_latency = request_latency.getStats();
+    dst.decode_latency = decode_latency.getStats();
+    dst.import_latency = import_latency.getStats();
+    dst.dispatch_latency = dispatch_latency.getStats();
+}
+
+
+ClientCounters::ClientCounters()
+{
+    reset();
+}
+
+void ClientCounters::reset()
+{
+    m_num_messages = 0;
+    m_num_failed = 0;
+    m_bytes_sent = 0;
+    m_num_shared_memory = 0;
+    m_num_channel = 0;
+    m_set_latency.reset();
+    m_other_latency.reset();
+}
+
+void ClientCounters::add(Message::Type type, uint64_t size, bool succeeded, mu::nanosec elapsed)
+{
+    ++m_num_messages;
+    if (!succeeded)
+        ++m_num_failed;
+    m_bytes_sent += size;
+    if (type == Message::Type::Set)
+        m_set_latency.add(elapsed);
+    else
+        m_other_latency.add(elapsed);
+}
+
+void ClientCounters::countSharedMemory()
+{
+    ++m_num_shared_memory;
+}
+
+void ClientCounters::countChannel()
+{
+    ++m_num_channel;
+}
+
+ClientStats ClientCounters::getStats() const
+{
+    ClientStats ret;
+    ret.num_messages = m_num_messages;
+    ret.num_failed = m_num_failed;
+    ret.bytes_sent = m_bytes_sent;
+    ret.num_shared_memory = m_num_shared_memory;
+    ret.num_channel = m_num_channel;
+    ret.set_latency = m_set_latency.getStats();
+    ret.other_latency = m_other_latency.getStats();
+    return ret;
+}
+
+
+static const char* g_message_type_names[NumMessageTypes] = {
+    "unknown", "get", "set", "delete", "fence", "text", "screenshot", "query", "response", "live_edit", "editor_command",
+};
+
+std::string ToJSON(const LatencyStats& v)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"count\":%llu,\"average_ms\":%.3f,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+        (unsigned long long)v.count, v.average_ms, v.p50_ms, v.p90_ms, v.p99_ms, v.max_ms);
+    return buf;
+}
+
+std::string ToJSON(const WorkerPoolStats& v)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+        "{\"num_workers\":%d,\"num_queued\":%d,\"num_running\":%d,\"peak_queued\":%d,\"num_completed\":%llu,\"num_blocked\":%llu,"
+        "\"average_wait_ms\":%.3f,\"max_wait_ms\":%.3f,\"average_run_ms\":%.3f,\"max_run_ms\":%.3f}",
+        v.num_workers, v.num_queued, v.num_running, v.peak_queued,
+        (unsigned long long)v.num_completed, (unsigned long long)v.num_blocked,
+        v.average_wait_ms, v.max_wait_ms, v.average_run_ms, v.max_run_ms);
+    return buf;
+}
+
+std::string ToJSON(const MemoryStats& v)
+{
+    std::string ret;
+    ret += "{";
+    ret += "\"total_bytes\":" + std::to_string(v.total_bytes);
+    ret += ",\"heap_bytes\":" + std::to_string(v.heap_bytes);
+    ret += ",\"heap_peak_bytes\":" + std::to_string(v.heap_peak_bytes);
+    ret += ",\"heap_blocks\":" + std::to_string(v.heap_blocks);
+    ret += ",\"general_bytes\":" + std::to_string(v.general_bytes);
+    ret += ",\"stream_bytes\":" + std::to_string(v.stream_bytes);
+    ret += ",\"scene_cache_bytes\":" + std::to_string(v.scene_cache_bytes);
+    ret += ",\"server_bytes\":" + std::to_string(v.server_bytes);
+    ret += ",\"pool_bytes\":" + std::to_string(v.pool_bytes);
+    ret += ",\"pool_retained_bytes\":" + std::to_string(v.pool_retained_bytes);
+    ret += "}";
+    return ret;
+}
+
+std::string ToJSON(const ServerStats& v)
+{
+    std::string messages;
+    for (int i = 0; i < NumMessageTypes; ++i) {
+        if (!messages.empty())
+            messages += ",";
+        messages += "\"" + std::string(g_message_type_names[i]) + "\":" + std::to_string(v.num_messages[i]);
+    }
+
+    std::string ret;
+    ret += "{";
+    ret += "\"num_requests\":" + std::to_string(v.num_requests);
+    ret += ",\"num_failed_requests\":" + std::to_string(v.num_failed_requests);
+    ret += ",\"bytes_received\":" + std::to_string(v.bytes_received);
+    ret += ",\"bytes_sent\":" + std::to_string(v.bytes_sent);
+    ret += ",\"messages\":{" + messages + "}";
+    ret += ",\"num_entities_received\":" + std::to_string(v.num_entities_received);
+    ret += ",\"num_queued_messages\":" + std::to_string(v.num_queued_messages);
+    ret += ",\"num_queued_entities\":" + std::to_string(v.num_queued_entities);
+    ret += ",\"num_pending_entities\":" + std::to_string(v.num_pending_entities);
+    ret += ",\"request_latency\":" + ToJSON(v.request_latency);
+    ret += ",\"decode_latency\":" + ToJSON(v.decode_latency);
+    ret += ",\"import_latency\":" + ToJSON(v.import_latency);
+    ret += ",\"dispatch_latency\":" + ToJSON(v.dispatch_latency);
+    ret += ",\"import_workers\":" + ToJSON(v.import_workers);
+    ret += ",\"memory\":" + ToJSON(v.memory);
+    ret += "}";
+    return ret;
+}
+
+} // namespace ms
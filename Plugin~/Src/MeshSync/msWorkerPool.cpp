@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "MeshSync/msWorkerPool.h"
+
+namespace ms {
+
+WorkerPool::WorkerPool(int num_workers, int max_queued)
+    : m_max_queued(std::max(max_queued, 1))
+{
+    num_workers = std::max(num_workers, 1);
+    m_workers.reserve(num_workers);
+    for (int i = 0; i < num_workers; ++i)
+        m_workers.emplace_back([this]() { workerMain(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond_jobs.notify_all();
+    m_cond_space.notify_all();
+    for (auto& t : m_workers)
+        t.join();
+}
+
+std::future<void> WorkerPool::submit(Task&& task)
+{
+    Job job;
+    job.task = std::packaged_task<void()>(std::move(task));
+    auto ret = job.task.get_future();
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if ((int)m_jobs.size() >= m_max_queued) {
+            ++m_num_blocked;
+            m_cond_space.wait(lock, [this]() { return m_stopping || (int)m_jobs.size() < m_max_queued; });
+        }
+        if (m_stopping) {
+            // no worker will pick it up anymore. run inline so that the future is fulfilled.
+            lock.unlock();
+            job.task();
+            return ret;
+        }
+        job.submitted = mu::Now();
+        m_jobs.push_back(std::move(job));
+        m_peak_queued = std::max(m_peak_queued, (int)m_jobs.size());
+    }
+    m_cond_jobs.notify_one();
+    return ret;
+}
+
+void WorkerPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond_idle.wait(lock, [this]() { return m_jobs.empty() && m_num_running == 0; });
+}
+
+int WorkerPool::getNumWorkers() const
+{
+    return (int)m_workers.size();
+}
+
+int WorkerPool::getMaxQueued() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_max_queued;
+}
+
+void WorkerPool::setMaxQueued(int v)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_max_queued = std::max(v, 1);
+    }
+    m_cond_space.notify_all();
+}
+
+WorkerPoolStats WorkerPool::getStats() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    WorkerPoolStats ret;
+    ret.num_workers = (int)m_workers.size();
+    ret.num_queued = (int)m_jobs.size();
+    ret.num_running = m_num_running;
+    ret.peak_queued = m_peak_queued;
+    ret.num_completed = m_num_completed;
+    ret.num_blocked = m_num_blocked;
+    if (m_num_completed > 0) {
+        ret.average_wait_ms = mu::NS2MS(m_total_wait / m_num_completed);
+        ret.average_run_ms = mu::NS2MS(m_total_run / m_num_completed);
+    }
+    ret.max_wait_ms = mu::NS2MS(m_max_wait);
+    ret.max_run_ms = mu::NS2MS(m_max_run);
+    return ret;
+}
+
+void WorkerPool::resetStats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_peak_queued = (int)m_jobs.size();
+    m_num_completed = m_num_blocked = 0;
+    m_total_wait = m_max_wait = 0;
+    m_total_run = m_max_run = 0;
+}
+
+void WorkerPool::workerMain()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cond_jobs.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+        // drain remaining jobs even when stopping
+        if (m_jobs.empty())
+            break;
+
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        ++m_num_running;
+        lock.unlock();
+        m_cond_space.notify_one();
+
+        mu::nanosec begin = mu::Now();
+        job.task(); // exceptions are captured in the future
+        mu::nanosec end = mu::Now();
+
+        lock.lock();
+        --m_num_running;
+        ++m_num_completed;
+        mu::nanosec wait = begin - job.submitted;
+        mu::nanosec run = end - begin;
+        m_total_wait += wait;
+        m_total_run += run;
+        m_max_wait = std::max(m_max_wait, wait);
+        m_max_run = std::max(m_max_run, run);
+        if (m_jobs.empty() && m_num_running == 0)
+            m_cond_idle.notify_all();
+    }
+}
+
+} // namespace ms
@@ -20,6 +20,7 @@
 #include <vector>
 #include <deque>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <memory>
 #include <iostream>
@@ -42,6 +43,7 @@
 #include "Poco/Timestamp.h"
 #include "Poco/URI.h"
 #include "Poco/StreamCopier.h"
+#include "Poco/SharedMemory.h"
 #include "Poco/Net/TCPServer.h"
 #include "Poco/Net/TCPServerParams.h"
 #include "Poco/Net/HTTPServer.h"
@@ -21,6 +21,10 @@
 
 #include "MeshSync/AsyncSceneSender.h" //ms::AsyncSceneSender
 #include "MeshSync/msServer.h"
+#include "MeshSync/msWorkerPool.h"
+#include "MeshSync/msStats.h"
+#include "MeshSync/msChannel.h"
+#include "MeshSync/msChunkedTransfer.h"
 
 using namespace mu;
 
@@ -182,17 +186,560 @@ TestCase(Test_ServerPropertyHandling) {
 TestCase(Test_ServerEntityHandling) {
     auto server = ms::Server(ms::ServerSettings());
 
-    auto testMesh = server.getOrCreatePendingEntity<ms::Mesh>("TestMesh");
+    ms::Mesh* testMesh = nullptr;
+    server.editPendingEntity<ms::Mesh>("TestMesh", [&](ms::Mesh& mesh) { testMesh = &mesh; });
     assert(testMesh != nullptr);
     assert(testMesh->path == "TestMesh" && "mesh was not created.");
 
-    auto testCurve = server.getOrCreatePendingEntity<ms::Curve>("TestCurve");
+    ms::Curve* testCurve = nullptr;
+    server.editPendingEntity<ms::Curve>("TestCurve", [&](ms::Curve& curve) { testCurve = &curve; });
     assert(testCurve != nullptr);
     assert(testCurve->path == "TestCurve" && "curve was not created.");
 
     assert(server.m_pending_entities.size() == 2);
 }
 
+TestCase(Test_Channel) {
+    ms::Server server{ ms::ServerSettings() };
+    server.setChannelPort(ms::Server::AnyChannelPort);
+    ms::ClientSettings client_settings;
+    if (!TestUtility::StartLocalServer(server, client_settings)) {
+        Print("Test_Channel: could not start server\n");
+        return;
+    }
+
+    ms::ChannelClient client(client_settings);
+    Expect(client.connect());
+
+    // answered by the server thread itself
+    ms::QueryMessage query;
+    query.query_type = ms::QueryMessage::QueryType::ProtocolVersion;
+    ms::ResponseMessagePtr response = client.send(query);
+    Expect(response && !response->text.empty() && response->text[0] == std::to_string(msProtocolVersion));
+
+    ms::FenceMessage fence;
+    fence.type = ms::FenceMessage::FenceType::SceneBegin;
+    response = client.send(fence);
+    Expect(response && !response->text.empty() && response->text[0] == "ok");
+    Expect(server.getNumMessages() == 1);
+
+    // disconnecting while other threads send fails their requests instead of crashing them
+    {
+        std::vector<std::thread> senders;
+        for (int i = 0; i < 4; ++i) {
+            senders.emplace_back([&client]() {
+                ms::TextMessage text;
+                text.text = "channel";
+                for (int j = 0; j < 50; ++j)
+                    client.send(text);
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        client.disconnect();
+        for (auto& t : senders)
+            t.join();
+        Expect(!client.isConnected());
+        Expect(!client.send(fence));
+    }
+
+    // Client sends Set/Delete/Fence through the channel when it has the port
+    {
+        ms::Client sender(client_settings);
+        ms::FenceMessage begin;
+        begin.type = ms::FenceMessage::FenceType::SceneBegin;
+        Expect(sender.send(begin));
+
+        ms::SetMessage set;
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/ChannelMesh";
+        mesh->points = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+        mesh->indices = { 0, 1, 2 };
+        mesh->counts = { 3 };
+        set.scene->entities.push_back(mesh);
+        Expect(sender.send(set));
+        Expect(sender.getStats().num_channel == 2);
+        Expect(sender.server_session_id != ms::InvalidID);
+    }
+
+    server.stop();
+}
+
+TestCase(Test_ReadySignal) {
+    // the flag belongs to this process. it isn't serialized and a received request starts out not ready
+    {
+        ms::GetMessage src;
+        src.message_id = 42;
+        ms::SetAllGetFlags(src.flags);
+        src.ready = true;
+
+        mu::MemoryStream os;
+        src.serialize(os);
+        os.flush();
+        RawVector<char> data = os.getBuffer();
+        data.resize(static_cast<size_t>(os.getWCount()));
+        mu::MemoryStream is(std::move(data));
+        ms::GetMessage dst;
+        dst.deserialize(is);
+        Expect(dst.message_id == 42 && dst.flags.m_bitFlags == src.flags.m_bitFlags);
+        Expect(!dst.ready);
+        Expect(src.ready);
+    }
+
+    // a waiter is woken up when the flag is set, long before its timeout
+    {
+        ms::ReadySignal signal;
+        Expect(!signal.wait_for(10));
+
+        std::thread setter([&signal]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            signal = true;
+        });
+        const mu::nanosec begin = mu::Now();
+        Expect(signal.wait_for(10000));
+        Expect(mu::NS2MS(mu::Now() - begin) < 5000.0f);
+        setter.join();
+    }
+
+    // cancellation wakes it up too, without setting the flag
+    {
+        ms::ReadySignal signal;
+        std::atomic_bool cancelled{ false };
+        std::thread canceller([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            cancelled = true;
+            signal.notify();
+        });
+        const mu::nanosec begin = mu::Now();
+        Expect(!signal.wait_for(10000, &cancelled));
+        Expect(mu::NS2MS(mu::Now() - begin) < 5000.0f);
+        canceller.join();
+    }
+
+    // the server answers a query with an empty response when the main thread doesn't get to it in time
+    ms::Server server{ ms::ServerSettings() };
+    ms::ClientSettings client_settings;
+    if (!TestUtility::StartLocalServer(server, client_settings)) {
+        Print("Test_ReadySignal: could not start server\n");
+        return;
+    }
+    ms::Client client(client_settings);
+    ms::QueryMessage query;
+    query.query_type = ms::QueryMessage::QueryType::AllNodes;
+    ms::ResponseMessagePtr response = client.send(query);
+    Expect(response && response->text.empty());
+    Expect(server.getNumMessages() == 1); // still queued, never processed
+
+    // and with the answer once it is ready
+    std::atomic_bool done{ false };
+    std::thread main_thread([&]() {
+        while (!done) {
+            server.processMessages([](ms::Message::Type type, ms::Message& data) {
+                if (type == ms::Message::Type::Query) {
+                    auto& mes = static_cast<ms::QueryMessage&>(data);
+                    mes.response->text.push_back("/Node");
+                    mes.ready = true;
+                }
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    response = client.send(query);
+    done = true;
+    main_thread.join();
+    Expect(response && response->text.size() == 1 && response->text[0] == "/Node");
+    server.stop();
+}
+
+TestCase(Test_ServerMaxMessageSize) {
+    ms::Server server{ ms::ServerSettings() };
+    server.setMaxMessageSize(4096);
+    ms::ClientSettings client_settings;
+    if (!TestUtility::StartLocalServer(server, client_settings)) {
+        Print("Test_ServerMaxMessageSize: could not start server\n");
+        return;
+    }
+
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/Large";
+    mesh->points.resize(1024, mu::float3::zero());
+    mesh->setupDataFlags();
+    ms::SetMessage mes(ms::Scene::create());
+    mes.scene->entities.push_back(mesh);
+
+    ms::Client client(client_settings);
+    Expect(!client.send(mes));
+    Expect(server.getStats().num_entities_received == 0);
+    Expect(server.getStats().num_messages[(int)ms::Message::Type::Text] == 1); // the error
+
+    server.setMaxMessageSize(ms::Server::DefaultMaxMessageSize);
+    Expect(client.send(mes));
+    Expect(server.getStats().num_entities_received == 1);
+    server.stop();
+}
+
+TestCase(Test_SendSharedMemory) {
+    ms::Server server{ ms::ServerSettings() };
+    ms::ClientSettings client_settings;
+    if (!TestUtility::StartLocalServer(server, client_settings)) {
+        Print("Test_SendSharedMemory: could not start server\n");
+        return;
+    }
+    client_settings.shared_memory_threshold = 1;
+
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/SharedMemory";
+    mesh->points.resize(4096);
+    for (size_t i = 0; i < mesh->points.size(); ++i)
+        mesh->points[i] = { (float)i, 1.0f, 2.0f };
+    mesh->setupDataFlags();
+    ms::SetMessage mes(ms::Scene::create());
+    mes.scene->entities.push_back(mesh);
+
+    auto imported = [&server, &mesh]() {
+        std::shared_ptr<ms::Mesh> dst;
+        server.processMessages([&dst](ms::Message::Type type, ms::Message& data) {
+            if (type == ms::Message::Type::Set) {
+                auto& scene = *static_cast<ms::SetMessage&>(data).scene;
+                if (scene.entities.size() == 1 && scene.entities[0]->getType() == ms::EntityType::Mesh)
+                    dst = std::static_pointer_cast<ms::Mesh>(scene.entities[0]);
+            }
+        });
+        return dst && dst->path == mesh->path && dst->points.size() == mesh->points.size() &&
+            memcmp(dst->points.cdata(), mesh->points.cdata(), mesh->points.size_in_byte()) == 0;
+    };
+
+    // the scene begin fence tells the sender's client that the server takes shared memory. the geometry goes through it
+    ms::AsyncSceneSender sender;
+    sender.session_id = ms::InvalidID;
+    sender.client_settings = client_settings;
+    for (int i = 0; i < 2; ++i) {
+        sender.geometries.push_back(mesh);
+        sender.kick();
+        sender.wait();
+        Expect(imported());
+    }
+    Expect(sender.getStats().client.num_shared_memory == 2);
+
+    // an error answer isn't a reason to stop using shared memory. the message goes through HTTP and gets the same answer
+    // the first response tells a client that the server takes shared memory
+    ms::Client client(client_settings);
+    Expect(client.isServerAvailable());
+    server.setServe(false);
+    Expect(!client.send(mes));
+    Expect(client.getStats().num_shared_memory == 0);
+    server.setServe(true);
+    Expect(client.send(mes));
+    Expect(client.getStats().num_shared_memory == 1);
+    Expect(imported());
+    server.stop();
+}
+
+TestCase(Test_SkipUnchangedSession) {
+    ms::ScenePtr scene = ms::Scene::create();
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/SkipUnchanged";
+    mesh->points.resize(16, mu::float3::zero());
+    scene->entities.push_back(mesh);
+
+    ms::AsyncSceneSender sender;
+    sender.session_id = ms::InvalidID;
+    sender.skip_unchanged = true;
+    auto send = [&]() {
+        sender.add(scene);
+        sender.kick();
+        sender.wait();
+    };
+
+    uint16_t port = 0;
+    {
+        ms::Server server{ ms::ServerSettings() };
+        if (!TestUtility::StartLocalServer(server, sender.client_settings)) {
+            Print("Test_SkipUnchangedSession: could not start server\n");
+            return;
+        }
+        port = server.getSettings().port;
+        send();
+        Expect(server.getStats().num_entities_received == 1);
+        send();
+        Expect(server.getStats().num_entities_received == 1); // skipped
+        server.stop();
+    }
+    {
+        // a restarted server has a new session id and has to receive everything again.
+        // it takes over the port the sender already knows
+        ms::ServerSettings server_settings;
+        server_settings.port = port;
+        ms::Server server(server_settings);
+        if (!server.start()) {
+            Print("Test_SkipUnchangedSession: could not restart server\n");
+            return;
+        }
+        send();
+        Expect(server.getStats().num_entities_received == 1);
+        server.stop();
+    }
+    Expect(sender.getStats().num_entities_skipped == 1);
+}
+
+TestCase(Test_ServerStopInFlight) {
+    ms::Server server{ ms::ServerSettings() };
+    // imports back up, so that sends are held in their request handlers
+    server.setImportWorkerCount(1);
+    server.setMaxPendingImports(1);
+    ms::ClientSettings client_settings;
+    if (!TestUtility::StartLocalServer(server, client_settings)) {
+        Print("Test_ServerStopInFlight: could not start server\n");
+        return;
+    }
+
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/InFlight";
+    mesh->points.resize(64 * 1024, mu::float3::one());
+    mesh->setupDataFlags();
+    ms::SetMessage mes(ms::Scene::create());
+    mes.scene->entities.push_back(mesh);
+
+    std::atomic_int num_finished{ 0 };
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 8; ++i) {
+        clients.emplace_back([&]() {
+            ms::Client client(client_settings);
+            client.send(mes);
+            ++num_finished;
+        });
+    }
+    // gets wait for the main thread, which never answers them here
+    for (int i = 0; i < 2; ++i) {
+        clients.emplace_back([&]() {
+            ms::Client client(client_settings);
+            client.send(ms::GetMessage());
+            ++num_finished;
+        });
+    }
+
+    const mu::nanosec begin = mu::Now();
+    while (server.getNumMessages() < 2 && mu::NS2MS(mu::Now() - begin) < 5000.0f)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    Expect(server.getNumMessages() >= 2);
+
+    // returns once the handlers in flight are done. waiting gets are woken up instead of timing out
+    const mu::nanosec stop_begin = mu::Now();
+    server.stop();
+    Expect(mu::NS2MS(mu::Now() - stop_begin) < 2500.0f);
+    for (auto& t : clients)
+        t.join();
+    Expect(num_finished == (int)clients.size());
+
+    // what was accepted is still there
+    int num_set = 0;
+    server.processMessages([&num_set](ms::Message::Type type, ms::Message&) {
+        if (type == ms::Message::Type::Set)
+            ++num_set;
+    });
+    Expect(server.getStats().num_entities_received == num_set);
+}
+
+// a zstd frame that stores data in a single raw block. content_size is what the frame header declares.
+static RawVector<char> MakeRawZstdFrame(const RawVector<char>& data, uint64_t content_size)
+{
+    RawVector<char> ret;
+    auto put = [&ret](uint64_t v, int n) {
+        for (int i = 0; i < n; ++i)
+            ret.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    };
+    put(0xFD2FB528, 4); // magic
+    put(0xE0, 1); // single segment, 8 byte content size
+    put(content_size, 8);
+    put((data.size() << 3) | 1, 3); // last block, raw
+    ret.push_back(data.cdata(), data.size());
+    return ret;
+}
+
+TestCase(Test_ServerDecodeSetMessage) {
+    ms::Server server{ ms::ServerSettings() };
+
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/Decode";
+    mesh->points.resize(256, mu::float3::one());
+    mesh->setupDataFlags();
+    ms::SetMessage mes(ms::Scene::create());
+    mes.scene->entities.push_back(mesh);
+
+    mu::MemoryStream os;
+    mes.serialize(os);
+    os.flush();
+    RawVector<char> body = os.getBuffer();
+    body.resize(static_cast<size_t>(os.getWCount()));
+    const RawVector<char> frame = MakeRawZstdFrame(body, body.size());
+
+    // round trip
+    {
+        RawVector<char> src = frame;
+        ms::SetMessagePtr decoded = server.decodeSetMessage(std::move(src), ms::CONTENT_ENCODING_ZSTD);
+        Expect(decoded && decoded->scene->hash() == mes.scene->hash());
+    }
+
+    auto rejected = [&server](RawVector<char>&& src) {
+        try {
+            server.decodeSetMessage(std::move(src), ms::CONTENT_ENCODING_ZSTD);
+        }
+        catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+
+    // a header claiming a huge size is rejected before anything is allocated
+    Expect(rejected(MakeRawZstdFrame(body, 1ull << 40)));
+
+    // truncated frame
+    RawVector<char> truncated = frame;
+    truncated.resize(truncated.size() / 2);
+    Expect(rejected(std::move(truncated)));
+
+    // valid but larger than the server accepts
+    server.setMaxMessageSize(body.size() - 1);
+    Expect(rejected(RawVector<char>(frame)));
+}
+
+TestCase(Test_ChunkedTransferResume) {
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/Chunked";
+    mesh->points.resize(4096);
+    for (size_t i = 0; i < mesh->points.size(); ++i)
+        mesh->points[i] = { (float)i, (float)(i * 7 % 13), 0.0f };
+    mesh->setupDataFlags();
+    ms::SetMessage mes(ms::Scene::create());
+    mes.scene->entities.push_back(mesh);
+    const uint64_t total_size = ms::ssize(mes);
+    const size_t chunk_size = 1024;
+    const uint64_t last_chunk = (total_size - 1) / chunk_size * chunk_size;
+
+    enum class Fault { None, DropRequest, DropResponse, ForgetTransfer, Reject };
+    ms::ChunkAssembler assembler;
+    int transfer = 0;
+    uint64_t fault_offset = 0;
+    Fault fault = Fault::None;
+    RawVector<char> body;
+    int num_completed = 0;
+
+    // connects the uploader to the assembler like Client::sendChunk() and Server::recvSetChunk() do.
+    // the fault hits the first upload at fault_offset.
+    ms::ChunkUploader uploader(chunk_size, [&](const char *data, size_t size, uint64_t offset) -> int64_t {
+        Fault f = Fault::None;
+        if (offset == fault_offset)
+            std::swap(f, fault);
+        if (f == Fault::DropRequest)
+            return ms::ChunkUploader::NoAnswer;
+        if (f == Fault::Reject)
+            return ms::ChunkUploader::Rejected;
+        if (f == Fault::ForgetTransfer)
+            assembler.clear();
+
+        RawVector<char> completed;
+        uint64_t received = 0;
+        ms::ChunkAssembler::Result result = assembler.append(std::to_string(transfer), total_size, offset, data, size, completed, received);
+        if (result == ms::ChunkAssembler::Result::Completed) {
+            body.swap(completed);
+            ++num_completed;
+        }
+        return f == Fault::DropResponse ? ms::ChunkUploader::NoAnswer : (int64_t)received;
+    });
+
+    auto send = [&](Fault f, uint64_t offset) {
+        ++transfer;
+        fault = f;
+        fault_offset = offset;
+        body.clear();
+        num_completed = 0;
+        bool ret = uploader.send([&](std::ostream& os) { mes.serialize(os); }, total_size);
+        if (ret) {
+            mu::MemoryStream is(std::move(body));
+            ms::SetMessage received;
+            received.deserialize(is);
+            ret = num_completed == 1 && received.scene->hash() == mes.scene->hash();
+        }
+        return ret;
+    };
+
+    Expect(send(Fault::None, 0));
+    Expect(uploader.getNumPasses() == 1 && uploader.getNumBytesSent() == total_size);
+
+    // a dropped chunk is resent and the transfer continues from it
+    Expect(send(Fault::DropRequest, chunk_size * 2));
+    Expect(uploader.getNumPasses() == 1 && uploader.getNumBytesSent() == total_size + chunk_size);
+
+    // the resent chunk overlaps what the receiver already has and is only acknowledged
+    Expect(send(Fault::DropResponse, chunk_size * 3));
+    Expect(uploader.getNumPasses() == 1 && uploader.getNumBytesSent() == total_size + chunk_size);
+
+    // a lost response to the last chunk doesn't complete the message twice
+    Expect(send(Fault::DropResponse, last_chunk));
+    Expect(uploader.getNumPasses() == 1);
+
+    // the receiver lost the transfer. it answers 409 with nothing received and the message is serialized again
+    Expect(send(Fault::ForgetTransfer, chunk_size * 8));
+    Expect(uploader.getNumPasses() == 2);
+
+    Expect(!send(Fault::Reject, chunk_size));
+    Expect(assembler.getNumTransfers() == 1); // the rejected one until it times out
+
+    // memory is committed as data arrives, not as the claimed size says
+    {
+        RawVector<char> completed;
+        uint64_t received = 0;
+        const char data[16] = {};
+        assembler.clear();
+        Expect(assembler.append("huge", 1ull << 29, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(received == sizeof(data));
+        Expect(assembler.append("huge", 1ull << 29, 1024, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::OutOfOrder);
+        Expect(received == sizeof(data));
+        Expect(assembler.getTotalBytes() == sizeof(data));
+    }
+
+    // all transfers together stay under the cap. the ones continued least recently make room
+    {
+        RawVector<char> completed;
+        uint64_t received = 0;
+        const char data[1024] = {};
+        ms::ChunkAssembler capped;
+        capped.setMaxTotalBytes(4096);
+        Expect(capped.append("a", 4096, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("b", 4096, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("b", 4096, 1024, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("b", 4096, 2048, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.getTotalBytes() == 4096 && capped.getNumTransfers() == 2);
+
+        // "a" is the stalest. it is dropped and its sender is told to start over
+        Expect(capped.append("b", 4096, 3072, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Completed);
+        Expect(completed.size() == 4096 && capped.getTotalBytes() == 0);
+        Expect(capped.append("b2", 4096, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("c", 4096, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("c", 4096, 1024, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.append("c", 4096, 2048, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(capped.getTotalBytes() <= 4096);
+        Expect(capped.append("a", 4096, 1024, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::OutOfOrder);
+        Expect(received == 0);
+
+        // a message that can never fit fails right away
+        bool thrown = false;
+        try {
+            capped.append("big", 8192, 0, data, sizeof(data), completed, received);
+        }
+        catch (const std::exception&) {
+            thrown = true;
+        }
+        Expect(thrown);
+
+        // the oldest transfer makes room for a new one when there are too many
+        ms::ChunkAssembler many;
+        for (int i = 0; i <= ms::ChunkAssembler::MaxTransfers; ++i)
+            Expect(many.append(std::to_string(i), 4096, 0, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::Accepted);
+        Expect(many.getNumTransfers() == ms::ChunkAssembler::MaxTransfers);
+        Expect(many.append("0", 4096, 1024, data, sizeof(data), completed, received) == ms::ChunkAssembler::Result::OutOfOrder);
+    }
+}
+
 TestCase(Test_SendMesh) {
 
     const float FRAME_RATE = 2.0f;
@@ -280,6 +827,654 @@ TestCase(Test_SceneCacheRead)
     }
 }
 
+static void WriteWaveCache(const char *path, int frameCount)
+{
+    ms::SceneCacheOutputSettings oscs;
+    oscs.exportSettings.stripUnchanged = 0;
+    oscs.exportSettings.sampleRate = 10.0f;
+
+    ms::SceneCacheWriter writer;
+    writer.Open(path, oscs);
+    for (int i = 0; i < frameCount; ++i) {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        mesh->path = "/Test/Wave";
+        MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv, 2.0f, 1.0f, 32, 0.1f * i);
+        mesh->material_ids.resize(mesh->counts.size(), 0);
+        mesh->setupDataFlags();
+
+        writer.SetTime(0.1f * i);
+        writer.geometries.emplace_back(mesh);
+        writer.kick();
+    }
+    writer.Close();
+}
+
+TestCase(Test_SceneCacheWriteOrder)
+{
+    const int FrameCount = 16;
+    WriteWaveCache("order.sc", FrameCount);
+
+    // scenes are encoded in parallel but must land in the file in the order they were added
+    std::ifstream is("order.sc", std::ios::binary);
+    ms::CacheFileHeader header;
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    Expect(is && header.version == msProtocolVersion);
+
+    std::vector<float> times;
+    for (;;) {
+        ms::CacheFileSceneHeader sh;
+        is.read(reinterpret_cast<char*>(&sh), sizeof(sh));
+        if (!is || sh.bufferCount == 0)
+            break;
+        RawVector<uint64_t> sizes;
+        sizes.resize(sh.bufferCount);
+        is.read(reinterpret_cast<char*>(sizes.data()), sizes.size_in_byte());
+        is.seekg(std::accumulate(sizes.begin(), sizes.end(), uint64_t(0)), std::ios::cur);
+        times.push_back(sh.time);
+    }
+    Expect(times.size() == FrameCount);
+    Expect(std::is_sorted(times.begin(), times.end()));
+}
+
+TestCase(Test_SceneCacheTruncated)
+{
+    const int FrameCount = 8;
+    WriteWaveCache("truncated.sc", FrameCount);
+
+    std::string data;
+    {
+        std::ifstream is("truncated.sc", std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    }
+
+    // where each scene record ends
+    std::vector<size_t> record_ends;
+    {
+        std::istringstream is(data);
+        is.seekg(sizeof(ms::CacheFileHeader));
+        for (;;) {
+            ms::CacheFileSceneHeader sh;
+            is.read(reinterpret_cast<char*>(&sh), sizeof(sh));
+            if (!is || sh.bufferCount == 0)
+                break;
+            RawVector<uint64_t> sizes;
+            sizes.resize(sh.bufferCount);
+            is.read(reinterpret_cast<char*>(sizes.data()), sizes.size_in_byte());
+            is.seekg(std::accumulate(sizes.begin(), sizes.end(), uint64_t(0)), std::ios::cur);
+            record_ends.push_back(static_cast<size_t>(is.tellg()));
+        }
+    }
+    Expect(record_ends.size() == FrameCount);
+    if (record_ends.size() != FrameCount)
+        return;
+
+    auto open_truncated = [&data](size_t size) {
+        {
+            std::ofstream os("truncated_copy.sc", std::ios::binary);
+            os.write(data.data(), size);
+        }
+        ms::SceneCacheInputSettings iscs;
+        return ms::SceneCacheInputFile::Open("truncated_copy.sc", iscs);
+    };
+    auto all_loadable = [](ms::SceneCacheInputFilePtr& isc) {
+        for (int i = 0; i < (int)isc->GetNumScenesV(); ++i) {
+            ms::ScenePtr scene = isc->LoadByFrameV(i);
+            if (!scene || scene->entities.size() != 1)
+                return false;
+        }
+        return true;
+    };
+
+    // cut after a record. the terminator and the sections are missing
+    {
+        ms::SceneCacheInputFilePtr isc = open_truncated(record_ends[4]);
+        Expect(isc && isc->GetNumScenesV() == 5 && all_loadable(isc));
+    }
+    // cut in the middle of a record. it is dropped
+    {
+        ms::SceneCacheInputFilePtr isc = open_truncated((record_ends[4] + record_ends[5]) / 2);
+        Expect(isc && isc->GetNumScenesV() == 5 && all_loadable(isc));
+    }
+    // cut in the scene headers
+    {
+        ms::SceneCacheInputFilePtr isc = open_truncated(record_ends[4] + sizeof(ms::CacheFileSceneHeader) + 4);
+        Expect(isc && isc->GetNumScenesV() == 5 && all_loadable(isc));
+    }
+    // nothing complete
+    {
+        ms::SceneCacheInputFilePtr isc = open_truncated(record_ends[0] - 1);
+        Expect(!isc);
+    }
+}
+
+// forwards to a file, but holds every write until the gate is opened. stalls the writer thread of a SceneCacheWriter.
+class GatedFileBuf : public std::filebuf
+{
+public:
+    void setOpen(bool v)
+    {
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_open = v;
+        }
+        m_cond.notify_all();
+    }
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        wait();
+        return std::filebuf::xsputn(s, n);
+    }
+
+    int overflow(int c) override
+    {
+        wait();
+        return std::filebuf::overflow(c);
+    }
+
+private:
+    void wait()
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_cond.wait(l, [this]() { return m_open; });
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_open = true;
+};
+
+TestCase(Test_SceneCacheWriteBackpressure)
+{
+    auto test = [](const char *path, int max_queue_size, uint64_t max_queue_bytes) {
+        ms::SceneCacheOutputSettings oscs;
+        oscs.exportSettings.stripUnchanged = 0;
+        oscs.exportSettings.sampleRate = 10.0f;
+        oscs.maxQueueSize = max_queue_size;
+        oscs.maxQueueBytes = max_queue_bytes;
+
+        GatedFileBuf buf;
+        buf.open(path, std::ios::out | std::ios::binary);
+        auto os = std::make_shared<std::ostream>(&buf);
+
+        ms::SceneCacheWriter writer;
+        writer.Open(os, oscs);
+        buf.setOpen(false); // nothing is written from here on. the queue only fills up
+
+        int added = 0, rejected = 0;
+        auto kick = [&]() {
+            if (writer.geometries.empty()) {
+                std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+                mesh->path = "/Test/Wave";
+                MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv, 2.0f, 1.0f, 32, 0.1f * added);
+                mesh->setupDataFlags();
+                writer.geometries.emplace_back(mesh);
+            }
+            writer.SetTime(0.1f * added);
+            if (writer.tryKick())
+                ++added;
+            else
+                ++rejected; // the data stays for the next try
+        };
+
+        // the first scene is always taken, the rest until the queue limit
+        while (rejected == 0 && added <= max_queue_size)
+            kick();
+        const int queued = added;
+        kick(); // still full, nothing has been written
+        Expect(rejected == 2 && added == queued);
+        Expect(writer.isExporting());
+
+        buf.setOpen(true);
+        while (added < 8) {
+            kick();
+            if (added < 8 && !writer.geometries.empty())
+                writer.wait(); // rejected. let the writer catch up
+        }
+        writer.Close();
+        os.reset();
+        buf.close();
+
+        ms::SceneCacheInputSettings iscs;
+        ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open(path, iscs);
+        Expect(isc && isc->GetNumScenesV() == 8);
+        return queued;
+    };
+
+    Expect(test("backpressure_count.sc", 3, 0) == 3);
+    Expect(test("backpressure_bytes.sc", 3, 1) == 1); // one scene at a time
+}
+
+TestCase(Test_SceneCacheMemoryBudget)
+{
+    const int FrameCount = 8;
+    WriteWaveCache("budget.sc", FrameCount);
+
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("budget.sc", iscs);
+    Expect(isc);
+    if (!isc)
+        return;
+
+    isc->SetPreloadLength(0);
+    const uint64_t frameSize = isc->LoadByFrameV(0)->profile_data.size_decoded;
+    Expect(frameSize > 0);
+
+    // room for 2.5 frames
+    const uint64_t budget = frameSize * 5 / 2;
+    isc->SetMaxLoadedBytes(budget);
+    for (int i = 1; i < FrameCount; ++i) {
+        Expect(isc->LoadByFrameV(i));
+        ms::SceneCacheMemoryReport report = isc->GetMemoryReportV();
+        Expect(report.loadedBytes <= budget);
+        Expect(report.pinnedSamples == 1);
+    }
+
+    ms::SceneCacheMemoryReport report = isc->GetMemoryReportV();
+    Expect(report.budgetBytes == budget);
+    Expect(report.loadedSamples == 2);
+    Expect(report.evictions == FrameCount - 2);
+}
+
+TestCase(Test_SceneCachePreloadDirection)
+{
+    WriteWaveCache("preload.sc", 16);
+
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("preload.sc", iscs);
+    Expect(isc);
+    if (!isc)
+        return;
+
+    // play backwards. the frames before the playhead get preloaded.
+    isc->SetPreloadLength(2);
+    for (int frame = 10; frame >= 8; --frame)
+        Expect(isc->LoadByFrameV(frame));
+
+    auto wait_loaded = [&](int frame) {
+        for (int i = 0; i < 200 && !isc->IsLoaded(frame); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return isc->IsLoaded(frame);
+    };
+    Expect(wait_loaded(7));
+    Expect(wait_loaded(6));
+}
+
+// meshes are 10 units apart along x. the first one moves 100 units along z every frame.
+static void WriteGridCache(const char *path, int frameCount, int meshCount, int frameBegin = 0, int stripUnchanged = 1)
+{
+    ms::SceneCacheOutputSettings oscs;
+    oscs.exportSettings.stripUnchanged = stripUnchanged;
+    oscs.exportSettings.sampleRate = 10.0f;
+
+    ms::SceneCacheWriter writer;
+    writer.Open(path, oscs);
+    for (int i = frameBegin; i < frameBegin + frameCount; ++i) {
+        for (int mi = 0; mi < meshCount; ++mi) {
+            std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+            mesh->path = "/Test/Wave" + std::to_string(mi);
+            mesh->position = { 10.0f * mi, 0.0f, mi == 0 ? 100.0f * i : 0.0f };
+            MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv, 2.0f, 1.0f, 32, 0.1f * i + mi);
+            mesh->material_ids.resize(mesh->counts.size(), 0);
+            mesh->setupDataFlags();
+            writer.geometries.emplace_back(mesh);
+        }
+        writer.SetTime(0.1f * i);
+        writer.kick();
+    }
+    writer.Close();
+}
+
+TestCase(Test_SceneCachePartialLoad)
+{
+    const int FrameCount = 3, MeshCount = 4;
+    WriteGridCache("partial.sc", FrameCount, MeshCount);
+
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("partial.sc", iscs);
+    Expect(isc);
+    if (!isc)
+        return;
+    isc->SetPreloadLength(0);
+    Expect(isc->HasEntityIndex());
+
+    const int id = isc->FindEntityIDV("/Test/Wave2");
+    Expect(id != ms::InvalidID);
+    Expect(isc->FindEntityIDV("/Test/Nothing") == ms::InvalidID);
+
+    // not loaded yet. only the segment that has the entity is read.
+    ms::ScenePtr partial = isc->LoadEntitiesByFrameV(2, { id });
+    Expect(partial && partial->entities.size() == 1);
+    if (!partial || partial->entities.empty())
+        return;
+    Expect(!isc->IsLoaded(2));
+
+    ms::ScenePtr full = isc->LoadByFrameV(2);
+    Expect(full && full->entities.size() == MeshCount);
+    if (!full)
+        return;
+    Expect(partial->profile_data.size_encoded < full->profile_data.size_encoded);
+
+    auto& mesh = static_cast<ms::Mesh&>(*partial->entities[0]);
+    auto it = std::find_if(full->entities.begin(), full->entities.end(), [id](auto& e) { return e->id == id; });
+    Expect(it != full->entities.end());
+    if (it == full->entities.end())
+        return;
+    auto& ref = static_cast<ms::Mesh&>(**it);
+    Expect(mesh.path == "/Test/Wave2");
+    Expect(mesh.points.size() == ref.points.size());
+    Expect(mesh.points.size() > 10 && mesh.points[10] == ref.points[10]);
+
+    // loaded samples are shared
+    ms::ScenePtr shared = isc->LoadEntitiesByFrameV(2, { id });
+    Expect(shared && shared->entities.size() == 1 && shared->entities[0] == *it);
+}
+
+TestCase(Test_SceneCacheBoundsQuery)
+{
+    WriteGridCache("bounds.sc", 3, 4);
+
+    ms::SceneCacheInputSettings iscs;
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("bounds.sc", iscs);
+    Expect(isc);
+    if (!isc)
+        return;
+    const int id0 = isc->FindEntityIDV("/Test/Wave0");
+    const int id1 = isc->FindEntityIDV("/Test/Wave1");
+    const int id2 = isc->FindEntityIDV("/Test/Wave2");
+    const int id3 = isc->FindEntityIDV("/Test/Wave3");
+
+    std::vector<int> ids;
+    Expect(isc->FindEntitiesInBoxV(0, { 9.0f, -1.0f, -1.0f }, { 11.0f, 1.0f, 1.0f }, ids));
+    Expect(ids == std::vector<int>{ id1 });
+
+    // moving geometry. only the frame it is there.
+    ids.clear();
+    isc->FindEntitiesInBoxV(0, { -1.0f, -1.0f, 199.0f }, { 1.0f, 1.0f, 201.0f }, ids);
+    Expect(ids.empty());
+    isc->FindEntitiesInBoxV(2, { -1.0f, -1.0f, 199.0f }, { 1.0f, 1.0f, 201.0f }, ids);
+    Expect(ids == std::vector<int>{ id0 });
+
+    // x >= 15
+    const mu::float4 planes[6] = {
+        { 1.0f, 0.0f, 0.0f, -15.0f }, { -1.0f, 0.0f, 0.0f, 1000.0f },
+        { 0.0f, 1.0f, 0.0f, 1000.0f }, { 0.0f, -1.0f, 0.0f, 1000.0f },
+        { 0.0f, 0.0f, 1.0f, 1000.0f }, { 0.0f, 0.0f, -1.0f, 1000.0f },
+    };
+    ids.clear();
+    Expect(isc->FindEntitiesInFrustumV(1, planes, ids));
+    Expect((ids == std::vector<int>{ id2, id3 }));
+
+    // the result feeds partial loading
+    ms::ScenePtr visible = isc->LoadEntitiesByFrameV(1, ids);
+    Expect(visible && visible->entities.size() == 2);
+}
+
+TestCase(Test_SceneCacheShards)
+{
+    // two writers, each for half of the frames
+    WriteGridCache("shard1.sc", 3, 4, 3, 0);
+    WriteGridCache("shard0.sc", 3, 4, 0, 0);
+    const std::vector<std::string> shards = { "shard1.sc", "shard0.sc" };
+
+    ms::SceneCacheInputSettings iscs;
+    ms::SceneCacheInputFilePtr set = ms::SceneCacheInputFile::OpenShards(shards, iscs);
+    Expect(set && set->GetNumScenesV() == 6);
+    if (!set)
+        return;
+    Expect(set->GetTimeV(0) == 0.0f && set->GetFrameByTimeV(0.4f) == 4);
+    ms::ScenePtr scene = set->LoadByFrameV(4);
+    Expect(scene && scene->entities.size() == 4);
+
+    Expect(ms::SceneCacheInputFile::MergeShards("merged.sc", shards));
+    ms::SceneCacheInputFilePtr merged = ms::SceneCacheInputFile::Open("merged.sc", iscs);
+    Expect(merged && merged->GetNumScenesV() == 6);
+    if (!merged)
+        return;
+    Expect(merged->HasEntityIndex());
+
+    // the second shard's frames are offset in the merged bounds
+    const int id0 = merged->FindEntityIDV("/Test/Wave0");
+    std::vector<int> ids;
+    Expect(merged->FindEntitiesInBoxV(5, { -1.0f, -1.0f, 499.0f }, { 1.0f, 1.0f, 501.0f }, ids));
+    Expect(ids == std::vector<int>{ id0 });
+
+    ms::ScenePtr partial = merged->LoadEntitiesByFrameV(5, { id0 });
+    Expect(partial && partial->entities.size() == 1 && partial->entities[0]->position.z == 500.0f);
+
+    // stripped shards are merged with their own first sample, and stripped again against the first one when merged
+    WriteGridCache("shard2.sc", 3, 4, 6, 1);
+    WriteGridCache("shard3.sc", 3, 4, 9, 1);
+    WriteGridCache("shard23_plain.sc", 6, 4, 6, 0);
+    const std::vector<std::string> stripped = { "shard3.sc", "shard0.sc", "shard2.sc" };
+    iscs.enableDiff = false;
+    ms::SceneCacheInputFilePtr plain = ms::SceneCacheInputFile::Open("shard23_plain.sc", iscs);
+    Expect(plain && plain->GetNumScenesV() == 6);
+    if (!plain)
+        return;
+
+    // frames [first, first + 6) of isc hold what plain does
+    auto same_as_plain = [&](ms::SceneCacheInputFile& isc, int first) {
+        for (int i = 0; i < 6; ++i) {
+            ms::ScenePtr a = isc.LoadByFrameV(first + i);
+            ms::ScenePtr b = plain->LoadByFrameV(i);
+            if (!a || !b || a->entities.size() != b->entities.size())
+                return false;
+            for (size_t ei = 0; ei < a->entities.size(); ++ei) {
+                auto& ma = static_cast<ms::Mesh&>(*a->entities[ei]);
+                auto& mb = static_cast<ms::Mesh&>(*b->entities[ei]);
+                if (ma.path != mb.path || ma.position != mb.position || ma.points.size() != mb.points.size() ||
+                    !std::equal(ma.points.begin(), ma.points.end(), mb.points.begin()))
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    ms::SceneCacheInputFilePtr stripped_set = ms::SceneCacheInputFile::OpenShards(stripped, iscs);
+    Expect(stripped_set && stripped_set->GetNumScenesV() == 9);
+    if (!stripped_set)
+        return;
+    Expect(same_as_plain(*stripped_set, 3));
+
+    Expect(ms::SceneCacheInputFile::MergeShards("merged_stripped.sc", stripped));
+    ms::SceneCacheInputFilePtr merged_stripped = ms::SceneCacheInputFile::Open("merged_stripped.sc", iscs);
+    Expect(merged_stripped && merged_stripped->GetNumScenesV() == 9);
+    if (!merged_stripped)
+        return;
+    Expect(merged_stripped->GetHeader().exportSettings.stripUnchanged);
+    Expect(same_as_plain(*merged_stripped, 3));
+}
+
+TestCase(Test_SceneCacheRewrite)
+{
+    WriteGridCache("rewrite_src.sc", 5, 4);
+    WriteGridCache("rewrite_src_nostrip.sc", 5, 4, 0, 0);
+
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    auto same_scenes = [&](const char *path, const char *ref_path, int ref_begin) {
+        ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open(path, iscs);
+        ms::SceneCacheInputFilePtr ref = ms::SceneCacheInputFile::Open(ref_path, iscs);
+        if (!isc || !ref)
+            return false;
+        for (int i = 0; i < (int)isc->GetNumScenesV(); ++i) {
+            ms::ScenePtr a = isc->LoadByFrameV(i);
+            ms::ScenePtr b = ref->LoadByFrameV(ref_begin + i);
+            if (!a || !b || a->hash() != b->hash() || isc->GetTimeV(i) != ref->GetTimeV(ref_begin + i))
+                return false;
+        }
+        return true;
+    };
+
+    // recompress. the content stays the same.
+    ms::SceneCacheInputFilePtr src = ms::SceneCacheInputFile::Open("rewrite_src.sc", iscs);
+    Expect(src);
+    if (!src)
+        return;
+    ms::SceneCacheRewriteSettings plain;
+    plain.changeEncoding = true;
+    plain.encoding = ms::SceneCacheEncoding::Plain;
+    Expect(src->Rewrite("rewrite_plain.sc", plain));
+    {
+        ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("rewrite_plain.sc", iscs);
+        Expect(isc && isc->GetHeader().exportSettings.encoding == ms::SceneCacheEncoding::Plain);
+        Expect(isc && isc->GetSegmentSize(1, 0) > src->GetSegmentSize(1, 0));
+    }
+    Expect(same_scenes("rewrite_plain.sc", "rewrite_src.sc", 0));
+
+    // trimming the first scene of a stripped cache re-encodes it
+    ms::SceneCacheRewriteSettings trim;
+    trim.timeRange = { 0.15f, 0.35f };
+    Expect(src->Rewrite("rewrite_trim.sc", trim));
+    Expect(same_scenes("rewrite_trim.sc", "rewrite_src.sc", 2));
+
+    // the rest is copied. bounds follow the scenes.
+    ms::SceneCacheInputFilePtr nostrip = ms::SceneCacheInputFile::Open("rewrite_src_nostrip.sc", iscs);
+    Expect(nostrip && nostrip->Rewrite("rewrite_trim_nostrip.sc", trim));
+    Expect(same_scenes("rewrite_trim_nostrip.sc", "rewrite_src_nostrip.sc", 2));
+    ms::SceneCacheInputFilePtr trimmed = ms::SceneCacheInputFile::Open("rewrite_trim_nostrip.sc", iscs);
+    Expect(trimmed && trimmed->GetNumScenesV() == 2);
+    if (!trimmed)
+        return;
+    std::vector<int> ids;
+    trimmed->FindEntitiesInBoxV(0, { -1.0f, -1.0f, 199.0f }, { 1.0f, 1.0f, 201.0f }, ids);
+    Expect(ids == std::vector<int>{ trimmed->FindEntityIDV("/Test/Wave0") });
+
+#ifndef _WIN32
+    // opens fine, but every write fails
+    Expect(!nostrip->Rewrite("/dev/full", trim));
+    Expect(!src->Rewrite("/dev/full", trim));
+#endif
+}
+
+TestCase(Test_SceneCacheVelocities)
+{
+    WriteGridCache("velocity.sc", 3, 4);
+
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    ms::SceneCacheInputFilePtr ref = ms::SceneCacheInputFile::Open("velocity.sc", iscs);
+    iscs.generateVelocities = true;
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open("velocity.sc", iscs);
+    Expect(ref && isc);
+    if (!ref || !isc)
+        return;
+
+    auto get_mesh = [](ms::ScenePtr& scene) { return scene ? std::static_pointer_cast<ms::Mesh>(scene->entities[2]) : nullptr; };
+    ms::ScenePtr s0 = ref->LoadByFrameV(0), s1 = ref->LoadByFrameV(1);
+    ms::ScenePtr v0 = isc->LoadByFrameV(0), v1 = isc->LoadByFrameV(1);
+    auto m0 = get_mesh(s0), m1 = get_mesh(s1), vm0 = get_mesh(v0), vm1 = get_mesh(v1);
+    Expect(m0 && m1 && vm0 && vm1);
+    if (!m0 || !m1 || !vm0 || !vm1)
+        return;
+    Expect(m0->velocities.empty());
+    Expect(vm0->velocities.size() == m0->points.size() && vm1->velocities.size() == m1->points.size());
+    if (vm1->velocities.size() != m1->points.size())
+        return;
+
+    // backward difference, and forward for the first sample. both are over the same pair.
+    const size_t i = 10;
+    const mu::float3 expected = (m1->points[i] - m0->points[i]) / (isc->GetTimeV(1) - isc->GetTimeV(0));
+    Expect(mu::length(expected) > 0.0f);
+    Expect(mu::near_equal(vm1->velocities[i], expected, 1e-3f));
+    Expect(mu::near_equal(vm0->velocities[i], expected, 1e-3f));
+
+    // the base sample is merged into the others. its velocities must not leak into them.
+    ms::ScenePtr s2 = ref->LoadByFrameV(2), v2 = isc->LoadByFrameV(2);
+    auto m2 = get_mesh(s2), vm2 = get_mesh(v2);
+    Expect(m2 && vm2 && vm2->velocities.size() == m2->points.size());
+    if (m2 && vm2 && vm2->velocities.size() == m2->points.size())
+        Expect(mu::near_equal(vm2->velocities[i], (m2->points[i] - m1->points[i]) / (isc->GetTimeV(2) - isc->GetTimeV(1)), 1e-3f));
+
+    // playing backwards, the neighbor decoded for the velocities is kept and becomes the next sample
+    {
+        ms::SceneCacheInputFilePtr rev = ms::SceneCacheInputFile::Open("velocity.sc", iscs);
+        Expect(rev);
+        if (!rev)
+            return;
+        rev->SetPreloadLength(0);
+        ms::ScenePtr r2 = rev->LoadByFrameV(2);
+        Expect(!rev->IsLoaded(1));
+        Expect(rev->GetMemoryReportV().loadedSamples == 3); // the base, 2 and the neighbor 1
+
+        ms::ScenePtr r1 = rev->LoadByFrameV(1);
+        Expect(rev->IsLoaded(1));
+        Expect(rev->GetMemoryReportV().loadedSamples == 3); // taken over, not decoded again
+        auto rm1 = get_mesh(r1);
+        Expect(rm1 && rm1->velocities.size() == m1->points.size());
+        if (rm1 && rm1->velocities.size() == m1->points.size())
+            Expect(mu::near_equal(rm1->velocities[i], expected, 1e-3f));
+    }
+
+    // same sizes but different topology. points don't correspond.
+    {
+        auto a = ms::Mesh::create(), b = ms::Mesh::create();
+        a->points = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 0.0f } };
+        b->points = a->points;
+        a->counts = { 3, 3 };
+        b->counts = a->counts;
+        a->indices = { 0, 1, 2, 1, 3, 2 };
+        b->indices = { 0, 2, 3, 0, 3, 1 };
+        Expect(!b->genVelocity(*a, 0.5f) && b->velocities.empty());
+        b->indices = a->indices;
+        Expect(b->genVelocity(*a, 0.5f) && b->velocities.size() == 4);
+
+        // the cache tells the topology is constant. no need to compare
+        b->velocities.clear();
+        b->indices = { 0, 2, 3, 0, 3, 1 };
+        b->cache_flags.constant_topology = 1;
+        Expect(b->genVelocity(*a, 0.5f));
+    }
+
+    // points are matched by id
+    auto p0 = ms::Points::create(), p1 = ms::Points::create();
+    p0->points = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } };
+    p0->ids = { 1, 2 };
+    p1->points = { { 2.0f, 1.0f, 0.0f }, { 5.0f, 5.0f, 5.0f }, { 0.0f, 2.0f, 0.0f } };
+    p1->ids = { 2, 3, 1 };
+    Expect(p1->genVelocity(*p0, 0.5f));
+    Expect(p1->velocities.size() == 3);
+    if (p1->velocities.size() == 3) {
+        Expect(p1->velocities[0] == mu::float3({ 2.0f, 2.0f, 0.0f }));
+        Expect(p1->velocities[1] == mu::float3::zero());
+        Expect(p1->velocities[2] == mu::float3({ 0.0f, 4.0f, 0.0f }));
+    }
+}
+
+TestCase(Test_SceneLerpRecycle)
+{
+    auto make_scene = [](float angle) {
+        auto scene = ms::Scene::create();
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/Test/Wave";
+        mesh->cache_flags.constant_topology = 1;
+        MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv, 2.0f, 1.0f, 32, angle);
+        scene->entities.push_back(mesh);
+        return scene;
+    };
+    auto s1 = make_scene(0.0f);
+    auto s2 = make_scene(1.0f);
+
+    auto dst = ms::Scene::create();
+    dst->lerp(*s1, *s2, 0.25f);
+    const mu::float3 *points = static_cast<ms::Mesh&>(*dst->entities[0]).points.cdata();
+
+    // same topology. the vertex buffer of the previous result is reused.
+    dst->lerp(*s1, *s2, 0.75f);
+    auto& mesh = static_cast<ms::Mesh&>(*dst->entities[0]);
+    Expect(mesh.points.cdata() == points);
+
+    auto& m1 = static_cast<ms::Mesh&>(*s1->entities[0]);
+    auto& m2 = static_cast<ms::Mesh&>(*s2->entities[0]);
+    Expect(near_equal(mesh.points[10], mu::lerp(m1.points[10], m2.points[10], 0.75f)));
+    Expect(m1.points.cdata() != points && m2.points.cdata() != points);
+}
+
 TestCase(Test_Animation)
 {
     std::shared_ptr<ms::Scene> scene = ms::Scene::create();
@@ -565,4 +1760,293 @@ TestCase(Test_Query)
 #undef SendQuery
 }
 
-#endif
\ No newline at end of file
+TestCase(Test_WorkerPool)
+{
+    const int TaskCount = 64;
+
+    std::atomic_int running{ 0 }, peak_running{ 0 }, done{ 0 };
+    std::vector<std::future<void>> futures;
+    {
+        ms::WorkerPool pool(2, 4);
+        for (int i = 0; i < TaskCount; ++i) {
+            // blocks while 4 tasks are pending
+            futures.push_back(pool.submit([&]() {
+                int r = ++running;
+                int p = peak_running;
+                while (r > p && !peak_running.compare_exchange_weak(p, r)) {}
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                --running;
+                ++done;
+            }));
+            Expect(pool.getStats().num_queued <= 4);
+        }
+        futures.push_back(pool.submit([]() { throw std::runtime_error("import failed"); }));
+
+        pool.waitIdle();
+        ms::WorkerPoolStats stats = pool.getStats();
+        Expect(stats.num_completed == TaskCount + 1);
+        Expect(stats.peak_queued <= 4);
+        Expect(stats.num_blocked > 0);
+    }
+    Expect(done == TaskCount);
+    Expect(peak_running <= 2);
+
+    bool thrown = false;
+    try {
+        futures.back().get();
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Expect(thrown);
+}
+
+namespace ms {
+// only used by Test_Pool so that other tests don't disturb its counts
+class PoolTestObject
+{
+public:
+    msDefinePool(PoolTestObject);
+    void clear() { value = 0; }
+    int value = 0;
+};
+} // namespace ms
+
+TestCase(Test_Pool)
+{
+    using ms::PoolTestObject;
+    auto& pool = ms::Pool<PoolTestObject>::instance();
+    Expect(ms::PoolBase::findPool("PoolTestObject") == &pool);
+
+    const int ThreadCount = 4, Iterations = 1000, ObjectCount = 40;
+    auto churn = [](int count) {
+        std::vector<PoolTestObject*> objs;
+        for (int i = 0; i < count; ++i)
+            objs.push_back(PoolTestObject::create_raw());
+        for (PoolTestObject *o : objs)
+            o->release();
+    };
+
+    std::vector<std::thread> threads;
+    for (int ti = 0; ti < ThreadCount; ++ti) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < Iterations; ++i)
+                churn(ObjectCount);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    // exited threads have returned their caches and folded their counts
+    ms::PoolStats stats = pool.getStats();
+    Expect(stats.num_hits + stats.num_misses == ThreadCount * Iterations * ObjectCount);
+    Expect(stats.num_misses < stats.num_hits);
+    Expect(stats.num_retained == stats.num_allocated);
+
+    pool.trim();
+    stats = pool.getStats();
+    Expect(stats.num_allocated == 0 && stats.num_retained == 0);
+
+    // objects returned beyond the limit are deleted
+    pool.setMaxRetained(ms::PoolBase::BatchSize);
+    std::thread([&]() { churn(ms::PoolBase::BatchSize * 8); }).join();
+    stats = pool.getStats();
+    Expect(stats.num_retained <= ms::PoolBase::BatchSize);
+    Expect(stats.num_retained == stats.num_allocated);
+
+    pool.setMaxRetained(INT_MAX);
+    pool.trim();
+
+    // trim() reaches the caches of other threads the next time they use the pool
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        int step = 0;
+        auto advance = [&](int from) {
+            std::unique_lock<std::mutex> lock(mutex);
+            step = from + 1;
+            cond.notify_all();
+            cond.wait(lock, [&]() { return step == from + 2; });
+        };
+        auto wait_for = [&](int s) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return step == s; });
+        };
+        auto release = [&](int s) {
+            std::unique_lock<std::mutex> lock(mutex);
+            step = s;
+            cond.notify_all();
+        };
+
+        std::thread worker([&]() {
+            churn(ms::PoolBase::BatchSize); // stays in this thread's cache
+            advance(0);
+            churn(1);
+            advance(2);
+        });
+
+        wait_for(1);
+        stats = pool.getStats();
+        Expect(stats.num_cached == ms::PoolBase::BatchSize && stats.num_retained == 0);
+        pool.trim();
+        Expect(pool.getStats().num_cached == ms::PoolBase::BatchSize); // the worker is idle
+
+        release(2);
+        wait_for(3);
+        stats = pool.getStats();
+        Expect(stats.num_cached == 1 && stats.num_allocated == 1);
+
+        release(4);
+        worker.join();
+    }
+    pool.trim();
+    Expect(pool.getStats().num_allocated == 0);
+}
+
+TestCase(Test_SceneCloneCOW)
+{
+    ms::ScenePtr src = ms::Scene::create();
+    {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        mesh->path = "/COW/Mesh";
+        mesh->points.resize(64, mu::float3::one());
+        mesh->normals.resize(64, { 0.0f, 1.0f, 0.0f });
+        mesh->addBone("/COW/Bone")->weights.resize(64, 1.0f);
+        mesh->setupDataFlags();
+        src->entities.push_back(mesh);
+    }
+    const uint64_t hash = src->hash();
+    auto& smesh = static_cast<ms::Mesh&>(*src->entities[0]);
+    const mu::float3 *src_points = smesh.points.cdata();
+
+    // buffers the source owns are shared until the clone modifies them. the source is left as it is
+    ms::ScenePtr dst = src->clone(true);
+    auto& dmesh = static_cast<ms::Mesh&>(*dst->entities[0]);
+    Expect(smesh.points.cdata() == src_points && !smesh.points.is_shared() && smesh.cow_buffers.empty());
+    Expect(dmesh.points.cdata() == smesh.points.cdata());
+    Expect(dmesh.bones[0] != smesh.bones[0]);
+    Expect(dmesh.bones[0]->weights.cdata() == smesh.bones[0]->weights.cdata());
+
+    dmesh.points[0] = mu::float3::zero();
+    dmesh.bones[0]->weights[0] = 0.0f;
+    Expect(dmesh.points.cdata() != smesh.points.cdata());
+    Expect(dmesh.normals.cdata() == smesh.normals.cdata());
+    Expect(smesh.points[0] == mu::float3::one());
+    Expect(smesh.bones[0]->weights[0] == 1.0f);
+    Expect(src->hash() == hash);
+
+    // entities of a deserialized scene refer to its scene buffers. the clone keeps them alive
+    mu::MemoryStream os;
+    src->serialize(os);
+    os.flush();
+    RawVector<char> data = os.getBuffer();
+    data.resize(static_cast<size_t>(os.getWCount()));
+    mu::MemoryStream is(std::move(data));
+    ms::ScenePtr loaded = ms::Scene::create();
+    loaded->deserialize(is);
+    loaded->scene_buffers.push_back(is.moveBuffer());
+
+    const char *loaded_begin = loaded->scene_buffers.front().cdata();
+    const char *loaded_end = loaded_begin + loaded->scene_buffers.front().size();
+    auto in_loaded = [&](const void *p) { return p >= loaded_begin && p < loaded_end; };
+
+    // a mesh cloned on its own copies what it only views, so it outlives the scene it was loaded into
+    ms::EntityPtr single = loaded->entities[0]->clone(true);
+    auto& smesh2 = static_cast<ms::Mesh&>(*single);
+    Expect(!in_loaded(smesh2.points.cdata()) && !in_loaded(smesh2.normals.cdata()));
+    Expect(!in_loaded(smesh2.bones[0]->weights.cdata()));
+
+    // a cloned scene holds the source scene instead of taking over its buffers
+    auto& lmesh = static_cast<ms::Mesh&>(*loaded->entities[0]);
+    ms::ScenePtr copy = loaded->clone(true);
+    Expect(loaded->scene_buffers.size() == 1 && loaded->scene_buffers.front().cdata() == loaded_begin);
+    Expect(copy->scene_buffers.empty() && loaded->cow_buffers.empty() && lmesh.cow_buffers.empty());
+    Expect(in_loaded(lmesh.points.cdata()) && lmesh.points.is_shared());
+    Expect(static_cast<ms::Mesh&>(*copy->entities[0]).points.cdata() == lmesh.points.cdata());
+
+    // so a shared scene can be cloned on multiple threads at once
+    std::vector<ms::ScenePtr> clones(8);
+    mu::parallel_for(0, (int)clones.size(), 1, [&](int i) { clones[i] = loaded->clone(true); });
+    for (auto& c : clones)
+        Expect(c->hash() == hash);
+
+    // entities of a cloned scene hold its buffers and are cloned from them without copies
+    ms::EntityPtr from_copy = copy->entities[0]->clone(true);
+    Expect(static_cast<ms::Mesh&>(*from_copy).points.cdata() == static_cast<ms::Mesh&>(*copy->entities[0]).points.cdata());
+
+    ms::EntityPtr kept = copy->entities[0];
+    loaded.reset();
+    Expect(copy->hash() == hash);
+    copy.reset();
+    Expect(kept->hash() == smesh.hash());
+    Expect(from_copy->hash() == smesh.hash());
+    Expect(single->hash() == smesh.hash());
+    Expect(smesh2.points[0] == mu::float3::one() && smesh2.bones[0]->weights[0] == 1.0f);
+}
+
+TestCase(Test_MemoryStats)
+{
+    const size_t size = 1024 * 1024;
+    const mu::MemoryTagStats before = mu::GetMemoryTagStats(mu::MemoryTag::Server);
+    {
+        RawVector<char> buf;
+        {
+            mu::MemoryTagScope tag(mu::MemoryTag::Server);
+            buf.resize(size);
+        }
+        // the tag sticks to the block, wherever it is freed
+        const mu::MemoryTagStats during = mu::GetMemoryTagStats(mu::MemoryTag::Server);
+        Expect(during.bytes == before.bytes + size);
+        Expect(during.blocks == before.blocks + 1);
+        Expect(during.peak_bytes >= during.bytes);
+    }
+    Expect(mu::GetMemoryTagStats(mu::MemoryTag::Server).bytes == before.bytes);
+
+    // the header fits in the alignment padding for any alignment
+    for (size_t alignment : { 4, 8, 16, 64, 4096 }) {
+        char *p = (char*)AlignedMalloc(100, alignment);
+        Expect(p && (uintptr_t)p % alignment == 0);
+        if (p) {
+            memset(p, 0xff, 100);
+            AlignedFree(p);
+        }
+    }
+
+    std::vector<std::shared_ptr<ms::Mesh>> meshes;
+    for (int i = 0; i < 8; ++i)
+        meshes.push_back(ms::Mesh::create());
+    ms::MemoryStats stats = ms::GetMemoryStats();
+    Expect(stats.pool_bytes >= sizeof(ms::Mesh) * meshes.size());
+    Expect(stats.heap_peak_bytes >= stats.heap_bytes);
+    Expect(stats.total_bytes == stats.heap_bytes + stats.pool_bytes);
+}
+
+TestCase(Test_LatencyHistogram)
+{
+    ms::LatencyHistogram hist;
+    Expect(hist.getStats().count == 0);
+
+    // 90 samples of 0.1ms, 10 of 10ms
+    for (int i = 0; i < 90; ++i)
+        hist.add(100 * 1000);
+    for (int i = 0; i < 10; ++i)
+        hist.add(10 * 1000 * 1000);
+
+    ms::LatencyStats stats = hist.getStats();
+    Expect(stats.count == 100);
+    Expect(near_equal(stats.max_ms, 10.0f));
+    Expect(stats.p50_ms >= 0.1f && stats.p50_ms <= 0.2f);
+    Expect(stats.p90_ms <= 0.2f);
+    Expect(stats.p99_ms > 5.0f && stats.p99_ms <= 10.0f);
+    Expect(near_equal(stats.average_ms, 1.09f, 0.01f));
+
+    hist.reset();
+    Expect(hist.getStats().count == 0);
+
+    ms::ServerStats server_stats;
+    server_stats.num_messages[(int)ms::Message::Type::Set] = 3;
+    std::string json = ms::ToJSON(server_stats);
+    Expect(json.find("\"set\":3") != std::string::npos);
+}
+
+#endif
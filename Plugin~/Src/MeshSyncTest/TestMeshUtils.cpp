@@ -1170,4 +1170,82 @@ TestCase(Test_Quadify)
     }
 }
 
+TestCase(Test_MPSCQueue)
+{
+    const int ProducerCount = 4;
+    const int ItemCount = 10000;
+
+    mu::mpsc_queue<int> queue;
+    std::vector<std::thread> producers;
+    for (int pi = 0; pi < ProducerCount; ++pi) {
+        producers.emplace_back([&queue, pi]() {
+            for (int i = 0; i < ItemCount; ++i)
+                queue.push(pi * ItemCount + i);
+        });
+    }
+
+    // drain while producers are running. order must be kept per producer
+    std::vector<int> last(ProducerCount, -1);
+    int received = 0;
+    bool ordered = true;
+    bool size_valid = true;
+    auto drain = [&]() {
+        received += (int)queue.pop_all([&](int v) {
+            int pi = v / ItemCount;
+            if (v <= last[pi])
+                ordered = false;
+            last[pi] = v;
+        });
+        // would wrap around if a pop could be subtracted before its push was counted
+        if (queue.size() > (size_t)ProducerCount * ItemCount)
+            size_valid = false;
+    };
+    while (received < ProducerCount * ItemCount / 2)
+        drain();
+    for (auto& t : producers)
+        t.join();
+    drain();
+
+    Expect(ordered);
+    Expect(size_valid);
+    Expect(received == ProducerCount * ItemCount);
+    Expect(queue.empty());
+
+    // a throwing body drops what is left without leaking it
+    auto item = std::make_shared<int>(0);
+    mu::mpsc_queue<std::shared_ptr<int>> items;
+    for (int i = 0; i < 4; ++i)
+        items.push(std::shared_ptr<int>(item));
+    int visited = 0;
+    try {
+        items.pop_all([&visited](std::shared_ptr<int>&) {
+            if (++visited == 2)
+                throw std::runtime_error("pop_all");
+        });
+    }
+    catch (const std::runtime_error&) {}
+    Expect(visited == 2);
+    Expect(items.empty());
+    Expect(item.use_count() == 1);
+}
+
+TestCase(Test_FixedMemoryStream)
+{
+    RawVector<char> buf;
+    buf.resize(16);
+
+    mu::FixedMemoryStream os(buf.data(), buf.size());
+    int v = 123;
+    os.write((const char*)&v, sizeof(v));
+    Expect(os.good() && os.size() == sizeof(v) && *(int*)buf.data() == v);
+
+    char tmp[16]{};
+    os.write(tmp, sizeof(tmp));
+    Expect(!os.good());
+
+    os.reset(buf.data(), buf.size());
+    os.write(tmp, sizeof(tmp));
+    Expect(os.good() && os.size() == buf.size());
+}
+
 #endif // SKIP_UTILS_TEST
\ No newline at end of file
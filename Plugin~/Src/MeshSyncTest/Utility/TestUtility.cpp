@@ -26,3 +26,16 @@ void TestUtility::Send(ms::ScenePtr scene) {
         sender.kick();
     }
 }
+
+bool TestUtility::StartLocalServer(ms::Server& server, ms::ClientSettings& client_settings) {
+    server.getSettings().port = 0;
+    if (server.getChannelPort() != 0)
+        server.setChannelPort(ms::Server::AnyChannelPort);
+    if (!server.start())
+        return false;
+
+    client_settings.server = "127.0.0.1";
+    client_settings.port = server.getSettings().port;
+    client_settings.channel_port = server.getChannelPort() == ms::Server::AnyChannelPort ? 0 : server.getChannelPort();
+    return true;
+}
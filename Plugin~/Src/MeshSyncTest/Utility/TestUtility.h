@@ -1,5 +1,6 @@
 #pragma once
 #include "MeshSync/msClient.h"  //ms::ClientSettings
+#include "MeshSync/msServer.h"  //ms::Server
 #include "MeshSync/SceneGraph/msAsset.h" //ms::TexturePtr
 
 #include "MeshSync/SceneGraph/msTexture.h"
@@ -42,5 +43,9 @@ public:
     static ms::ClientSettings GetClientSettings();
     static void Send(ms::ScenePtr scene);
 
+    // start server on free ports, so that tests don't collide with each other or with other servers.
+    // client_settings is pointed at them.
+    static bool StartLocalServer(ms::Server& server, ms::ClientSettings& client_settings);
+
 
 };
@@ -1,4 +1,42 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+// blocks are tagged with the current MemoryTag and counted per tag. the size and tag live in a small header in front of the block.
 void* AlignedMalloc(size_t size, size_t alignment);
 void  AlignedFree(void *addr);
+
+namespace mu {
+
+enum class MemoryTag : int
+{
+    General,    // allocated outside of any MemoryTagScope
+    Stream,     // MemoryStream buffers
+    SceneCache, // read and decoded by scene cache inputs. held by loaded samples
+    Server,     // received messages, until they are imported and released
+    Count,
+};
+
+struct MemoryTagStats
+{
+    uint64_t bytes = 0;
+    uint64_t peak_bytes = 0;
+    uint64_t blocks = 0;
+};
+
+MemoryTagStats GetMemoryTagStats(MemoryTag tag);
+MemoryTagStats GetMemoryTotalStats(); // all tags. the peak is the peak of the total, not the sum of the peaks
+
+// AlignedMalloc() on this thread counts towards the given tag while the scope is alive. scopes nest.
+class MemoryTagScope
+{
+public:
+    MemoryTagScope(MemoryTag tag);
+    ~MemoryTagScope();
+
+private:
+    MemoryTag m_prev;
+};
+
+} // namespace mu
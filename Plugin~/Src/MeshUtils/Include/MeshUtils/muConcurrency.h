@@ -128,5 +128,84 @@ private:
     std::atomic_flag lck = ATOMIC_FLAG_INIT;
 };
 
-} // namespace ms
 
+// multi-producer single-consumer queue.
+// producers push without locking. the consumer takes all queued elements at once with pop_all().
+// (the consumer never removes single nodes, so plain CAS on the head is free from ABA problems)
+template<class T>
+class mpsc_queue
+{
+public:
+    mpsc_queue() {}
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+    ~mpsc_queue() { clear(); }
+
+    void push(T&& v)
+    {
+        // count before publishing. pop_all() may take the node as soon as the CAS succeeds,
+        // and the counter must not go below the number of nodes it has seen.
+        ++m_size;
+        node *n = new node{ std::move(v), m_head.load(std::memory_order_relaxed) };
+        while (!m_head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // call body for each element in pushed order and remove them. return number of elements processed.
+    // if body throws, the elements it hasn't got to are dropped.
+    template<class Body>
+    size_t pop_all(const Body& body)
+    {
+        // detach whole list and reverse it. nodes are linked in LIFO order
+        node *n = m_head.exchange(nullptr, std::memory_order_acquire);
+        node *prev = nullptr;
+        while (n) {
+            node *next = n->next;
+            n->next = prev;
+            prev = n;
+            n = next;
+        }
+
+        // frees the nodes that are left when body throws
+        struct detached_list
+        {
+            node *head;
+            size_t count;
+            std::atomic<size_t>& size;
+
+            ~detached_list()
+            {
+                while (head) {
+                    node *next = head->next;
+                    delete head;
+                    head = next;
+                    ++count;
+                }
+                size -= count;
+            }
+        } list{ prev, 0, m_size };
+
+        for (; list.head; ++list.count) {
+            node *next = list.head->next;
+            body(list.head->value);
+            delete list.head;
+            list.head = next;
+        }
+        return list.count;
+    }
+
+    void clear() { pop_all([](T&) {}); }
+    // may include elements that are being pushed and are not visible to pop_all() yet
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    struct node
+    {
+        T value;
+        node *next;
+    };
+    std::atomic<node*> m_head{ nullptr };
+    std::atomic<size_t> m_size{ 0 };
+};
+
+} // namespace mu
@@ -41,6 +41,7 @@ void Lerp(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float
 void Lerp(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
 void LerpNormals(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w);
 void LerpTangents(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
+void GenerateVelocities(float3 *dst, const float3 *prev, const float3 *next, size_t num, float inv_interval); // (next - prev) * inv_interval
 void MinMax(const int *src, size_t num, int& dst_min, int& dst_max);
 void MinMax(const float *src, size_t num, float& dst_min, float& dst_max);
 void MinMax(const float2 *src, size_t num, float2& dst_min, float2& dst_max);
@@ -168,6 +169,9 @@ void LerpNormals_ISPC(float3 *dst, const float3 *src1, const float3 *src2, size_
 void LerpTangents_Generic(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
 void LerpTangents_ISPC(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
 
+void GenerateVelocities_Generic(float *dst, const float *prev, const float *next, size_t num, float inv_interval);
+void GenerateVelocities_ISPC(float *dst, const float *prev, const float *next, size_t num, float inv_interval);
+
 void MinMax_Generic(const int *src, size_t num, int& dst_min, int& dst_max);
 void MinMax_ISPC(const int *src, size_t num, int& dst_min, int& dst_max);
 void MinMax_Generic(const float *src, size_t num, float& dst_min, float& dst_max);
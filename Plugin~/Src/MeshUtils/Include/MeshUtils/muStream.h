@@ -48,6 +48,29 @@ private:
 };
 
 
+// writes into a caller-provided memory region (e.g. a mapped shared memory segment).
+// writing beyond the region sets badbit.
+class FixedMemoryStreamBuf : public std::streambuf
+{
+public:
+    FixedMemoryStreamBuf(char *data, size_t size);
+    void reset(char *data, size_t size);
+    size_t size() const;
+    int overflow(int c) override;
+};
+
+class FixedMemoryStream : public std::ostream
+{
+public:
+    FixedMemoryStream(char *data, size_t size);
+    void reset(char *data, size_t size);
+    size_t size() const; // bytes written
+
+private:
+    FixedMemoryStreamBuf m_buf;
+};
+
+
 class CounterStreamBuf : public std::streambuf
 {
 public:
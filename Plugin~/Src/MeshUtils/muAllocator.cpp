@@ -1,24 +1,119 @@
 #include "pch.h"
 #include "MeshUtils/muAllocator.h"
 
+#include <atomic>
+
+namespace mu {
+
+struct alignas(64) MemoryCounter
+{
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint64_t> peak_bytes{ 0 };
+    std::atomic<uint64_t> blocks{ 0 };
+
+    void add(uint64_t size)
+    {
+        const uint64_t v = bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        blocks.fetch_add(1, std::memory_order_relaxed);
+        uint64_t prev = peak_bytes.load(std::memory_order_relaxed);
+        while (prev < v && !peak_bytes.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+    }
+
+    void sub(uint64_t size)
+    {
+        bytes.fetch_sub(size, std::memory_order_relaxed);
+        blocks.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    MemoryTagStats get() const
+    {
+        MemoryTagStats ret;
+        ret.bytes = bytes.load(std::memory_order_relaxed);
+        ret.peak_bytes = peak_bytes.load(std::memory_order_relaxed);
+        ret.blocks = blocks.load(std::memory_order_relaxed);
+        return ret;
+    }
+};
+
+// the last one is the total
+static MemoryCounter g_memory_counters[(int)MemoryTag::Count + 1];
+static thread_local MemoryTag g_memory_tag = MemoryTag::General;
+
+MemoryTagStats GetMemoryTagStats(MemoryTag tag)
+{
+    const int i = (int)tag;
+    return i >= 0 && i < (int)MemoryTag::Count ? g_memory_counters[i].get() : MemoryTagStats();
+}
+
+MemoryTagStats GetMemoryTotalStats()
+{
+    return g_memory_counters[(int)MemoryTag::Count].get();
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag)
+    : m_prev(g_memory_tag)
+{
+    g_memory_tag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+    g_memory_tag = m_prev;
+}
+
+} // namespace mu
+
+using mu::g_memory_counters;
+
+// placed right before the address AlignedMalloc() returns
+struct AllocationHeader
+{
+    uint64_t size;
+    uint32_t tag;
+    uint32_t offset; // from the start of the underlying block
+};
+static_assert(sizeof(AllocationHeader) == 16, "AllocationHeader must be 16 bytes");
+
 void* AlignedMalloc(size_t size, size_t alignment)
 {
+    // the header itself needs 8 byte alignment
+    alignment = std::max(alignment, alignof(AllocationHeader));
     size_t mask = alignment - 1;
     size = (size + mask) & (~mask);
+    // the header rounded up to the alignment keeps the returned address aligned.
+    // the header lives in the padding, not in front of it.
+    const size_t offset = (sizeof(AllocationHeader) + mask) & (~mask);
 #ifdef _WIN32
-    return _mm_malloc(size, alignment);
+    char *block = (char*)_mm_malloc(size + offset, alignment);
 #else
-    void *ret = nullptr;
-    posix_memalign(&ret, alignment, size);
-    return ret;
+    void *ptr = nullptr;
+    posix_memalign(&ptr, alignment, size + offset);
+    char *block = (char*)ptr;
 #endif
+    if (!block)
+        return nullptr;
+
+    const mu::MemoryTag tag = mu::g_memory_tag;
+    AllocationHeader *header = (AllocationHeader*)(block + offset) - 1;
+    header->size = size;
+    header->tag = (uint32_t)tag;
+    header->offset = (uint32_t)offset;
+    g_memory_counters[(int)tag].add(size);
+    g_memory_counters[(int)mu::MemoryTag::Count].add(size);
+    return block + offset;
 }
 
 void AlignedFree(void *addr)
 {
+    if (!addr)
+        return;
+    AllocationHeader *header = (AllocationHeader*)addr - 1;
+    g_memory_counters[header->tag].sub(header->size);
+    g_memory_counters[(int)mu::MemoryTag::Count].sub(header->size);
+    char *block = (char*)addr - header->offset;
 #ifdef _WIN32
-    _mm_free(addr);
+    _mm_free(block);
 #else
-    free(addr);
+    free(block);
 #endif
 }
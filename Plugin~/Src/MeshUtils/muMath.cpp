@@ -79,6 +79,12 @@ void Lerp_Generic(float *dst, const float *src1, const float *src2, size_t num,
         dst[i] = src1[i] * iw + src2[i] * w;
 }
 
+void GenerateVelocities_Generic(float *dst, const float *prev, const float *next, size_t num, float inv_interval)
+{
+    for (size_t i = 0; i < num; ++i)
+        dst[i] = (next[i] - prev[i]) * inv_interval;
+}
+
 void LerpNormals_Generic(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w)
 {
     const float iw = 1.0f - w;
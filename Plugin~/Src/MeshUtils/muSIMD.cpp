@@ -93,6 +93,13 @@ void LerpTangents_ISPC(float4 *dst, const float4 *src1, const float4 *src2, size
 }
 #endif
 
+#ifdef muSIMD_GenerateVelocities
+void GenerateVelocities_ISPC(float *dst, const float *prev, const float *next, size_t num, float inv_interval)
+{
+    ispc::GenerateVelocities(dst, prev, next, (int)num, inv_interval);
+}
+#endif
+
 #ifdef muSIMD_NearEqual
 bool NearEqual_ISPC(const float *src1, const float *src2, size_t num, float eps)
 {
@@ -378,6 +385,13 @@ void LerpTangents(float4 * dst, const float4 * src1, const float4 * src2, size_t
 }
 #endif
 
+#if defined(muSIMD_GenerateVelocities) || !defined(muEnableISPC)
+void GenerateVelocities(float3 *dst, const float3 *prev, const float3 *next, size_t num, float inv_interval)
+{
+    Forward(GenerateVelocities, (float*)dst, (const float*)prev, (const float*)next, num * 3, inv_interval);
+}
+#endif
+
 #if defined(muSIMD_MinMax) || !defined(muEnableISPC)
 void MinMax(const int *p, size_t num, int& dst_min, int& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
 void MinMax(const float *p, size_t num, float& dst_min, float& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
@@ -10,6 +10,7 @@
 #define muSIMD_Scale
 #define muSIMD_Normalize
 #define muSIMD_Lerp
+#define muSIMD_GenerateVelocities
 #define muSIMD_NearEqual
 
 #define muSIMD_MinMax
@@ -24,6 +24,7 @@ void MemoryStreamBuf::reset()
 
 void MemoryStreamBuf::resize(size_t n)
 {
+    MemoryTagScope memory_tag(MemoryTag::Stream);
     buffer.resize(n);
     reset();
 }
@@ -82,6 +83,7 @@ int MemoryStreamBuf::sync()
 {
     rcount = uint64_t(this->gptr() - this->eback());
     wcount = uint64_t(this->pptr() - this->pbase());
+    MemoryTagScope memory_tag(MemoryTag::Stream);
     buffer.resize((size_t)std::max(rcount, wcount));
     return 0;
 }
@@ -102,11 +104,41 @@ uint64_t MemoryStream::getRCount() const { return m_buf.rcount; }
 char* MemoryStream::gskip(size_t n)
 {
     auto ret = m_buf.gptr();
+    if (n > size_t(m_buf.egptr() - ret)) {
+        // shared buffers must not point outside of the stream (e.g. corrupted or truncated data)
+        throw std::runtime_error("MemoryStream::gskip() out of range");
+    }
     m_buf.seekoff((std::streamoff)n, std::ios::cur, std::ios::binary);
     return ret;
 }
 
 
+
+FixedMemoryStreamBuf::FixedMemoryStreamBuf(char *data, size_t size)
+{
+    reset(data, size);
+}
+
+void FixedMemoryStreamBuf::reset(char *data, size_t size)
+{
+    this->setp(data, data + size);
+}
+
+size_t FixedMemoryStreamBuf::size() const
+{
+    return size_t(this->pptr() - this->pbase());
+}
+
+int FixedMemoryStreamBuf::overflow(int /*c*/)
+{
+    return traits_type::eof();
+}
+
+FixedMemoryStream::FixedMemoryStream(char *data, size_t size) : std::ostream(&m_buf), m_buf(data, size) {}
+void FixedMemoryStream::reset(char *data, size_t size) { m_buf.reset(data, size); clear(); }
+size_t FixedMemoryStream::size() const { return m_buf.size(); }
+
+
 static RawVector<char> s_dummy_buf;
 
 CounterStreamBuf::CounterStreamBuf()
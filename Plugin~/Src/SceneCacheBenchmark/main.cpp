@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "MeshGenerator.h"
+
+#include "MeshSync/SceneGraph/msMesh.h"
+#include "MeshSync/SceneCache/msSceneCacheWriter.h"
+#include "MeshSync/SceneCache/msSceneCacheOutputSettings.h"
+#include "MeshSync/SceneCache/msSceneCacheInputFile.h"
+#include "MeshSync/msStats.h" //LatencyStats
+
+// writes synthetic scenes with each combination of encoding and export settings, then measures how they load.
+// results go to stdout (or out=<path>) as json. progress goes to stderr.
+//   SceneCacheBenchmark [meshes=8] [resolution=64] [frames=60] [out=path]
+
+struct BenchArgs
+{
+    int meshes = 8;
+    int resolution = 64;
+    int frames = 60;
+    std::string out;
+};
+
+struct BenchConfig
+{
+    ms::SceneCacheEncoding encoding = ms::SceneCacheEncoding::ZSTD;
+    int level = 3;
+    int stripUnchanged = 0;
+    int applyRefinement = 0;
+    int maxSceneSegments = 1;
+};
+
+struct BenchResult
+{
+    BenchConfig config;
+    uint64_t fileSize = 0;
+    float writeTime = 0.0f;     // in ms
+    float openTime = 0.0f;      // in ms
+    ms::LatencyStats sequential;
+    ms::LatencyStats random;
+    float decodeThroughput = 0.0f; // decoded MB per second of decode time
+    float loadThroughput = 0.0f;   // decoded MB per second of load time
+    uint64_t peakLoadedBytes = 0;
+};
+
+static const char* g_path = "SceneCacheBenchmark.sc";
+
+static uint64_t GetPeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage ru;
+    if (::getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss; // bytes
+#else
+    return (uint64_t)ru.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
+
+static uint64_t GetFileSize(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    uint64_t ret = (uint64_t)ftell(f);
+    fclose(f);
+    return ret;
+}
+
+static ms::LatencyStats Summarize(std::vector<float> samples)
+{
+    ms::LatencyStats ret;
+    if (samples.empty())
+        return ret;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        size_t i = std::min(samples.size() - 1, (size_t)(samples.size() * p));
+        return samples[i];
+    };
+    double total = 0.0;
+    for (float s : samples)
+        total += s;
+    ret.count = samples.size();
+    ret.average_ms = (float)(total / samples.size());
+    ret.p50_ms = percentile(0.5);
+    ret.p90_ms = percentile(0.9);
+    ret.p99_ms = percentile(0.99);
+    ret.max_ms = samples.back();
+    return ret;
+}
+
+// even meshes are animated waves, odd ones are static spheres that stripUnchanged can drop
+static void WriteScenes(const BenchArgs& args, const BenchConfig& config, BenchResult& dst)
+{
+    ms::SceneCacheOutputSettings oscs;
+    oscs.exportSettings.encoding = config.encoding;
+    oscs.exportSettings.encoderSettings.zstd.compressionLevel = config.level;
+    oscs.exportSettings.sampleRate = 30.0f;
+    oscs.exportSettings.stripUnchanged = config.stripUnchanged;
+    oscs.exportSettings.applyRefinement = config.applyRefinement;
+    oscs.maxSceneSegments = config.maxSceneSegments;
+
+    ms::SceneCacheWriter writer;
+    if (!writer.Open(g_path, oscs))
+        return;
+
+    mu::nanosec elapsed = 0;
+    for (int i = 0; i < args.frames; ++i) {
+        for (int mi = 0; mi < args.meshes; ++mi) {
+            std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+            mesh->path = "/Benchmark/Mesh" + std::to_string(mi);
+            mesh->position = { 3.0f * mi, 0.0f, 0.0f };
+            if (mi % 2 == 0) {
+                MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv,
+                    2.0f, 1.0f, args.resolution, 0.1f * i + mi);
+            }
+            else {
+                // iteration 4 is ~2.5k vertices. scale with the resolution.
+                const int iteration = std::max(1, (int)std::log2((float)args.resolution) - 2);
+                MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv[0], 1.0f, iteration);
+            }
+            mesh->material_ids.resize(mesh->counts.size(), 0);
+            mesh->setupDataFlags();
+            writer.geometries.emplace_back(mesh);
+        }
+        writer.SetTime(i / oscs.exportSettings.sampleRate);
+
+        const mu::nanosec begin = mu::Now();
+        writer.kick();
+        elapsed += mu::Now() - begin;
+    }
+    const mu::nanosec begin = mu::Now();
+    writer.Close();
+    elapsed += mu::Now() - begin;
+
+    dst.writeTime = mu::NS2MS(elapsed);
+    dst.fileSize = GetFileSize(g_path);
+}
+
+// loads every frame once in the given order from a freshly opened file
+static ms::LatencyStats LoadScenes(const std::vector<int>& order, BenchResult& dst, bool measureOpen)
+{
+    ms::SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+
+    const mu::nanosec open_begin = mu::Now();
+    ms::SceneCacheInputFilePtr isc = ms::SceneCacheInputFile::Open(g_path, iscs);
+    if (measureOpen)
+        dst.openTime = mu::NS2MS(mu::Now() - open_begin);
+    if (!isc)
+        return {};
+    isc->SetPreloadLength(0);
+
+    std::vector<float> latencies;
+    uint64_t decoded = 0;
+    float decode_time = 0.0f, load_time = 0.0f;
+    for (int frame : order) {
+        const mu::nanosec begin = mu::Now();
+        ms::ScenePtr scene = isc->LoadByFrameV(frame);
+        const float elapsed = mu::NS2MS(mu::Now() - begin);
+        if (!scene)
+            continue;
+        latencies.push_back(elapsed);
+
+        const ms::SceneProfileData& prof = scene->profile_data;
+        decoded += prof.size_decoded;
+        decode_time += prof.decode_time;
+        load_time += elapsed;
+        dst.peakLoadedBytes = std::max(dst.peakLoadedBytes, isc->GetMemoryReportV().loadedBytes);
+    }
+    if (measureOpen) {
+        const float mb = decoded / (1024.0f * 1024.0f);
+        dst.decodeThroughput = decode_time > 0.0f ? mb / (decode_time / 1000.0f) : 0.0f;
+        dst.loadThroughput = load_time > 0.0f ? mb / (load_time / 1000.0f) : 0.0f;
+    }
+    return Summarize(latencies);
+}
+
+static std::vector<BenchConfig> GetConfigs()
+{
+    const std::pair<ms::SceneCacheEncoding, int> encodings[] = {
+        { ms::SceneCacheEncoding::Plain, 0 },
+        { ms::SceneCacheEncoding::ZSTD, 1 },
+        { ms::SceneCacheEncoding::ZSTD, 3 },
+        { ms::SceneCacheEncoding::ZSTD, 9 },
+    };
+    std::vector<BenchConfig> ret;
+    for (auto& e : encodings) {
+        for (int strip = 0; strip < 2; ++strip) {
+            for (int refine = 0; refine < 2; ++refine) {
+                for (int segments : { 1, 8 }) {
+                    BenchConfig c;
+                    c.encoding = e.first;
+                    c.level = e.second;
+                    c.stripUnchanged = strip;
+                    c.applyRefinement = refine;
+                    c.maxSceneSegments = segments;
+                    ret.push_back(c);
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+static std::string ToJSON(const BenchResult& v)
+{
+    const BenchConfig& c = v.config;
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+        "{\"encoding\":\"%s\",\"level\":%d,\"strip_unchanged\":%d,\"apply_refinement\":%d,\"max_scene_segments\":%d,"
+        "\"file_size\":%llu,\"write_ms\":%.3f,\"open_ms\":%.3f,\"decode_mbps\":%.2f,\"load_mbps\":%.2f,\"peak_loaded_bytes\":%llu,",
+        c.encoding == ms::SceneCacheEncoding::Plain ? "plain" : "zstd", c.level, c.stripUnchanged, c.applyRefinement, c.maxSceneSegments,
+        (unsigned long long)v.fileSize, v.writeTime, v.openTime, v.decodeThroughput, v.loadThroughput, (unsigned long long)v.peakLoadedBytes);
+
+    std::string ret = buf;
+    ret += "\"sequential\":" + ms::ToJSON(v.sequential);
+    ret += ",\"random\":" + ms::ToJSON(v.random);
+    ret += "}";
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchArgs args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t sep = arg.find('=');
+        if (sep == std::string::npos)
+            continue;
+        std::string name = arg.substr(0, sep), value = arg.substr(sep + 1);
+        if (name == "meshes")
+            args.meshes = std::max(1, std::atoi(value.c_str()));
+        else if (name == "resolution")
+            args.resolution = std::max(2, std::atoi(value.c_str()));
+        else if (name == "frames")
+            args.frames = std::max(1, std::atoi(value.c_str()));
+        else if (name == "out")
+            args.out = value;
+    }
+
+    std::vector<int> sequential(args.frames), random;
+    for (int i = 0; i < args.frames; ++i)
+        sequential[i] = i;
+    random = sequential;
+    std::shuffle(random.begin(), random.end(), std::mt19937(0)); // same order for every run
+
+    std::vector<BenchResult> results;
+    for (const BenchConfig& config : GetConfigs()) {
+        BenchResult r;
+        r.config = config;
+        WriteScenes(args, config, r);
+        r.sequential = LoadScenes(sequential, r, true);
+        r.random = LoadScenes(random, r, false);
+        std::remove(g_path);
+
+        fprintf(stderr, "%s(%d) strip=%d refine=%d segments=%d: %llu bytes, write %.1fms, sequential %.2fms, random %.2fms\n",
+            config.encoding == ms::SceneCacheEncoding::Plain ? "plain" : "zstd", config.level,
+            config.stripUnchanged, config.applyRefinement, config.maxSceneSegments,
+            (unsigned long long)r.fileSize, r.writeTime, r.sequential.average_ms, r.random.average_ms);
+        results.push_back(r);
+    }
+
+    std::string json;
+    json += "{\"protocol_version\":" + std::to_string(msProtocolVersion);
+    json += ",\"meshes\":" + std::to_string(args.meshes);
+    json += ",\"resolution\":" + std::to_string(args.resolution);
+    json += ",\"frames\":" + std::to_string(args.frames);
+    json += ",\"peak_rss_bytes\":" + std::to_string(GetPeakRSS());
+    json += ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i > 0)
+            json += ",";
+        json += ToJSON(results[i]);
+    }
+    json += "]}\n";
+
+    if (args.out.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        FILE *f = fopen(args.out.c_str(), "wb");
+        if (!f) {
+            fprintf(stderr, "failed to open %s\n", args.out.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    return 0;
+}
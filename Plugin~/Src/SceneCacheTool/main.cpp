@@ -0,0 +1,245 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "MeshSync/SceneCache/msSceneCacheInputFile.h"
+#include "MeshSync/SceneGraph/msScene.h"
+
+// offline operations on scene cache files. everything goes through SceneCacheInputFile,
+// encoded segments are copied as they are whenever possible.
+
+using namespace ms;
+
+static const char* g_usage =
+    "usage:\n"
+    "  SceneCacheTool info <file>\n"
+    "  SceneCacheTool recompress <src> <dst> [-encoding plain|zstd] [-level n]\n"
+    "  SceneCacheTool trim <src> <dst> [-begin time] [-end time]\n"
+    "  SceneCacheTool merge <dst> <src>...\n"
+    "  SceneCacheTool decode-check <file> [reference]\n";
+
+static const char* g_entity_type_names[] = {
+    "unknown", "transform", "camera", "light", "mesh", "points", "curve",
+};
+
+static const char* GetEncodingName(SceneCacheEncoding v)
+{
+    return v == SceneCacheEncoding::Plain ? "plain" : "zstd";
+}
+
+// -name value pairs after the positional arguments
+static std::map<std::string, std::string> ParseOptions(int argc, char *argv[], std::vector<std::string>& positional)
+{
+    std::map<std::string, std::string> ret;
+    for (int i = 0; i < argc; ++i) {
+        if (argv[i][0] == '-' && i + 1 < argc) {
+            ret[argv[i] + 1] = argv[i + 1];
+            ++i;
+        }
+        else {
+            positional.push_back(argv[i]);
+        }
+    }
+    return ret;
+}
+
+static SceneCacheInputFilePtr OpenCache(const std::string& path)
+{
+    SceneCacheInputSettings iscs;
+    iscs.enableDiff = false;
+    SceneCacheInputFilePtr ret = SceneCacheInputFile::Open(path.c_str(), iscs);
+    if (!ret)
+        fprintf(stderr, "failed to open %s\n", path.c_str());
+    else
+        ret->SetPreloadLength(0);
+    return ret;
+}
+
+static int Info(const std::vector<std::string>& args)
+{
+    if (args.size() != 1)
+        return -1;
+    SceneCacheInputFilePtr isc = OpenCache(args[0]);
+    if (!isc)
+        return 1;
+
+    const SceneCacheExportSettings& es = isc->GetHeader().exportSettings;
+    printf("version: %d\n", isc->GetHeader().version);
+    printf("encoding: %s", GetEncodingName(es.encoding));
+    if (es.encoding == SceneCacheEncoding::ZSTD)
+        printf(" (level %d)", es.encoderSettings.zstd.compressionLevel);
+    printf("\n");
+    printf("sample rate: %.3f\n", es.sampleRate);
+    printf("flags: stripUnchanged=%d applyRefinement=%d flattenHierarchy=%d stripNormals=%d stripTangents=%d\n",
+        (int)es.stripUnchanged, (int)es.applyRefinement, (int)es.flattenHierarchy, (int)es.stripNormals, (int)es.stripTangents);
+    printf("entity index: %s\n", isc->HasEntityIndex() ? "yes" : "no");
+
+    std::map<int, std::string> paths;
+    for (auto& kvp : isc->GetEntityIDs())
+        paths[kvp.second] = kvp.first;
+
+    const RawVector<CacheFileEntityMeta>& meta = isc->GetEntityMeta();
+    printf("\nentities: %d\n", (int)meta.size());
+    for (const CacheFileEntityMeta& m : meta) {
+        const int type = std::min<int>(m.type, (int)EntityType::Curve);
+        printf("  %6d %-9s constant=%d constantTopology=%d %s\n",
+            m.id, g_entity_type_names[type], (int)m.constant, (int)m.constantTopology, paths[m.id].c_str());
+    }
+
+    const int scene_count = static_cast<int>(isc->GetNumScenesV());
+    uint64_t total = 0;
+    printf("\nscenes: %d\n", scene_count);
+    for (int i = 0; i < scene_count; ++i) {
+        const size_t seg_count = isc->GetSegmentCount(i);
+        uint64_t size = 0;
+        std::string sizes;
+        for (size_t si = 0; si < seg_count; ++si) {
+            const uint64_t s = isc->GetSegmentSize(i, static_cast<int>(si));
+            size += s;
+            sizes += (si == 0 ? "" : " ") + std::to_string(s);
+        }
+        total += size;
+        printf("  %6d time=%.4f size=%llu segments=[%s]\n", i, isc->GetTimeV(i), (unsigned long long)size, sizes.c_str());
+    }
+    printf("total: %llu bytes\n", (unsigned long long)total);
+    return 0;
+}
+
+static int Recompress(const std::vector<std::string>& args, std::map<std::string, std::string>& opts)
+{
+    if (args.size() != 2)
+        return -1;
+    SceneCacheInputFilePtr isc = OpenCache(args[0]);
+    if (!isc)
+        return 1;
+
+    SceneCacheRewriteSettings settings;
+    settings.changeEncoding = true;
+    settings.encoding = isc->GetHeader().exportSettings.encoding;
+    settings.encoderSettings = isc->GetHeader().exportSettings.encoderSettings;
+    if (opts.count("encoding")) {
+        const std::string& name = opts["encoding"];
+        if (name == "plain")
+            settings.encoding = SceneCacheEncoding::Plain;
+        else if (name == "zstd")
+            settings.encoding = SceneCacheEncoding::ZSTD;
+        else
+            return -1;
+    }
+    if (opts.count("level"))
+        settings.encoderSettings.zstd.compressionLevel = std::atoi(opts["level"].c_str());
+
+    if (!isc->Rewrite(args[1].c_str(), settings)) {
+        fprintf(stderr, "failed to write %s\n", args[1].c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int Trim(const std::vector<std::string>& args, std::map<std::string, std::string>& opts)
+{
+    if (args.size() != 2)
+        return -1;
+    SceneCacheInputFilePtr isc = OpenCache(args[0]);
+    if (!isc)
+        return 1;
+
+    SceneCacheRewriteSettings settings;
+    if (opts.count("begin"))
+        settings.timeRange.start = static_cast<float>(std::atof(opts["begin"].c_str()));
+    if (opts.count("end"))
+        settings.timeRange.end = static_cast<float>(std::atof(opts["end"].c_str()));
+    if (!isc->Rewrite(args[1].c_str(), settings)) {
+        fprintf(stderr, "failed to write %s. no scenes in the range?\n", args[1].c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// inputs written with stripUnchanged are decoded and stripped again against the first scene (see MergeShards)
+static int Merge(const std::vector<std::string>& args)
+{
+    if (args.size() < 2)
+        return -1;
+    const std::vector<std::string> srcs(args.begin() + 1, args.end());
+    if (!SceneCacheInputFile::MergeShards(args[0].c_str(), srcs)) {
+        fprintf(stderr, "failed to merge. the caches must share encoding and sample rate and cover disjoint time ranges.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// decode all scenes. files have no checksums, so this only tells that they decode.
+// with a reference, the scenes must have the same times and hashes (e.g. a recompressed file and its source).
+static int DecodeCheck(const std::vector<std::string>& args)
+{
+    if (args.empty() || args.size() > 2)
+        return -1;
+    SceneCacheInputFilePtr isc = OpenCache(args[0]);
+    if (!isc)
+        return 1;
+    SceneCacheInputFilePtr ref;
+    if (args.size() == 2) {
+        ref = OpenCache(args[1]);
+        if (!ref)
+            return 1;
+        if (ref->GetNumScenesV() != isc->GetNumScenesV()) {
+            printf("scene count mismatch: %d != %d\n", (int)isc->GetNumScenesV(), (int)ref->GetNumScenesV());
+            return 1;
+        }
+    }
+
+    int errors = 0;
+    const int scene_count = static_cast<int>(isc->GetNumScenesV());
+    for (int i = 0; i < scene_count; ++i) {
+        ScenePtr scene = isc->LoadByFrameV(i);
+        if (!scene) {
+            printf("  %6d failed to decode\n", i);
+            ++errors;
+            continue;
+        }
+        const uint64_t hash = scene->hash();
+        printf("  %6d time=%.4f hash=%016llx", i, isc->GetTimeV(i), (unsigned long long)hash);
+        if (ref) {
+            ScenePtr ref_scene = ref->LoadByFrameV(i);
+            if (!ref_scene || ref_scene->hash() != hash || ref->GetTimeV(i) != isc->GetTimeV(i)) {
+                printf(" mismatch");
+                ++errors;
+            }
+        }
+        printf("\n");
+    }
+    printf("%d scenes, %d errors\n", scene_count, errors);
+    return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "%s", g_usage);
+        return -1;
+    }
+
+    const std::string command = argv[1];
+    std::vector<std::string> args;
+    std::map<std::string, std::string> opts = ParseOptions(argc - 2, argv + 2, args);
+
+    int ret = -1;
+    if (command == "info")
+        ret = Info(args);
+    else if (command == "recompress")
+        ret = Recompress(args, opts);
+    else if (command == "trim")
+        ret = Trim(args, opts);
+    else if (command == "merge")
+        ret = Merge(args);
+    else if (command == "decode-check")
+        ret = DecodeCheck(args);
+
+    if (ret < 0)
+        fprintf(stderr, "%s", g_usage);
+    return ret < 0 ? 2 : ret;
+}
@@ -18,6 +18,7 @@
 #include "msCoreAPI.h"
 
 #include "MeshSync/msMisc.h" //StartsWith
+#include "MeshSync/msStats.h" //GetMemoryStats
 
 using namespace mu;
 
@@ -604,8 +605,39 @@ msAPI float msPropertyInfoGetMin(const ms::PropertyInfo* self) { return self->mi
 msAPI float msPropertyInfoGetMax(const ms::PropertyInfo* self) { return self->max; }
 #pragma endregion
 
+#pragma region Pool
+// pools are listed in the order they were first used. a negative index applies to all of them.
+template<class Body>
+static void EachPool(int i, const Body& body)
+{
+    for (int pi = 0; pi < ms::PoolBase::getPoolCount(); ++pi) {
+        if (i >= 0 && i != pi)
+            continue;
+        if (ms::PoolBase *pool = ms::PoolBase::getPool(pi))
+            body(pool);
+    }
+}
+
+msAPI int               msPoolGetCount() { return ms::PoolBase::getPoolCount(); }
+msAPI const char*       msPoolGetName(int i) { auto pool = ms::PoolBase::getPool(i); return pool ? pool->getName() : nullptr; }
+msAPI void msPoolGetStats(int i, ms::PoolStats *dst)
+{
+    auto pool = ms::PoolBase::getPool(i);
+    if (pool && dst)
+        *dst = pool->getStats();
+}
+msAPI void msPoolResetStats(int i) { EachPool(i, [&](ms::PoolBase *pool) { pool->resetStats(); }); }
+msAPI void msPoolSetMaxRetained(int i, int v) { EachPool(i, [&](ms::PoolBase *pool) { pool->setMaxRetained(v); }); }
+msAPI void msPoolTrim(int i) { EachPool(i, [&](ms::PoolBase *pool) { pool->trim(); }); }
+#pragma endregion
+
 #pragma region Misc
 msAPI uint64_t msGetTime() { return mu::Now(); }
+msAPI void msGetMemoryStats(ms::MemoryStats *dst)
+{
+    if (dst)
+        *dst = ms::GetMemoryStats();
+}
 #ifndef msRuntime
 msAPI bool msWriteToFile(const char *path, const char *data, int size) { return ms::ByteArrayToFile(path, data, size); }
 #endif // msRuntime
@@ -17,6 +17,19 @@ msAPI ms::BaseSceneCacheInput* msSceneCacheOpen(const char *path)
     const ms::SceneCacheInputSettings ps;
     return ms::SceneCacheInputFile::OpenRaw(path, ps);
 }
+msAPI ms::BaseSceneCacheInput* msSceneCacheOpenShards(const char **paths, const int num_paths)
+{
+    if (!paths || num_paths <= 0)
+        return nullptr;
+    const ms::SceneCacheInputSettings ps;
+    return ms::SceneCacheInputFile::OpenShardsRaw(std::vector<std::string>(paths, paths + num_paths), ps);
+}
+msAPI bool msSceneCacheMergeShards(const char *dst_path, const char **paths, const int num_paths)
+{
+    if (!dst_path || !paths || num_paths <= 0)
+        return false;
+    return ms::SceneCacheInputFile::MergeShards(dst_path, std::vector<std::string>(paths, paths + num_paths));
+}
 msAPI void msSceneCacheClose(ms::BaseSceneCacheInput *self)
 {
     msDbgBreadcrumb();
@@ -39,6 +52,30 @@ msAPI void msSceneCacheSetPreloadLength(ms::BaseSceneCacheInput *self, const int
     self->SetPreloadLength(v);
 }
 
+msAPI uint64_t msSceneCacheGetMaxLoadedBytes(ms::BaseSceneCacheInput *self)
+{
+    msDbgBreadcrumb();
+    if (!self)
+        return 0;
+    return self->GetMaxLoadedBytes();
+}
+
+msAPI void msSceneCacheSetMaxLoadedBytes(ms::BaseSceneCacheInput *self, const uint64_t v)
+{
+    msDbgBreadcrumb();
+    if (!self)
+        return;
+    self->SetMaxLoadedBytes(v);
+}
+
+msAPI void msSceneCacheGetMemoryReport(ms::BaseSceneCacheInput *self, ms::SceneCacheMemoryReport *dst)
+{
+    msDbgBreadcrumb();
+    if (!self || !dst)
+        return;
+    *dst = self->GetMemoryReportV();
+}
+
 msAPI float msSceneCacheGetSampleRate(ms::BaseSceneCacheInput *self)
 {
     msDbgBreadcrumb();
@@ -91,6 +128,43 @@ msAPI ms::Scene* msSceneCacheLoadByTime(ms::BaseSceneCacheInput *self, const flo
     return self->LoadByTimeV(time, lerp).get();
 }
 
+msAPI ms::Scene* msSceneCacheLoadEntitiesByFrame(ms::BaseSceneCacheInput *self, const int index, const int *ids, const int num_ids)
+{
+    msDbgBreadcrumb();
+    if (!self || (!ids && num_ids > 0))
+        return nullptr;
+    return self->LoadEntitiesByFrameV(index, std::vector<int>(ids, ids + std::max(num_ids, 0))).get();
+}
+msAPI int msSceneCacheFindEntityID(ms::BaseSceneCacheInput *self, const char *path)
+{
+    msDbgBreadcrumb();
+    if (!self || !path)
+        return ms::InvalidID;
+    return self->FindEntityIDV(path);
+}
+
+// returns the number of entities found, which can exceed dst_size. -1 if the file has no bounds.
+msAPI int msSceneCacheFindEntitiesInBox(ms::BaseSceneCacheInput *self, const int index, const float3 *bmin, const float3 *bmax, int *dst, const int dst_size)
+{
+    msDbgBreadcrumb();
+    std::vector<int> ids;
+    if (!self || !bmin || !bmax || !self->FindEntitiesInBoxV(index, *bmin, *bmax, ids))
+        return -1;
+    if (dst)
+        std::copy_n(ids.begin(), std::min(static_cast<int>(ids.size()), dst_size), dst);
+    return static_cast<int>(ids.size());
+}
+msAPI int msSceneCacheFindEntitiesInFrustum(ms::BaseSceneCacheInput *self, const int index, const float4 *planes, int *dst, const int dst_size)
+{
+    msDbgBreadcrumb();
+    std::vector<int> ids;
+    if (!self || !planes || !self->FindEntitiesInFrustumV(index, planes, ids))
+        return -1;
+    if (dst)
+        std::copy_n(ids.begin(), std::min(static_cast<int>(ids.size()), dst_size), dst);
+    return static_cast<int>(ids.size());
+}
+
 msAPI void msSceneCacheRefresh(ms::BaseSceneCacheInput *self)
 {
     msDbgBreadcrumb();
@@ -195,6 +195,58 @@ msAPI void msServerSetZUpCorrectionMode(ms::Server *server, ms::ZUpCorrectionMod
         server->getSettings().import_settings.zup_correction_mode = v;
 }
 
+msAPI int msServerGetImportWorkerCount(ms::Server *server)
+{
+    return server ? server->getImportWorkerCount() : 0;
+}
+msAPI void msServerSetImportWorkerCount(ms::Server *server, int v)
+{
+    if (server)
+        server->setImportWorkerCount(v);
+}
+msAPI int msServerGetMaxPendingImports(ms::Server *server)
+{
+    return server ? server->getMaxPendingImports() : 0;
+}
+msAPI void msServerSetMaxPendingImports(ms::Server *server, int v)
+{
+    if (server)
+        server->setMaxPendingImports(v);
+}
+msAPI uint64_t msServerGetMaxMessageSize(ms::Server *server)
+{
+    return server ? server->getMaxMessageSize() : 0;
+}
+msAPI void msServerSetMaxMessageSize(ms::Server *server, uint64_t v)
+{
+    if (server)
+        server->setMaxMessageSize(v);
+}
+msAPI void msServerGetImportStats(ms::Server *server, ms::WorkerPoolStats *dst)
+{
+    if (server && dst)
+        *dst = server->getImportStats();
+}
+msAPI void msServerGetStats(ms::Server *server, ms::ServerStats *dst)
+{
+    if (server && dst)
+        *dst = server->getStats();
+}
+msAPI void msServerResetStats(ms::Server *server)
+{
+    if (server)
+        server->resetStats();
+}
+msAPI int msServerGetChannelPort(ms::Server *server)
+{
+    return server ? server->getChannelPort() : 0;
+}
+msAPI void msServerSetChannelPort(ms::Server *server, int v)
+{
+    if (server)
+        server->setChannelPort((uint16_t)v);
+}
+
 msAPI int msServerGetNumMessages(ms::Server *server)
 {
     return server ? server->getNumMessages() : 0;
@@ -339,28 +391,28 @@ msAPI void msServerSendCurve(ms::Server* server, const char* path, int splineInd
 {
     if (!server) { return; }
 
-    auto curve = server->getOrCreatePendingEntity<ms::Curve>(path);
+    server->editPendingEntity<ms::Curve>(path, [&](ms::Curve& curve) {
+        if (curve.splines.size() <= splineIndex) {
+            curve.splines.push_back(ms::CurveSpline::create());
+        }
 
-    if (curve->splines.size() <= splineIndex) {
-        curve->splines.push_back(ms::CurveSpline::create());
-    }
-
-    auto spline = curve->splines[splineIndex];
-    spline->closed = closed;
+        auto spline = curve.splines[splineIndex];
+        spline->closed = closed;
 
-    for (size_t i = 0; i < knotCount; i++)
-    {
-        spline->cos.push_back(cos[i]);
-        spline->handles_left.push_back(handlesLeft[i]);
-        spline->handles_right.push_back(handlesRight[i]);
-    }
+        for (size_t i = 0; i < knotCount; i++)
+        {
+            spline->cos.push_back(cos[i]);
+            spline->handles_left.push_back(handlesLeft[i]);
+            spline->handles_right.push_back(handlesRight[i]);
+        }
+    });
 }
 
 msAPI void msServerSendMesh(ms::Server* server, ms::Mesh* data)
 {
     if (!server) { return; }
 
-    server->m_pending_entities.push_back(make_shared_ptr(data));
+    server->addPendingEntity(make_shared_ptr(data));
 }
 
 msAPI void msServerRequestFullSync(ms::Server* server)